@@ -19,7 +19,7 @@ void GameLayer::onDetach()
 {
 }
 
-void GameLayer::onRender()
+void GameLayer::onRender(float interpolationAlpha)
 {
 	Renderer2D::beginScene(*m_camera);
 
@@ -11,7 +11,7 @@ public:
 	virtual void onAttach() override;
 	virtual void onDetach() override;
 	virtual void onUpdate(Shadow::Timestep ts) override {}
-	virtual void onRender() override;
+	virtual void onRender(float interpolationAlpha) override;
 	virtual void onImGuiRender() override;
 private:
 	bool onWindowResize(const Shadow::WindowResizedEvent& e);
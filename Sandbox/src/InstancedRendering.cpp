@@ -6,9 +6,13 @@
 using namespace Shadow;
 
 InstancedRendering::InstancedRendering()
-	: m_cameraController(45.0f, 1280.0f/720.0f)
+	: Layer("InstancedRendering"), m_cameraController(45.0f, 1280.0f/720.0f)
 {
+	setPriority(LayerPriority::Background);
+	setDeferredBudget(0.5f);
+
 	m_cameraController.setCameraTranslationSpeed(30.0f);
+	m_previousCameraPos = m_currentCameraPos = m_cameraController.getCamera().getPosition();
 
 	auto& window = ShEngine::get().getWindow();
 
@@ -107,7 +111,16 @@ InstancedRendering::InstancedRendering()
 	}
 
 	m_instanceCount = transforms.size();
-	m_instanceBuffer = VertexBuffer::create(transforms.data(), transforms.size() * sizeof(glm::vec3), sizeof(glm::vec3));
+
+	// one chunk per thread that records
+	const uint32_t chunkCount = JobSystem::getWorkerCount() + 1;
+	const uint32_t chunkSize = (m_instanceCount + chunkCount - 1) / chunkCount;
+	for (uint32_t first = 0; first < m_instanceCount; first += chunkSize)
+	{
+		const uint32_t count = std::min(chunkSize, m_instanceCount - first);
+		m_instanceChunks.emplace_back(VertexBuffer::create(transforms.data() + first, count * sizeof(glm::vec3), sizeof(glm::vec3)));
+		m_instanceChunkCounts.emplace_back(count);
+	}
 
 	uint32_t indices[] = {
 		// face 0:
@@ -180,29 +193,43 @@ InstancedRendering::~InstancedRendering()
 {
 }
 
-void InstancedRendering::onUpdate(Shadow::Timestep ts)
+void InstancedRendering::onFixedUpdate(Shadow::Timestep step)
 {
-	m_cameraController.onUpdate(ts);
+	m_previousCameraPos = m_currentCameraPos;
+	m_cameraController.onUpdate(step);
+	m_currentCameraPos = m_cameraController.getCamera().getPosition();
+}
 
+void InstancedRendering::onUpdate(Shadow::Timestep ts)
+{
 	if (Shadow::Input::isMouseButtonPressed(SH_MOUSE_BUTTON_LEFT))
 		Shadow::ShEngine::get().getWindow().setCursorMode(Shadow::CursorMode::Hidden);
 	else if (Shadow::Input::isMouseButtonPressed(SH_MOUSE_BUTTON_RIGHT))
 		Shadow::ShEngine::get().getWindow().setCursorMode(Shadow::CursorMode::Normal);
 }
 
-void InstancedRendering::onRender()
+void InstancedRendering::onRender(float interpolationAlpha)
 {
-	auto& cmdBuffer = Renderer::getCmdBuffer();
-
 	float width = static_cast<float>(ShEngine::get().getWindow().getWidth());
 	float height = static_cast<float>(ShEngine::get().getWindow().getHeight());
 
-	cmdBuffer->setViewport(0, 0, width, height);
-	cmdBuffer->beginRenderPass(m_pipelines.attachmentWrite, &m_cameraController.getCamera().getVPMatrix());
-	cmdBuffer->drawInstanced(m_vertexBuffers.attachmentWrite, m_instanceBuffer, m_indexBuffers.attachmentWrite, m_instanceCount);
-	cmdBuffer->nextSubpass(m_pipelines.attachmentRead);
-	cmdBuffer->drawIndexed(m_vertexBuffers.attachmentRead, m_indexBuffers.attachmentRead);
-	cmdBuffer->endRenderPass();
+	// view projection at the interpolated position, the rotation is applied by the mouse events right away
+	// vp * translate(pos - renderPos) equals the view projection of a camera standing at renderPos
+	const glm::vec3 renderPos = glm::mix(m_previousCameraPos, m_currentCameraPos, interpolationAlpha);
+	const glm::mat4 viewProjection = glm::translate(m_cameraController.getCamera().getVPMatrix(), m_currentCameraPos - renderPos);
+
+	Renderer::setViewport(0, 0, width, height);
+	Renderer::beginRenderPass(m_pipelines.attachmentWrite, nullptr, SubpassContents::SecondaryCmdBuffers);
+
+	// the layer outlives the frames it records, capturing this is fine with the render thread as well
+	Renderer::recordParallel(m_pipelines.attachmentWrite, static_cast<uint32_t>(m_instanceChunks.size()), [this](uint32_t chunk)
+		{
+			Renderer::drawInstanced(m_vertexBuffers.attachmentWrite, m_instanceChunks[chunk], m_indexBuffers.attachmentWrite, m_instanceChunkCounts[chunk]);
+		}, &viewProjection);
+
+	Renderer::nextSubpass(m_pipelines.attachmentRead);
+	Renderer::drawIndexed(m_vertexBuffers.attachmentRead, m_indexBuffers.attachmentRead);
+	Renderer::endRenderPass();
 }
 
 void InstancedRendering::onImGuiRender() 
@@ -217,5 +244,101 @@ void InstancedRendering::onImGuiRender()
 	ImGui::Text("Instance count: %u", m_instanceCount);
 	ImGui::Text("Vertices count: %u", m_vertexBuffers.attachmentWrite->getVertexCount() * m_instanceCount);
 	ImGui::Text("Indices count: %u", m_indexBuffers.attachmentWrite->getCount() * m_instanceCount);
+	ImGui::Text("Heap allocations last frame: %llu", static_cast<unsigned long long>(ShEngine::get().getFrameHeapAllocations()));
+	ImGui::End();
+
+	const LayerTimings& ownTimings = getTimings();
+	ImGui::Begin("Layer timings");
+	ImGui::Text("averaged in deferred time: %.3f / %.3f ms, %u items, skipped %u frames, %u rounds",
+		ownTimings.deferredMs, m_stats.budgetMs, m_stats.itemsLastFrame, ownTimings.skippedFrames, m_stats.rounds);
+	ImGui::Separator();
+	uint32_t layerIndex = 0;
+	for (const Layer* layer : ShEngine::get().getLayerStack())
+	{
+		if (layerIndex >= m_stats.averageTimings.size())
+			break;
+
+		const LayerTimings& timings = m_stats.averageTimings[layerIndex++];
+		ImGui::Text("%s: fixed %.3f ms | update %.3f ms | render %.3f ms | deferred %.3f ms",
+			layer->getName(), timings.fixedUpdateMs, timings.updateMs, timings.renderMs, timings.deferredMs);
+	}
+	ImGui::End();
+
+	const GpuMemoryStats& memoryStats = m_stats.memoryStats;
+	constexpr float mb = 1.0f / (1024.0f * 1024.0f);
+
+	ImGui::Begin("GPU memory");
+	for (uint32_t i = 0; i < memoryStats.heapCount; i++)
+	{
+		const GpuHeapStats& heap = memoryStats.heaps[i];
+		const float usage = heap.budget ? static_cast<float>(heap.usage) / heap.budget : 0.0f;
+
+		ImGui::Text("Heap %u (%s): %.1f / %.1f MB, fragmentation %.1f%%", i, heap.deviceLocal ? "device local" : "host",
+			heap.usage * mb, heap.budget * mb, heap.getFragmentation() * 100.0f);
+		ImGui::ProgressBar(usage);
+	}
+	if (!memoryStats.budgetQueried)
+		ImGui::Text("VK_EXT_memory_budget unavailable, budgets are estimated");
+
+	ImGui::Separator();
+	for (size_t i = 0; i < memoryStats.categoryBytes.size(); i++)
+	{
+		ImGui::Text("%s: %.2f MB (%u allocations)", getGpuMemoryCategoryName(static_cast<GpuMemoryCategory>(i)),
+			memoryStats.categoryBytes[i] * mb, memoryStats.categoryAllocations[i]);
+	}
+
+	ImGui::Separator();
+	ImGui::Text("Reclaimed after upload:");
+	for (size_t i = 0; i < memoryStats.reclaimedBytes.size(); i++)
+		ImGui::Text("%s: %.2f MB", getReclaimedMemoryName(static_cast<ReclaimedMemory>(i)), memoryStats.reclaimedBytes[i] * mb);
+
+	ImGui::Separator();
+	const GpuDefragmentationStats& defrag = memoryStats.defragmentation;
+	ImGui::Text("Defragmentation: %s (%u runs)", defrag.running ? "running" : "idle", defrag.runs);
+	ImGui::Text("Fragmentation: %.1f%% -> %.1f%%", defrag.fragmentationBefore * 100.0f, defrag.fragmentationAfter * 100.0f);
+	ImGui::Text("Moved: %.2f MB in %u allocations, freed %.2f MB", defrag.bytesMoved * mb, defrag.allocationsMoved, defrag.bytesFreed * mb);
+	if (ImGui::Button("Defragment"))
+		Renderer::defragmentMemory();
 	ImGui::End();
+}
+
+void InstancedRendering::onDeferredUpdate(const Shadow::TimeSlice& slice)
+{
+	const LayerStack& layerStack = ShEngine::get().getLayerStack();
+	const uint32_t layerCount = static_cast<uint32_t>(std::distance(layerStack.begin(), layerStack.end()));
+	if (m_stats.averageTimings.size() != layerCount)
+	{
+		m_stats.averageTimings.resize(layerCount);
+		m_stats.nextItem = 0;
+	}
+
+	// item 0 is the memory stats, item i + 1 the timings of layer i. at most one round per frame
+	const uint32_t itemCount = layerCount + 1;
+	m_stats.budgetMs = slice.getBudgetMs();
+	m_stats.itemsLastFrame = 0;
+
+	while (slice.hasTimeLeft() && m_stats.itemsLastFrame < itemCount)
+	{
+		if (m_stats.nextItem == 0)
+		{
+			m_stats.memoryStats = Renderer::getMemoryStats();
+		}
+		else
+		{
+			constexpr float weight = 0.1f;
+			const LayerTimings& timings = (*(layerStack.begin() + (m_stats.nextItem - 1)))->getTimings();
+			LayerTimings& average = m_stats.averageTimings[m_stats.nextItem - 1];
+			average.fixedUpdateMs += (timings.fixedUpdateMs - average.fixedUpdateMs) * weight;
+			average.updateMs += (timings.updateMs - average.updateMs) * weight;
+			average.renderMs += (timings.renderMs - average.renderMs) * weight;
+			average.deferredMs += (timings.deferredMs - average.deferredMs) * weight;
+		}
+
+		m_stats.itemsLastFrame++;
+		if (++m_stats.nextItem == itemCount)
+		{
+			m_stats.nextItem = 0;
+			m_stats.rounds++;
+		}
+	}
 }
\ No newline at end of file
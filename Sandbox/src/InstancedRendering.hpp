@@ -12,9 +12,11 @@ public:
 	InstancedRendering();
 	virtual ~InstancedRendering();
 
+	virtual void onFixedUpdate(Shadow::Timestep step) override;
 	virtual void onUpdate(Shadow::Timestep ts) override; 
-	virtual void onRender() override;
+	virtual void onRender(float interpolationAlpha) override;
 	virtual void onImGuiRender() override;
+	virtual void onDeferredUpdate(const Shadow::TimeSlice& slice) override;
 private:
 	struct
 	{
@@ -50,10 +52,27 @@ private:
 	Shadow::Ref<Shadow::UniformBuffer> m_uniformBuffer;
 	Shadow::Ref<Shadow::StorageBuffer> m_trs;
 
-	Shadow::Ref<Shadow::VertexBuffer> m_instanceBuffer; 
+	// the instances are split into one buffer per draw chunk, the chunks are recorded in parallel
+	std::vector<Shadow::Ref<Shadow::VertexBuffer>> m_instanceChunks;
+	std::vector<uint32_t> m_instanceChunkCounts;
 	//Shadow::Ref<Shadow::RenderBuffer> m_instanceBuffer;
 
 	Shadow::PerspectiveCameraController m_cameraController;
+	// the camera moves in fixed steps, rendering interpolates between the positions of the last two
+	glm::vec3 m_previousCameraPos;
+	glm::vec3 m_currentCameraPos;
+
+	// the stats windows only show what the deferred update has gathered, it walks one item per step:
+	// the gpu memory stats first, then the timings of one layer each, until a round is done or the slice is used up
+	struct
+	{
+		Shadow::GpuMemoryStats memoryStats;
+		std::vector<Shadow::LayerTimings> averageTimings; // moving average, in layer stack order
+		uint32_t nextItem = 0;
+		uint32_t rounds = 0;
+		uint32_t itemsLastFrame = 0;
+		float budgetMs = 0.0f;
+	} m_stats;
 
 	uint32_t m_instanceCount = 0;
 	float m_aspectRatio;
@@ -4,10 +4,14 @@ using namespace Shadow;
 
 void Level::init()
 {
+	Renderer::beginResourceBatch();
+
 	m_ghosty = createScope<GhostyCat>();
 	m_demony = createScope<DemonyCat>();
 
 	m_background = Texture2D::create("C:/dev/Shadow/Sandbox/assets/textures/background.jpg");
+
+	Renderer::endResourceBatch();
 }
 
 void Level::onRender()
@@ -55,8 +55,6 @@ OffscreenRendering::OffscreenRendering()
 	m_offscreenData.ubo = UniformBuffer::create(m_offscreenData.shader->getResource("u_light").size);
 	m_offscreenData.shader->writeDescriptorSet("u_light", m_offscreenData.ubo);
 
-	m_offscreenData.shader->writeDescriptorSet("u_samplers", m_mesh);
-
 	m_light.position = glm::vec3(1.2f, 1.0f, 2.0f);
 	m_light.color = { 1.0f,1.0f,1.0f };
 
@@ -113,7 +111,7 @@ void OffscreenRendering::onUpdate(Timestep ts)
 	//	Shadow::ShEngine::getInstance().getWindow().setCursorMode(Shadow::CursorMode::Normal);
 }
 
-void OffscreenRendering::onRender()
+void OffscreenRendering::onRender(float interpolationAlpha)
 {
 	uint32_t width = 0, height = 0;
 	ShEngine::get().getWindow().getFramebufferSize(width, height);
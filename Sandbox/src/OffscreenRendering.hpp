@@ -25,7 +25,7 @@ public:
 	OffscreenRendering();
 
 	virtual void onUpdate(Shadow::Timestep ts) override;
-	virtual void onRender() override;
+	virtual void onRender(float interpolationAlpha) override;
 	virtual void onImGuiRender() override;
 
 	inline const Shadow::Ref<Shadow::Texture2D> getImage() const { return m_offscreenData.renderpass->getOutput(0); }
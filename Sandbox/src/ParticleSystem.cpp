@@ -17,6 +17,8 @@ void ParticleSystem::onAttach()
 {
     std::string assetsPath = "C:/dev/Shadow/Shadow/assets/";
 
+    EventDispatcher::get().addReciever(SH_CALLBACK(ParticleSystem::onMouseMove));
+
     m_textures.particle = Texture2D::create(assetsPath + "textures/cat.png");
     m_textures.gradient = Texture2D::create(assetsPath + "textures/cat.png");
     m_graphics.shader = Shader::create("particle", assetsPath + "shaders/particle.vert.spv", assetsPath+"shaders/particle.frag.spv");
@@ -91,11 +93,18 @@ void ParticleSystem::onDetach()
 {
 }
 
+void ParticleSystem::onFixedUpdate(Shadow::Timestep step)
+{
+    m_pendingSteps++;
+    m_fixedStep = step;
+}
+
 void ParticleSystem::onUpdate(Shadow::Timestep ts)
 {
     auto& win = ShEngine::get().getWindow();
 
-    m_compute.uniformData.deltaT = ts * 2.5f;
+    // every dispatch advances the particles by exactly one fixed step, the simulation doesn't depend on the frame rate
+    m_compute.uniformData.deltaT = m_fixedStep * 2.5f;
 
     float normalizedMx = (m_mousePos.x - static_cast<float>(win.getWidth() / 2)) / static_cast<float>(win.getWidth() / 2);
     float normalizedMy = (m_mousePos.y - static_cast<float>(win.getHeight() / 2)) / static_cast<float>(win.getHeight() / 2);
@@ -105,16 +114,23 @@ void ParticleSystem::onUpdate(Shadow::Timestep ts)
     m_compute.uniformBuffer->setData_RT(&m_compute.uniformData, sizeof(Compute::uniformData));
 }
 
-void ParticleSystem::onRender()
+void ParticleSystem::onRender(float interpolationAlpha)
 {
     auto& win = ShEngine::get().getWindow();
     Renderer::setViewport(0, 0, (float)win.getWidth(), (float)win.getHeight());
 
-    // compute pass
+    // compute pass, one dispatch per fixed step of this frame
+    // it's submitted even without a step, the graphics queue waits on it every frame
     {
         Renderer::beginCompute(m_compute.pipeline, 0);
-        Renderer::dispatch(s_particleCount / 256, 1, 1);
+        for (uint32_t i = 0; i < m_pendingSteps; i++)
+        {
+            if (i > 0)
+                Renderer::computeBarrier();
+            Renderer::dispatch(s_particleCount / 256, 1, 1);
+        }
         Renderer::submitCompute(PipelineStages::VertexInput);
+        m_pendingSteps = 0;
     }
 
     // graphics pass
@@ -139,8 +155,9 @@ void ParticleSystem::onImGuiRender()
     ImGui::End();
 }
 
-bool ParticleSystem::onMouseMove(const Shadow::MouseMovedEvent& e)
+bool ParticleSystem::onMouseMove(const Shadow::EventSpan<Shadow::MouseMovedEvent>& events)
 {
+    const Shadow::MouseMovedEvent& e = events.back();
     m_mousePos = { e.x,e.y };
     return false;
 }
@@ -7,11 +7,13 @@ class ParticleSystem : public Shadow::Layer
 public:
 	virtual void onAttach() override;
 	virtual void onDetach() override;
+	virtual void onFixedUpdate(Shadow::Timestep step) override;
 	virtual void onUpdate(Shadow::Timestep ts) override;
-	virtual void onRender() override;
+	virtual void onRender(float interpolationAlpha) override;
 	virtual void onImGuiRender() override;
 private:
-	bool onMouseMove(const Shadow::MouseMovedEvent& e);
+	// batch receiver, only the latest cursor position of a dispatch matters
+	bool onMouseMove(const Shadow::EventSpan<Shadow::MouseMovedEvent>& events);
 private:
 	struct Particle
 	{
@@ -27,6 +29,8 @@ private:
 	} m_textures;
 
 	glm::vec2 m_mousePos;
+	uint32_t m_pendingSteps = 0; // fixed steps that haven't been dispatched yet, one dispatch each
+	float m_fixedStep = 0.0f;
 
 	Shadow::Ref<Shadow::StorageBuffer> m_particles;
 
@@ -5,6 +5,10 @@
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/ext.hpp>
 
+#include <chrono>
+#include <limits>
+#include <random>
+
 Sandbox2D::Sandbox2D()
 	: m_cameraController(1280.0f/720.0f, true)
 {
@@ -27,7 +31,7 @@ void Sandbox2D::onUpdate(Shadow::Timestep ts)
 	m_cameraController.onUpdate(ts);
 }
 
-void Sandbox2D::onRender()
+void Sandbox2D::onRender(float interpolationAlpha)
 {
 	Shadow::Renderer2D::resetStats();
 
@@ -81,5 +85,64 @@ void Sandbox2D::onImGuiRender()
 	ImGui::Text("fps: %u", fps);
 	ImGui::Text("Frame time: %f ms", frameRate);
 	ImGui::ColorEdit3("Square color", &m_squareColor.x);
+
+	if (ImGui::Button("Benchmark quad build"))
+		benchmarkQuadBuild();
+	if (m_quadBuildBenchmark.done)
+	{
+		ImGui::Text("mat4: %.3f ms, simd: %.3f ms (x%.2f)", m_quadBuildBenchmark.referenceMs, m_quadBuildBenchmark.simdMs,
+			m_quadBuildBenchmark.referenceMs / m_quadBuildBenchmark.simdMs);
+		ImGui::Text("Max corner error: %g", m_quadBuildBenchmark.maxError);
+	}
 	ImGui::End();
 }
+
+void Sandbox2D::benchmarkQuadBuild()
+{
+	const uint32_t quadCount = 100 * 1024;
+	const uint32_t runs = 10;
+
+	std::mt19937 rng(42);
+	std::uniform_real_distribution<float> position(-100.0f, 100.0f), size(0.1f, 10.0f), angle(-720.0f, 720.0f);
+
+	std::vector<glm::vec3> positions(quadCount);
+	std::vector<glm::vec2> sizes(quadCount);
+	std::vector<float> angles(quadCount);
+	for (uint32_t i = 0; i < quadCount; i++)
+	{
+		positions[i] = { position(rng), position(rng), position(rng) };
+		sizes[i] = { size(rng), size(rng) };
+		angles[i] = angle(rng);
+	}
+
+	Shadow::RotatedQuads quads;
+	quads.count = quadCount;
+	quads.pPositions = positions.data();
+	quads.pSizes = sizes.data();
+	quads.pAngles = angles.data();
+
+	std::vector<Shadow::QuadVertex> reference(quadCount * 4), simd(quadCount * 4);
+
+	// best of the runs, the first ones warm up the caches
+	auto bestOf = [&](void (*build)(const Shadow::RotatedQuads&, Shadow::QuadVertex*), std::vector<Shadow::QuadVertex>& vertices)
+	{
+		double best = std::numeric_limits<double>::max();
+		for (uint32_t run = 0; run < runs; run++)
+		{
+			auto start = std::chrono::high_resolution_clock::now();
+			build(quads, vertices.data());
+			std::chrono::duration<double, std::milli> elapsed = std::chrono::high_resolution_clock::now() - start;
+			best = std::min(best, elapsed.count());
+		}
+		return best;
+	};
+
+	m_quadBuildBenchmark.referenceMs = bestOf(Shadow::QuadBuilder::buildReference, reference);
+	m_quadBuildBenchmark.simdMs = bestOf(Shadow::QuadBuilder::build, simd);
+
+	m_quadBuildBenchmark.maxError = 0.0f;
+	for (uint32_t i = 0; i < quadCount * 4; i++)
+		m_quadBuildBenchmark.maxError = std::max(m_quadBuildBenchmark.maxError, glm::length(reference[i].position - simd[i].position));
+
+	m_quadBuildBenchmark.done = true;
+}
@@ -11,12 +11,23 @@ public:
 	virtual void onAttach() override;
 	virtual void onDetach() override;
 	virtual void onUpdate(Shadow::Timestep ts) override;
-	virtual void onRender() override;
+	virtual void onRender(float interpolationAlpha) override;
 	virtual void onImGuiRender() override;
+private:
+	// mat4 reference against the simd kernel on the same quads
+	void benchmarkQuadBuild();
 private:
 	Shadow::OrthoCameraController m_cameraController;
 	glm::vec3 m_squareColor = { 0.0f, 0.2f, 0.8f };
 
 	Shadow::Ref<Shadow::Texture2D> m_catTex;
 	Shadow::Ref<Shadow::Texture2D> m_assasinTex;
+
+	struct QuadBuildBenchmark
+	{
+		bool done = false;
+		double referenceMs = 0.0;
+		double simdMs = 0.0;
+		float maxError = 0.0f;
+	} m_quadBuildBenchmark;
 };
@@ -8,10 +8,14 @@
 #include "GameLayer.hpp"
 #include "ParticleSystem.hpp"
 
+#include <cstring>
+#include <cstdlib>
+
 class SandboxGame : public Shadow::ShEngine
 {
 public:
-	SandboxGame()
+	SandboxGame(const Shadow::EngineProperties& properties)
+		: Shadow::ShEngine(properties)
 	{
 		//pushLayer(new GameLayer());
 		//pushLayer(new OffscreenRendering());
@@ -21,7 +25,31 @@ public:
 	}
 };
 
-Shadow::ShEngine* Shadow::createApp()
+// --headless [frames] renders the layers offscreen for a fixed number of frames (1000 by default)
+// --record-input <file> / --replay-input <file> capture the input of a run and play it back for repeatable perf comparisons
+Shadow::ShEngine* Shadow::createApp(int argc, char** argv)
 {
-	return new SandboxGame();
+	Shadow::EngineProperties properties;
+
+	for (int i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--headless"))
+		{
+			properties.headless = true;
+			properties.frameCount = 1000;
+
+			if (i + 1 < argc && atoi(argv[i + 1]) > 0)
+				properties.frameCount = static_cast<uint32_t>(atoi(argv[++i]));
+		}
+		else if (!strcmp(argv[i], "--render-thread"))
+			properties.renderThread = true;
+		else if (!strcmp(argv[i], "--input-thread"))
+			properties.inputThread = true;
+		else if (!strcmp(argv[i], "--record-input") && i + 1 < argc)
+			properties.recordInputPath = argv[++i];
+		else if (!strcmp(argv[i], "--replay-input") && i + 1 < argc)
+			properties.replayInputPath = argv[++i];
+	}
+
+	return new SandboxGame(properties);
 }
\ No newline at end of file
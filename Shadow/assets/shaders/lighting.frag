@@ -1,4 +1,5 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec4 out_color;
 
@@ -12,7 +13,8 @@ layout(set = 0, binding = 0) uniform Light {
 	vec3 color;
 } u_light;
 
-layout(set = 0, binding = 1) uniform sampler2D u_samplers[32];
+// the engine's texture heap, v_materialIndex is the heap index of the material's texture
+layout(set = 3, binding = 0) uniform sampler2D u_textures[];
 
 void main() {
 
@@ -24,6 +26,6 @@ void main() {
 	float diff = max(dot(lightDir, norm), 0.0);
 	vec3 diffuse = diff * u_light.color;
 
-	vec4 color = texture(u_samplers[v_materialIndex], v_texCoords);
+	vec4 color = texture(u_textures[nonuniformEXT(v_materialIndex)], v_texCoords);
 	out_color = vec4(color.rgb * (ambient + diffuse), 1.0);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #version 450 core
+#extension GL_EXT_nonuniform_qualifier : require
 
 layout(location = 0) out vec4 o_color;
 
@@ -7,11 +8,12 @@ layout(location = 1) in vec2 v_texCoords;
 layout(location = 2) in flat uint v_texIndex;
 layout(location = 3) in flat float v_tilingFactor;
 
-layout(set = 0, binding = 0) uniform sampler2D u_samplers[10];
+// the engine's texture heap, v_texIndex is Texture2D::getHeapIndex()
+layout(set = 3, binding = 0) uniform sampler2D u_textures[];
 
 void main()
 {
-	vec4 color = v_color * texture(u_samplers[v_texIndex], v_texCoords * v_tilingFactor);
+	vec4 color = v_color * texture(u_textures[nonuniformEXT(v_texIndex)], v_texCoords * v_tilingFactor);
 
 	if (color.a == 0.0)
 		discard;
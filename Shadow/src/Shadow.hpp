@@ -4,15 +4,18 @@
 #include "Shadow/Core/Core.hpp"
 #include "Shadow/Core/ShEngine.hpp"
 #include "Shadow/WindowLayer/Input.hpp"
+#include "Shadow/WindowLayer/InputRecorder.hpp"
 #include "Shadow/Core/InputDefines.hpp"
 #include "Shadow/Renderer/Camera.hpp"
 #include "Shadow/Renderer/CameraController.hpp"
 		 
 #include "Shadow/Core/Timestep.hpp"
+#include "Shadow/Core/JobSystem.hpp"
 
 // -- Renderer --------------------------
 #include "Shadow/Renderer/Renderer.hpp"
 #include "Shadow/Renderer/Renderer2D.hpp"
+#include "Shadow/Renderer/QuadBuilder.hpp"
 #include "Shadow/Renderer/Pipeline.hpp"
 #include "Shadow/Renderer/Renderpass.hpp"
 #include "Shadow/Renderer/Shader.hpp"
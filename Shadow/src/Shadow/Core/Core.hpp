@@ -1,5 +1,11 @@
 #pragma once
 
+#include "Shadow/Core/Delegate.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
 #ifdef SH_DEBUG
 	#define SH_ASSERT(condition, message, ...) if(!condition)\
 	{_log("[ASSERTION FAILED]:", message, TEXT_COLOR_BRIGHT_MAGENTA, ##__VA_ARGS__);\
@@ -9,7 +15,8 @@
 	#define SH_ASSERT(condition, ...)
 #endif 
 
-#define SH_CALLBACK(function) std::bind(&function, this, std::placeholders::_1)
+// binds a member function to this as a non-allocating Delegate
+#define SH_CALLBACK(function) ::Shadow::bindDelegate<&function>(this)
 
 #define SH_FLAG(type) bool operator&(type arg1, type arg2);\
 type operator|(type arg1, type arg2);\
@@ -56,126 +63,148 @@ namespace Shadow
 		return std::make_unique<T>(std::forward<Args>(args)...);
 	}
 
+    // control block shared by all Refs of an object. createRef allocates it together with the object
+    struct RefCounter
+    {
+        std::atomic<uint32_t> count{ 1 };
+        void (*destroy)(RefCounter* pCounter) = nullptr; // destroys the object as the type it was created with
+    };
+
+    template<typename T>
+    struct RefBlock : RefCounter
+    {
+        alignas(T) unsigned char storage[sizeof(T)];
+
+        inline T* get() { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    // thread safe reference counting, objects are created with createRef
     template<typename T>
     class Ref
     {
     public:
-        Ref()
-            : m_counter(new int(1))
-        {
-        }
+        Ref() = default;
 
-        Ref(T* ptr)
-            : m_ptr(ptr), m_counter(new int(1))
+        Ref(std::nullptr_t)
         {
         }
 
-        template<typename U>
-        Ref(U* ptr, int* counter)
-            : m_ptr(static_cast<T*>(ptr)), m_counter(counter)
+        ~Ref()
         {
-            if (m_ptr)
-                (*m_counter)++;
+            release();
         }
 
-        ~Ref()
+        Ref(const Ref<T>& other)
+            : m_ptr(other.m_ptr), m_counter(other.m_counter)
         {
-            if (m_ptr && --(*m_counter) == 0)
-            {
-                delete m_counter;
-                delete m_ptr;
-            }
+            retain();
         }
 
-        Ref(const Ref<T>& other)
+        Ref(Ref<T>&& other) noexcept
             : m_ptr(other.m_ptr), m_counter(other.m_counter)
         {
-            if (m_ptr)
-                (*m_counter)++;
+            other.m_ptr = nullptr;
+            other.m_counter = nullptr;
         }
 
         Ref<T>& operator=(const Ref<T>& other)
         {
-            if (this != &other)
-            {
-                if (m_ptr && --(*m_counter) == 0)
-                {
-                    delete m_ptr;
-                    delete m_counter;
-                }
-
-                m_ptr = other.m_ptr;
-                m_counter = other.m_counter;
-
-                if (m_ptr)
-                    (*m_counter)++;
-            }
+            Ref<T>(other).swap(*this);
             return *this;
         }
 
         Ref<T>& operator=(Ref<T>&& other) noexcept
         {
-            m_ptr = other.m_ptr;
-            other.m_ptr = nullptr;
-            m_counter = other.m_counter;
-            other.m_counter = nullptr;
+            Ref<T>(std::move(other)).swap(*this);
             return *this;
         }
 
-        const Ref<T>& operator =(T* ptr)
+        Ref<T>& operator=(std::nullptr_t)
         {
-            if (m_ptr && --(*m_counter) == 0)
-            {
-                delete m_ptr;
-                delete m_counter;
-            }
-
-            m_ptr = ptr;
-            m_counter = new int(1);
-
+            release();
             return *this;
         }
 
         T* operator->() const { return m_ptr; }
+        T& operator*() const { return *m_ptr; }
         bool operator !() const { return !m_ptr; }
         operator bool() const { return m_ptr != nullptr; }
 
+        template<typename U>
+        bool operator==(const Ref<U>& other) const { return m_ptr == other.get(); }
+        template<typename U>
+        bool operator!=(const Ref<U>& other) const { return m_ptr != other.get(); }
+
+        // owning conversion along the class hierarchy, use as<U>() when a non-owning pointer is enough
         template<typename U>
         operator Ref<U>() const
         {
-            SH_ASSERT((std::is_base_of<T, U>() || std::is_base_of<U, T>()), "invalid type conversion");
-            return Ref<U>(m_ptr, m_counter);
+            static_assert(std::is_base_of_v<T, U> || std::is_base_of_v<U, T>, "invalid type conversion");
+            retain();
+            return Ref<U>(static_cast<U*>(m_ptr), m_counter);
         }
 
         void release()
         {
-            if (m_ptr && --(*m_counter) == 0)
-            {
-                delete m_ptr;
-                delete m_counter;
-                return;
-            }
+            if (m_counter && m_counter->count.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                m_counter->destroy(m_counter);
 
             m_ptr = nullptr;
+            m_counter = nullptr;
         }
 
-        int getCount() const { return *m_counter; }
+        void swap(Ref<T>& other) noexcept
+        {
+            std::swap(m_ptr, other.m_ptr);
+            std::swap(m_counter, other.m_counter);
+        }
+
+        uint32_t getCount() const { return m_counter ? m_counter->count.load(std::memory_order_relaxed) : 0; }
         T* get() const { return m_ptr; }
+    private:
+        template<typename U>
+        friend class Ref;
+
+        template<typename U, typename ...Args>
+        friend Ref<U> createRef(Args&& ...args);
+
+        // adopts a reference that has already been counted
+        Ref(T* ptr, RefCounter* counter)
+            : m_ptr(ptr), m_counter(counter)
+        {
+        }
+
+        void retain() const
+        {
+            if (m_counter)
+                m_counter->count.fetch_add(1, std::memory_order_relaxed);
+        }
     private:
         T* m_ptr = nullptr;
-        int* m_counter;
+        RefCounter* m_counter = nullptr;
     };
 
+    // one allocation for the object and its counter
 	template<typename T, typename ...Args>
-	constexpr Ref<T> createRef(Args&& ...args)
+	Ref<T> createRef(Args&& ...args)
 	{
-        return Ref<T>(new T(args...));
+        RefBlock<T>* pBlock = new RefBlock<T>();
+        new (pBlock->storage) T(std::forward<Args>(args)...);
+        pBlock->destroy = [](RefCounter* pCounter)
+        {
+            RefBlock<T>* pBlock = static_cast<RefBlock<T>*>(pCounter);
+            pBlock->get()->~T();
+            delete pBlock;
+        };
+
+        return Ref<T>(pBlock->get(), pBlock);
 	}
 
+    // non-owning cast, the pointer is valid as long as the Ref it came from
     template<typename T, typename U>
-    Ref<T> as(const Ref<U>& ref)
+    T* as(const Ref<U>& ref)
     {
-        return static_cast<Ref<T>>(ref);
+        return static_cast<T*>(ref.get());
     }
 
 	template<typename T, const uint32_t maxSize>
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace Shadow
+{
+	// signature of a member function pointer or of a functor's operator()
+	template<typename F>
+	struct CallableTraits : CallableTraits<decltype(&std::decay_t<F>::operator())> {};
+
+	template<typename R, typename C, typename ...Args>
+	struct CallableTraits<R(C::*)(Args...)>
+	{
+		using Class = C;
+		using Signature = R(Args...);
+
+		template<size_t index>
+		using Arg = std::tuple_element_t<index, std::tuple<Args...>>;
+	};
+
+	template<typename R, typename C, typename ...Args>
+	struct CallableTraits<R(C::*)(Args...) const> : CallableTraits<R(C::*)(Args...)> {};
+
+	template<typename Signature, size_t StorageSize = 2 * sizeof(void*)>
+	class Delegate;
+
+	// non-allocating std::function replacement: the callable lives in the delegate itself and a call is a single indirect jump.
+	// only small, trivially copyable callables fit (member function bindings, lambdas capturing a few pointers)
+	template<typename R, typename ...Args, size_t StorageSize>
+	class Delegate<R(Args...), StorageSize>
+	{
+	public:
+		Delegate() = default;
+
+		template<typename F, typename = std::enable_if_t<!std::is_same_v<std::decay_t<F>, Delegate>>>
+		Delegate(F&& func)
+		{
+			using Callable = std::decay_t<F>;
+			static_assert(sizeof(Callable) <= StorageSize, "callable doesn't fit into the delegate, capture less o^o");
+			static_assert(alignof(Callable) <= alignof(void*), "callable is over-aligned for the delegate :<");
+			static_assert(std::is_trivially_copyable_v<Callable> && std::is_trivially_destructible_v<Callable>,
+				"delegates only hold trivially copyable callables, capture pointers instead of objects :<");
+
+			new (m_storage) Callable(std::forward<F>(func));
+			m_invoke = [](const void* pStorage, Args... args) -> R
+			{
+				return (*static_cast<const Callable*>(pStorage))(std::forward<Args>(args)...);
+			};
+		}
+
+		template<auto Method, typename C>
+		static Delegate bind(C* pInstance)
+		{
+			return Delegate([pInstance](Args... args) -> R { return (pInstance->*Method)(std::forward<Args>(args)...); });
+		}
+
+		inline R operator()(Args... args) const { return m_invoke(m_storage, std::forward<Args>(args)...); }
+		inline explicit operator bool() const { return m_invoke != nullptr; }
+	private:
+		using InvokeFn = R(*)(const void*, Args...);
+
+		alignas(void*) unsigned char m_storage[StorageSize] = {};
+		InvokeFn m_invoke = nullptr;
+	};
+
+	template<auto Method>
+	auto bindDelegate(typename CallableTraits<decltype(Method)>::Class* pInstance)
+	{
+		return Delegate<typename CallableTraits<decltype(Method)>::Signature>::template bind<Method>(pInstance);
+	}
+}
@@ -2,12 +2,12 @@
 #include "Shadow/Core/Core.hpp"
 #include "Shadow/Debug/Instrumentor.hpp"
 
-extern Shadow::ShEngine* Shadow::createApp();
+extern Shadow::ShEngine* Shadow::createApp(int argc, char** argv);
 
 int main(int argc, char** argv)
 {
 	SH_PROFILE_BEGIN_SESSION("startup", "ShadowProfile-startup.json")
-	auto game = Shadow::createApp();
+	auto game = Shadow::createApp(argc, argv);
 	SH_PROFILE_END_SESSION();
 
 	SH_PROFILE_BEGIN_SESSION("runtime", "ShadowProfile-runtime.json");
@@ -0,0 +1,180 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+// constant initialized, operator new is called before any dynamic initialization
+static std::atomic<uint64_t> s_heapAllocations{ 0 };
+
+#ifdef SH_DEBUG
+void* operator new(size_t size)
+{
+	s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* ptr = std::malloc(size ? size : 1))
+		return ptr;
+
+	throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept
+{
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept
+{
+	std::free(ptr);
+}
+#endif
+
+namespace Shadow
+{
+	LinearArena::LinearArena(size_t blockSize)
+		: m_blockSize(blockSize)
+	{
+	}
+
+	LinearArena::~LinearArena()
+	{
+		for (Block& block : m_blocks)
+			delete[] block.pData;
+	}
+
+	void* LinearArena::allocate(size_t size, size_t alignment)
+	{
+		while (m_currentBlock < m_blocks.size())
+		{
+			const Block& block = m_blocks[m_currentBlock];
+			const uintptr_t base = reinterpret_cast<uintptr_t>(block.pData);
+			const uintptr_t aligned = (base + m_offset + alignment - 1) & ~static_cast<uintptr_t>(alignment - 1);
+			const size_t offset = static_cast<size_t>(aligned - base);
+
+			if (offset + size <= block.size)
+			{
+				m_offset = offset + size;
+				return block.pData + offset;
+			}
+
+			m_currentBlock++;
+			m_offset = 0;
+		}
+
+		// only happens until the arena has grown to the working size of a frame
+		const size_t blockSize = std::max(m_blockSize, size + alignment);
+		m_blocks.push_back({ new uint8_t[blockSize], blockSize });
+		m_currentBlock = static_cast<uint32_t>(m_blocks.size()) - 1;
+		m_offset = 0;
+
+		return allocate(size, alignment);
+	}
+
+	void LinearArena::reset()
+	{
+		m_currentBlock = 0;
+		m_offset = 0;
+	}
+
+
+	static constexpr uint32_t s_maxArenaThreads = 64;
+
+	struct FrameAllocatorData
+	{
+		// arenas[frame][thread slot], created by the owning thread on its first allocation
+		std::vector<std::array<Scope<LinearArena>, s_maxArenaThreads>> arenas;
+		std::atomic<uint32_t> currentFrame{ 0 };
+		std::atomic<uint64_t> usedSlots{ 0 };
+		std::atomic<uint32_t> heapBlocks{ 0 };
+	};
+
+	static FrameAllocatorData* s_data = nullptr;
+
+	// a thread keeps its slot (and with it its arenas) until it exits, short lived threads don't use up the slots
+	struct ThreadSlot
+	{
+		uint32_t index = UINT32_MAX;
+
+		~ThreadSlot()
+		{
+			if (index != UINT32_MAX && s_data)
+				s_data->usedSlots.fetch_and(~(1ull << index), std::memory_order_release);
+		}
+
+		uint32_t acquire()
+		{
+			uint64_t used = s_data->usedSlots.load(std::memory_order_relaxed);
+			do
+			{
+				SH_ASSERT((used != UINT64_MAX), "too many threads use the frame allocator :<");
+
+				index = 0;
+				while (used & (1ull << index))
+					index++;
+			} while (!s_data->usedSlots.compare_exchange_weak(used, used | (1ull << index), std::memory_order_acquire, std::memory_order_relaxed));
+
+			return index;
+		}
+	};
+
+	static thread_local ThreadSlot s_threadSlot;
+
+	void FrameAllocator::init(uint32_t framesInFlight)
+	{
+		s_data = new FrameAllocatorData();
+		s_data->arenas.resize(framesInFlight);
+	}
+
+	void FrameAllocator::shutdown()
+	{
+		delete s_data;
+		s_data = nullptr;
+	}
+
+	void FrameAllocator::beginFrame(uint32_t frameIndex)
+	{
+		for (Scope<LinearArena>& arena : s_data->arenas[frameIndex])
+		{
+			if (arena)
+				arena->reset();
+		}
+
+		s_data->currentFrame.store(frameIndex, std::memory_order_relaxed);
+	}
+
+	void* FrameAllocator::allocate(size_t size, size_t alignment)
+	{
+		const uint32_t slot = s_threadSlot.index != UINT32_MAX ? s_threadSlot.index : s_threadSlot.acquire();
+
+		Scope<LinearArena>& arena = s_data->arenas[s_data->currentFrame.load(std::memory_order_relaxed)][slot];
+		if (!arena)
+			arena = createScope<LinearArena>();
+
+		const uint32_t blockCount = arena->getBlockCount();
+		void* pMemory = arena->allocate(size, alignment);
+
+		if (arena->getBlockCount() != blockCount)
+			s_data->heapBlocks.fetch_add(1, std::memory_order_relaxed);
+
+		return pMemory;
+	}
+
+	uint32_t FrameAllocator::getHeapBlockCount()
+	{
+		return s_data->heapBlocks.load(std::memory_order_relaxed);
+	}
+
+	void FrameAllocator::countHeapAllocation()
+	{
+#ifdef SH_DEBUG
+		s_heapAllocations.fetch_add(1, std::memory_order_relaxed);
+#endif
+	}
+
+	uint64_t FrameAllocator::getHeapAllocationCount()
+	{
+		return s_heapAllocations.load(std::memory_order_relaxed);
+	}
+}
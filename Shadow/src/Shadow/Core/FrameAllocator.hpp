@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Shadow
+{
+	// bump allocator over a list of blocks. reset() keeps the blocks, so once it has grown to its working size it never touches the heap again
+	class LinearArena
+	{
+	public:
+		LinearArena(size_t blockSize = 256 * 1024);
+		~LinearArena();
+		LinearArena(const LinearArena& other) = delete;
+		LinearArena& operator=(const LinearArena& other) = delete;
+
+		void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+		void reset();
+
+		inline uint32_t getBlockCount() const { return static_cast<uint32_t>(m_blocks.size()); }
+	private:
+		struct Block
+		{
+			uint8_t* pData;
+			size_t size;
+		};
+
+		std::vector<Block> m_blocks;
+		uint32_t m_currentBlock = 0;
+		size_t m_offset = 0;
+		size_t m_blockSize;
+	};
+
+	// transient cpu memory of a frame: one LinearArena per frame in flight and per thread, nothing is freed individually.
+	// the arenas of a frame are reset wholesale once its fence has signaled, so an allocation stays valid
+	// until the same frame index comes around again
+	class FrameAllocator
+	{
+	public:
+		static void init(uint32_t framesInFlight);
+		static void shutdown();
+
+		// frame thread, after the fence of frameIndex has signaled. no other thread may allocate meanwhile
+		static void beginFrame(uint32_t frameIndex);
+
+		// any thread, every thread bumps its own arena
+		static void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+
+		template<typename T>
+		static T* allocateArray(size_t count) { return static_cast<T*>(allocate(sizeof(T) * count, alignof(T))); }
+
+		// heap blocks the arenas have allocated since init, stays constant once the frames have reached their steady state
+		static uint32_t getHeapBlockCount();
+
+		// debug builds count every global operator new of the process, plus the allocators that report themselves here (ImGui).
+		// the difference between two frames is what a frame has allocated, release builds always return 0
+		static void countHeapAllocation();
+		static uint64_t getHeapAllocationCount();
+	};
+
+	// STL adaptor, deallocation is a no-op. containers using it must not outlive the frame
+	template<typename T>
+	class FrameStlAllocator
+	{
+	public:
+		using value_type = T;
+
+		FrameStlAllocator() = default;
+
+		template<typename U>
+		FrameStlAllocator(const FrameStlAllocator<U>& other) {}
+
+		T* allocate(size_t count) { return FrameAllocator::allocateArray<T>(count); }
+		void deallocate(T* ptr, size_t count) {}
+
+		template<typename U>
+		bool operator==(const FrameStlAllocator<U>& other) const { return true; }
+		template<typename U>
+		bool operator!=(const FrameStlAllocator<U>& other) const { return false; }
+	};
+
+	template<typename T>
+	using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+}
@@ -0,0 +1,199 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+#include "Shadow/Core/JobSystem.hpp"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+
+namespace Shadow
+{
+	struct JobEntry
+	{
+		Job job;
+		std::atomic<uint32_t>* pending = nullptr;
+	};
+
+	struct WorkQueue
+	{
+		std::mutex mutex;
+		std::deque<JobEntry> jobs;
+	};
+
+	struct JobSystemData
+	{
+		std::vector<std::thread> workers;
+		// queues[0] is shared by the threads that don't belong to the job system
+		std::vector<Scope<WorkQueue>> queues;
+
+		std::mutex sleepMutex;
+		std::condition_variable wakeCondition;
+		std::atomic<uint32_t> queuedJobs{ 0 };
+		std::atomic<bool> running{ true };
+	};
+
+	static JobSystemData* s_data = nullptr;
+	static thread_local uint32_t s_threadIndex = 0;
+
+	static bool popJob(uint32_t threadIndex, JobEntry& outEntry)
+	{
+		WorkQueue& ownQueue = *s_data->queues[threadIndex];
+		{
+			std::scoped_lock<std::mutex> lock(ownQueue.mutex);
+			if (!ownQueue.jobs.empty())
+			{
+				outEntry = std::move(ownQueue.jobs.back());
+				ownQueue.jobs.pop_back();
+				return true;
+			}
+		}
+
+		const uint32_t queueCount = static_cast<uint32_t>(s_data->queues.size());
+		for (uint32_t i = 1; i < queueCount; i++)
+		{
+			WorkQueue& victim = *s_data->queues[(threadIndex + i) % queueCount];
+
+			std::scoped_lock<std::mutex> lock(victim.mutex);
+			if (!victim.jobs.empty())
+			{
+				outEntry = std::move(victim.jobs.front());
+				victim.jobs.pop_front();
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	static bool runPendingJob(uint32_t threadIndex)
+	{
+		JobEntry entry;
+		if (!popJob(threadIndex, entry))
+			return false;
+
+		s_data->queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+		entry.job();
+
+		if (entry.pending)
+			entry.pending->fetch_sub(1, std::memory_order_acq_rel);
+
+		return true;
+	}
+
+	static void workerLoop(uint32_t threadIndex)
+	{
+		s_threadIndex = threadIndex;
+
+		while (s_data->running.load(std::memory_order_acquire))
+		{
+			if (runPendingJob(threadIndex))
+				continue;
+
+			std::unique_lock<std::mutex> lock(s_data->sleepMutex);
+			s_data->wakeCondition.wait(lock, []()
+				{ return s_data->queuedJobs.load(std::memory_order_acquire) > 0 || !s_data->running.load(std::memory_order_acquire); });
+		}
+	}
+
+	void JobSystem::init(uint32_t workerCount)
+	{
+		SH_ASSERT(!s_data, "job system has already been initialized o^o");
+
+		if (workerCount == 0)
+		{
+			const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+			workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+		}
+
+		s_data = new JobSystemData();
+		s_data->queues.reserve(workerCount + 1);
+		for (uint32_t i = 0; i <= workerCount; i++)
+			s_data->queues.emplace_back(createScope<WorkQueue>());
+
+		s_data->workers.reserve(workerCount);
+		for (uint32_t i = 1; i <= workerCount; i++)
+			s_data->workers.emplace_back(workerLoop, i);
+	}
+
+	void JobSystem::shutdown()
+	{
+		// jobs that are still queued are finished by the caller, nobody else is going to pick them up
+		while (runPendingJob(s_threadIndex)) {}
+
+		{
+			std::scoped_lock<std::mutex> lock(s_data->sleepMutex);
+			s_data->running.store(false, std::memory_order_release);
+		}
+		s_data->wakeCondition.notify_all();
+
+		for (std::thread& worker : s_data->workers)
+			worker.join();
+
+		delete s_data;
+		s_data = nullptr;
+	}
+
+	void JobSystem::schedule(Job job, JobCounter* counter)
+	{
+		SH_ASSERT(s_data, "job system hasn't been initialized :<");
+
+		if (counter)
+			counter->m_pending.fetch_add(1, std::memory_order_relaxed);
+
+		{
+			WorkQueue& queue = *s_data->queues[s_threadIndex];
+			std::scoped_lock<std::mutex> lock(queue.mutex);
+			queue.jobs.push_back({ std::move(job), counter ? &counter->m_pending : nullptr });
+		}
+
+		// taking the sleep mutex guarantees that a worker which has just checked the predicate is already waiting
+		{
+			std::scoped_lock<std::mutex> lock(s_data->sleepMutex);
+			s_data->queuedJobs.fetch_add(1, std::memory_order_release);
+		}
+		s_data->wakeCondition.notify_one();
+	}
+
+	void JobSystem::wait(JobCounter& counter)
+	{
+		SH_PROFILE_FUNCTION();
+
+		while (!counter.isDone())
+		{
+			if (!runPendingJob(s_threadIndex))
+				std::this_thread::yield();
+		}
+	}
+
+	void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& func, JobCounter& counter)
+	{
+		if (count == 0)
+			return;
+
+		batchSize = batchSize == 0 ? 1 : batchSize;
+
+		for (uint32_t first = 0; first < count; first += batchSize)
+		{
+			const uint32_t last = std::min(first + batchSize, count);
+			schedule([func, first, last]() { func(first, last); }, &counter);
+		}
+	}
+
+	void JobSystem::parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& func)
+	{
+		JobCounter counter;
+		parallelFor(count, batchSize, func, counter);
+		wait(counter);
+	}
+
+	uint32_t JobSystem::getWorkerCount()
+	{
+		return s_data ? static_cast<uint32_t>(s_data->workers.size()) : 0;
+	}
+
+	uint32_t JobSystem::getThreadIndex()
+	{
+		return s_threadIndex;
+	}
+}
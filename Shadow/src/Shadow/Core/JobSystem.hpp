@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+namespace Shadow
+{
+	using Job = std::function<void()>;
+
+	// tracks the jobs that were scheduled with it, the counter has to outlive all of them
+	class JobCounter
+	{
+	public:
+		JobCounter() = default;
+		JobCounter(const JobCounter& other) = delete;
+		JobCounter& operator=(const JobCounter& other) = delete;
+
+		inline bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+		inline uint32_t getPendingCount() const { return m_pending.load(std::memory_order_acquire); }
+	private:
+		std::atomic<uint32_t> m_pending{ 0 };
+
+		friend class JobSystem;
+	};
+
+	// fixed pool of worker threads, each with its own deque. owners pop from the back, idle workers steal from the front of the others
+	class JobSystem
+	{
+	public:
+		// workerCount == 0 -> hardware_concurrency - 1 workers (the main thread helps while waiting)
+		static void init(uint32_t workerCount = 0);
+		static void shutdown();
+
+		static void schedule(Job job, JobCounter* counter = nullptr);
+
+		// the calling thread executes pending jobs until the counter drops to zero
+		static void wait(JobCounter& counter);
+
+		// func(first, last) is invoked for [first, last) ranges of at most batchSize elements
+		static void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& func, JobCounter& counter);
+		static void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t)>& func);
+
+		static uint32_t getWorkerCount();
+
+		// 0 for any thread that isn't owned by the job system (main thread), 1..workerCount for the workers
+		static uint32_t getThreadIndex();
+	};
+}
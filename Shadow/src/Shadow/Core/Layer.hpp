@@ -2,17 +2,82 @@
 
 #include "Shadow/Core/Timestep.hpp"
 
+#include <chrono>
+
 namespace Shadow
 {
+	// deferred work of higher priority layers is scheduled first when the frame budget runs short
+	enum class LayerPriority : uint8_t
+	{
+		High,
+		Normal,
+		Background
+	};
+
+	// the part of the frame budget a layer may spend in onDeferredUpdate
+	class TimeSlice
+	{
+	public:
+		TimeSlice(float budgetMs)
+			: m_start(std::chrono::steady_clock::now()), m_budgetMs(budgetMs)
+		{
+		}
+
+		inline float getElapsedMs() const { return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_start).count(); }
+		inline float getRemainingMs() const { return m_budgetMs - getElapsedMs(); }
+		inline bool hasTimeLeft() const { return getElapsedMs() < m_budgetMs; }
+		inline float getBudgetMs() const { return m_budgetMs; }
+	private:
+		std::chrono::steady_clock::time_point m_start;
+		float m_budgetMs;
+	};
+
+	// cpu time of the last frame, measured by the LayerStack
+	struct LayerTimings
+	{
+		float fixedUpdateMs = 0.0f;
+		float updateMs = 0.0f;
+		float renderMs = 0.0f;
+		float deferredMs = 0.0f;
+		uint32_t skippedFrames = 0; // frames in a row the deferred work didn't fit into the frame budget
+	};
+
 	class Layer
 	{
 	public:
+		Layer(const char* name = "Layer")
+			: m_name(name)
+		{
+		}
 		virtual ~Layer() {}
 
 		virtual void onAttach() {}
 		virtual void onDetach() {}
+		// called at EngineProperties::fixedTimestep intervals (zero or more times per frame) before onUpdate
+		virtual void onFixedUpdate(Timestep step) {}
 		virtual void onUpdate(Timestep ts) {}
-		virtual void onRender() {}
+		// interpolationAlpha is the fraction of a fixed step the simulation is behind the frame, in [0, 1)
+		// with EngineProperties::renderThread this runs ahead of the GPU work, draw through the Renderer facade only
+		virtual void onRender(float interpolationAlpha) {}
 		virtual void onImGuiRender() {}
+		// work that may be spread over several frames (streaming, stats, background simulation).
+		// only called for layers with a deferred budget, and only while the frame has time left. keep slicing the work until slice.hasTimeLeft() is false
+		virtual void onDeferredUpdate(const TimeSlice& slice) {}
+
+		inline const char* getName() const { return m_name; }
+		inline LayerPriority getPriority() const { return m_priority; }
+		inline float getDeferredBudget() const { return m_deferredBudgetMs; }
+		inline const LayerTimings& getTimings() const { return m_timings; }
+	protected:
+		inline void setPriority(LayerPriority priority) { m_priority = priority; }
+		// upper bound of onDeferredUpdate per frame, 0 means the layer has no deferred work
+		inline void setDeferredBudget(float budgetMs) { m_deferredBudgetMs = budgetMs; }
+	private:
+		friend class LayerStack;
+
+		const char* m_name;
+		LayerPriority m_priority = LayerPriority::Normal;
+		float m_deferredBudgetMs = 0.0f;
+		LayerTimings m_timings;
 	};
-}
\ No newline at end of file
+}
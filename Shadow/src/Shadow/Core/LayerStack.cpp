@@ -3,6 +3,11 @@
 
 namespace Shadow
 {
+	static float elapsedMs(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
 	LayerStack::LayerStack()
 	{
 	}
@@ -42,4 +47,88 @@ namespace Shadow
 		if (it != m_layers.cend())
 			m_layers.erase(it);
 	}
+
+	void LayerStack::fixedUpdate(Timestep step, uint32_t stepCount)
+	{
+		for (Layer* layer : m_layers)
+			layer->m_timings.fixedUpdateMs = 0.0f;
+
+		for (uint32_t i = 0; i < stepCount; i++)
+		{
+			for (Layer* layer : m_layers)
+			{
+				auto start = std::chrono::steady_clock::now();
+				layer->onFixedUpdate(step);
+				layer->m_timings.fixedUpdateMs += elapsedMs(start);
+			}
+		}
+	}
+
+	void LayerStack::update(Timestep ts)
+	{
+		for (Layer* layer : m_layers)
+		{
+			auto start = std::chrono::steady_clock::now();
+			layer->onUpdate(ts);
+			layer->m_timings.updateMs = elapsedMs(start);
+		}
+	}
+
+	void LayerStack::render(float interpolationAlpha)
+	{
+		for (Layer* layer : m_layers)
+		{
+			auto start = std::chrono::steady_clock::now();
+			layer->onRender(interpolationAlpha);
+			layer->m_timings.renderMs = elapsedMs(start);
+		}
+	}
+
+	void LayerStack::runDeferredUpdates(float remainingFrameMs)
+	{
+		SH_PROFILE_FUNCTION();
+
+		m_deferredQueue.clear();
+		for (Layer* layer : m_layers)
+		{
+			layer->m_timings.deferredMs = 0.0f;
+
+			if (layer->m_deferredBudgetMs > 0.0f)
+				m_deferredQueue.push_back(layer);
+		}
+
+		// starving layers first, then by priority, the most skipped layer first within a priority
+		std::stable_sort(m_deferredQueue.begin(), m_deferredQueue.end(), [](const Layer* a, const Layer* b)
+			{
+				const bool aStarving = a->m_timings.skippedFrames >= s_maxSkippedFrames;
+				const bool bStarving = b->m_timings.skippedFrames >= s_maxSkippedFrames;
+				if (aStarving != bStarving)
+					return aStarving;
+
+				if (a->m_priority != b->m_priority)
+					return a->m_priority < b->m_priority;
+
+				return a->m_timings.skippedFrames > b->m_timings.skippedFrames;
+			});
+
+		auto start = std::chrono::steady_clock::now();
+		for (Layer* layer : m_deferredQueue)
+		{
+			const float remainingMs = remainingFrameMs - elapsedMs(start);
+			const bool starving = layer->m_timings.skippedFrames >= s_maxSkippedFrames;
+
+			if (remainingMs <= 0.0f && !starving)
+			{
+				layer->m_timings.skippedFrames++;
+				continue;
+			}
+
+			const float sliceMs = starving ? layer->m_deferredBudgetMs : std::min(layer->m_deferredBudgetMs, remainingMs);
+
+			auto layerStart = std::chrono::steady_clock::now();
+			layer->onDeferredUpdate(TimeSlice(sliceMs));
+			layer->m_timings.deferredMs = elapsedMs(layerStart);
+			layer->m_timings.skippedFrames = 0;
+		}
+	}
 }
\ No newline at end of file
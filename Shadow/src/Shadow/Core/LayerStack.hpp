@@ -17,10 +17,24 @@ namespace Shadow
 		void popLayer(Layer* layer);
 		void popOverlay(Layer* overlay);
 
+		// run the phase on every layer in stack order and record the per layer timings
+		void fixedUpdate(Timestep step, uint32_t stepCount);
+		void update(Timestep ts);
+		void render(float interpolationAlpha);
+
+		// time-slices onDeferredUpdate of the layers with a deferred budget into the remaining frame budget.
+		// layers are served by priority, a layer that has been skipped too often runs regardless so background work can't starve
+		void runDeferredUpdates(float remainingFrameMs);
+
 		inline std::vector<Layer*>::iterator begin() { return m_layers.begin(); }
 		inline std::vector<Layer*>::iterator end() { return m_layers.end(); }
+		inline std::vector<Layer*>::const_iterator begin() const { return m_layers.cbegin(); }
+		inline std::vector<Layer*>::const_iterator end() const { return m_layers.cend(); }
 	private:
+		static constexpr uint32_t s_maxSkippedFrames = 8;
+
 		std::vector<Layer*> m_layers;
+		std::vector<Layer*> m_deferredQueue; // scratch, reused every frame
 		uint32_t m_layerInsertIndex = 0;
 	};
-}
\ No newline at end of file
+}
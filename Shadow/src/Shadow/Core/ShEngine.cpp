@@ -3,71 +3,129 @@
 #include "Shadow/Core/Core.hpp"
 #include "Shadow/Renderer/Renderer.hpp"
 #include "Shadow/Renderer/Renderer2D.hpp"
+#include "Shadow/WindowLayer/InputRecorder.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
 		 
 #include <imgui.h>
-#include <GLFW/glfw3.h>
+#include <cmath>
+#include <chrono>
+#include <thread>
 
 // TODO: multithreading
 
 namespace Shadow
 {
 	static std::chrono::steady_clock::time_point s_start;
-	static std::future<void> s_asyncEventDispatcher;
 
-	ShEngine::ShEngine()
-		: m_frameRate(0.0f)
+	ShEngine::ShEngine(const EngineProperties& properties)
+		: m_properties(properties), m_frameRate(0.0f)
 	{
 		SH_ASSERT(!s_instance, "app already exists o^o");
 		s_instance = this;
+		s_start = std::chrono::steady_clock::now();
 
+		JobSystem::init();
 		EventDispatcher::init();
 		EventDispatcher& dispatcher = EventDispatcher::get();
 		dispatcher.addReciever(SH_CALLBACK(ShEngine::onWindowCloseEvent));
 		dispatcher.addReciever(SH_CALLBACK(ShEngine::onWinResizedEvent));
 
-		m_window = Window::create(1280, 720);
-		Renderer::init();
+		m_window = Window::create(properties.windowWidth, properties.windowHeight, "Shadow", properties.headless);
+		if (properties.inputThread)
+			m_window->enableInputThread();
+
+		if (!properties.replayInputPath.empty())
+		{
+			if (InputRecorder::startReplay(properties.replayInputPath) && !m_properties.frameCount)
+				m_properties.frameCount = InputRecorder::getFrameCount();
+		}
+		else if (!properties.recordInputPath.empty())
+			InputRecorder::startRecording(properties.recordInputPath);
+
+		Renderer::init(properties.renderThread);
 		Renderer2D::init();
 		m_imGuiLayer = ImGuiLayer::create();
 	}
 
 	ShEngine::~ShEngine()
 	{
+		InputRecorder::stop();
 		EventDispatcher::shutdown();
 		Renderer2D::shutdown();
 		Renderer::shutdown();
+		JobSystem::shutdown();
 	}
 
 	void ShEngine::run()
 	{
+		if (!m_window->hasInputThread())
+		{
+			runFrames();
+			return;
+		}
+
+		// GLFW only lets the main thread pump events, so with an input thread the frames are produced on a thread of their own
+		std::thread frameThread([this]()
+			{
+				Renderer::setFrameThread();
+				runFrames();
+				m_window->wakeEventLoop();
+			});
+
+		while (m_running.load(std::memory_order_acquire))
+			m_window->waitEvents();
+
+		frameThread.join();
+	}
+
+	void ShEngine::runFrames()
+	{
+		const std::chrono::steady_clock::time_point runStart = std::chrono::steady_clock::now();
+		m_lastFrameTime = std::chrono::duration<float>(runStart - s_start).count();
+
 		while (m_running)
 		{
 			SH_PROFILE_SCOPE("RunLoop");
 
-			float time = static_cast<float>(glfwGetTime()); // Platform::getTime()
+			countFrameHeapAllocations();
+			m_frameStart = std::chrono::steady_clock::now();
+			float time = std::chrono::duration<float>(std::chrono::steady_clock::now() - s_start).count(); // Platform::getTime()
 			Timestep timestep = time - m_lastFrameTime;
 			m_lastFrameTime = time;
 			m_frameRate = timestep.getMilliseconds();
 
-			// events are dispatched asynchronously (except WindowResized events, since they interact with rendering resources)
-			s_asyncEventDispatcher = std::async(std::launch::async, &ShEngine::dispatchEventsAsync, this);
-		    EventDispatcher::get().dispatch<WindowResizedEvent>();
+			// a replayed frame always simulates the same amount of time, whatever the frame actually took
+			if (InputRecorder::isReplaying())
+				timestep = m_properties.fixedTimestep;
+
+			if (!InputRecorder::beginFrame())
+			{
+				m_running = false;
+				break;
+			}
+
+			if (m_properties.renderThread)
+			{
+				produceFrame(timestep);
+				endFrame();
+				continue;
+			}
+
+			// events are dispatched asynchronously (except the synchronous ones of EventTraits, since they interact with rendering resources)
+			dispatchEventsAsync();
+		    EventDispatcher::get().dispatchSynchronous();
 
 			if (!m_minimized)
 			{
+				float interpolationAlpha = runFixedUpdates(timestep);
 				{
 					SH_PROFILE_SCOPE("layerStack - onUpdate");
-
-					for (Layer* layer : m_layerStack)
-						layer->onUpdate(timestep);
+					m_layerStack.update(timestep);
 				}
 
 				const Ref<RenderCmdBuffer>& renderCmdBuffer = Renderer::getCmdBuffer();
 				renderCmdBuffer->begin();
-				{
-					for (Layer* layer : m_layerStack)
-						layer->onRender();
-				}
+				m_layerStack.render(interpolationAlpha);
 				renderCmdBuffer->end(); 
 
 				m_imGuiLayer->begin();
@@ -83,9 +141,134 @@ namespace Shadow
 				renderCmdBuffer->submit();
 			}
 
-			s_asyncEventDispatcher.wait();
+			// the gpu is busy with the frame, the cpu time left until the frame budget goes to deferred layer work
+			runDeferredUpdates();
+
+			JobSystem::wait(m_eventJobs);
+			InputRecorder::endFrame();
 			m_window->present();
+			endFrame();
+		}
+
+		if (m_properties.renderThread)
+			Renderer::getRenderThread()->waitIdle();
+
+		if (m_properties.frameCount && m_producedFrames)
+		{
+			// printed in every configuration, this is what the headless benchmark runs are for
+			const float totalMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - runStart).count();
+			_log("[SHADOW]:", "%u frames in %.2f ms, %.3f ms/frame", TEXT_COLOR_BRIGHT_GREEN,
+				m_producedFrames, totalMs, totalMs / static_cast<float>(m_producedFrames));
+		}
+	}
+
+	void ShEngine::endFrame()
+	{
+		m_producedFrames++;
+
+		if (m_properties.frameCount && m_producedFrames >= m_properties.frameCount)
+			m_running = false;
+	}
+
+	void ShEngine::countFrameHeapAllocations()
+	{
+		const uint64_t allocationCount = FrameAllocator::getHeapAllocationCount();
+		m_frameHeapAllocations = allocationCount - m_heapAllocationCount;
+		m_heapAllocationCount = allocationCount;
+
+		if (m_producedFrames > s_allocationWarmupFrames && m_frameHeapAllocations && !m_frameAllocationsReported)
+		{
+			SH_WARN("frame %u still made %llu heap allocations after the warm-up :<", m_producedFrames,
+				static_cast<unsigned long long>(m_frameHeapAllocations));
+			m_frameAllocationsReported = true;
+		}
+	}
+
+	float ShEngine::runFixedUpdates(Timestep timestep)
+	{
+		SH_PROFILE_SCOPE("layerStack - onFixedUpdate");
+
+		const float step = m_properties.fixedTimestep;
+		m_fixedTimeAccumulator += timestep;
+
+		uint32_t stepCount = 0;
+		while (m_fixedTimeAccumulator >= step && stepCount < m_properties.maxFixedSteps)
+		{
+			m_fixedTimeAccumulator -= step;
+			stepCount++;
+		}
+		m_layerStack.fixedUpdate(step, stepCount);
+
+		// a long hitch would otherwise make every following frame run maxFixedSteps as well
+		if (m_fixedTimeAccumulator >= step)
+			m_fixedTimeAccumulator = std::fmod(m_fixedTimeAccumulator, step);
+
+		return m_fixedTimeAccumulator / step;
+	}
+
+	void ShEngine::runDeferredUpdates()
+	{
+		const float frameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_frameStart).count();
+		m_layerStack.runDeferredUpdates(m_properties.frameBudgetMs - frameMs);
+	}
+
+	void ShEngine::produceFrame(Timestep timestep)
+	{
+		SH_PROFILE_FUNCTION();
+		RenderThread* pRenderThread = Renderer::getRenderThread();
+
+		dispatchEventsAsync();
+
+		bool frameRecorded = false;
+		if (!m_minimized)
+		{
+			float interpolationAlpha = runFixedUpdates(timestep);
+			{
+				SH_PROFILE_SCOPE("layerStack - onUpdate");
+				m_layerStack.update(timestep);
+			}
+
+			// only fills the render command queue, nothing is recorded into Vulkan command buffers yet
+			m_layerStack.render(interpolationAlpha);
+
+			Renderer::end();
+			Renderer::submit([]()
+				{
+					Renderer::getCmdBuffer()->submit();
+					GraphicsContext::getCtx().presentImage();
+				});
+
+			frameRecorded = true;
+		}
+
+		runDeferredUpdates();
+
+		JobSystem::wait(m_eventJobs);
+		InputRecorder::endFrame();
+		m_window->pollEvents();
+
+		// the previous frame has been executing on the render thread until here
+		pRenderThread->waitIdle();
+		EventDispatcher::get().dispatchSynchronous();
+
+		if (frameRecorded)
+		{
+			// the render thread is idle, so the primary command buffer can be begun (fence wait + image acquisition) from here.
+			// ImGui is built while it is idle as well, that keeps onImGuiRender() on the main thread
+			Renderer::getCmdBuffer()->begin();
+
+			m_imGuiLayer->begin();
+			{
+				SH_PROFILE_SCOPE("layerStack - onImGuiRender");
+
+				for (Layer* layer : m_layerStack)
+					layer->onImGuiRender();
+			}
+			m_imGuiLayer->submit();
+			m_imGuiLayer->updateWindows();
 		}
+
+		pRenderThread->kick();
 	}
 
 	void ShEngine::pushLayer(Layer* layer)
@@ -115,14 +298,12 @@ namespace Shadow
 		SH_PROFILE_FUNCTION();
 		EventDispatcher* pDispatcher = &EventDispatcher::get();
 
-		m_asyncEventDispatchers[0] = std::async(std::launch::async, &EventDispatcher::dispatch<WindowClosedEvent>, pDispatcher);
-		m_asyncEventDispatchers[1] = std::async(std::launch::async, &EventDispatcher::dispatch<KeyEvent>, pDispatcher);
-		m_asyncEventDispatchers[2] = std::async(std::launch::async, &EventDispatcher::dispatch<MouseButtonEvent>, pDispatcher);
-		m_asyncEventDispatchers[3] = std::async(std::launch::async, &EventDispatcher::dispatch <MouseMovedEvent>, pDispatcher);
-		m_asyncEventDispatchers[4] = std::async(std::launch::async, &EventDispatcher::dispatch<MouseScrolledEvent>, pDispatcher);
-
-		for (auto& asyncDispatcher : m_asyncEventDispatchers)
-			asyncDispatcher.wait();
+		pDispatcher->forEachEventType([this, pDispatcher](auto tag)
+		{
+			using EventType = typename decltype(tag)::Type;
+			if constexpr (!EventTraits<EventType>::synchronous)
+				JobSystem::schedule([pDispatcher]() { pDispatcher->dispatch<EventType>(); }, &m_eventJobs);
+		});
 	}
 
 	void ShEngine::recordImguiCmdsAsync()
@@ -7,17 +7,46 @@
 #include "Shadow/Core/LayerStack.hpp"
 #include "Shadow/ImGui/ImGuiLayer.hpp"
 #include "Shadow/Core/Timestep.hpp"
-
-#include <future>
+#include "Shadow/Core/JobSystem.hpp"
 
 namespace Shadow
 {
 	class Renderpass;
 
+	struct EngineProperties
+	{
+		// layers record their onRender() into a command queue that a dedicated render thread translates and submits
+		// while the main thread is already producing the next frame
+		bool renderThread = false;
+
+		// simulation rate of Layer::onFixedUpdate. after a hitch at most maxFixedSteps are run in one frame, the rest of the backlog is dropped
+		float fixedTimestep = 1.0f / 60.0f;
+		uint32_t maxFixedSteps = 5;
+
+		// cpu time a frame aims for, Layer::onDeferredUpdate only gets what is left of it
+		float frameBudgetMs = 1000.0f / 60.0f;
+
+		uint32_t windowWidth = 1280, windowHeight = 720;
+
+		// no window and no surface: frames are rendered into an offscreen image ring (e.g. for benchmarking on lavapipe)
+		bool headless = false;
+		// the engine stops after this many frames and reports the average frame time, 0 runs until the window is closed
+		uint32_t frameCount = 0;
+
+		// the main thread only pumps GLFW events (timestamped and queued as they arrive) while the frame loop runs on another thread,
+		// so input latency doesn't depend on where in the frame the events would be polled. ignored when headless
+		bool inputThread = false;
+
+		// the input of every frame is written to recordInputPath, or read back from replayInputPath instead of the live input.
+		// a replay advances by fixedTimestep per frame and stops after the last recorded frame
+		std::string recordInputPath;
+		std::string replayInputPath;
+	};
+
 	class ShEngine
 	{
 	public:
-		ShEngine();
+		ShEngine(const EngineProperties& properties = EngineProperties());
 		virtual ~ShEngine();
 		ShEngine(const ShEngine& other) = delete;
 		ShEngine(ShEngine&& other) = delete;
@@ -29,6 +58,9 @@ namespace Shadow
 		inline const Window& getWindow() const { return *m_window; }
 		inline float getFrameRate() const { return m_frameRate; }
 		inline const Ref<ImGuiLayer>& getImGuiLayer() const { return m_imGuiLayer; }
+		inline const LayerStack& getLayerStack() const { return m_layerStack; }
+		// heap allocations of the previous frame on all threads, debug builds only (FrameAllocator::getHeapAllocationCount)
+		inline uint64_t getFrameHeapAllocations() const { return m_frameHeapAllocations; }
 
 		void pushLayer(Layer* layer);
 		void pushOverlay(Layer* layer);
@@ -36,23 +68,48 @@ namespace Shadow
 		bool onWindowCloseEvent(const WindowClosedEvent& event);
 		bool onWinResizedEvent(const WindowResizedEvent& event);
 
-		// all event types except WindowResizedEvent are dispatched asynchronously
+		void runFrames();
+
+		// all event types except WindowResizedEvent are dispatched on the job system, m_eventJobs has to be waited on
 		void dispatchEventsAsync();
 		void recordImguiCmdsAsync();
+
+		// runs the fixed steps that are due and returns the interpolation alpha for onRender
+		float runFixedUpdates(Timestep timestep);
+
+		// main thread half of a frame when the render thread is enabled
+		void produceFrame(Timestep timestep);
+
+		// time-slices the deferred layer work into what is left of EngineProperties::frameBudgetMs
+		void runDeferredUpdates();
+
+		// counts the frame against EngineProperties::frameCount
+		void endFrame();
+
+		// a frame should stop allocating once it has been warmed up, warns about the first one after s_allocationWarmupFrames that still does
+		void countFrameHeapAllocations();
 	private:
 		inline static ShEngine* s_instance{ nullptr };
+		static constexpr uint32_t s_allocationWarmupFrames = 120;
 
-		bool m_running = true, m_minimized = false;
+		EngineProperties m_properties;
+		std::atomic<bool> m_running{ true };
+		bool m_minimized = false;
 		float m_frameRate;
 		Scope<Window> m_window;
 		Ref<ImGuiLayer> m_imGuiLayer;
 		LayerStack m_layerStack;
 		float m_lastFrameTime = 0.0f;
+		float m_fixedTimeAccumulator = 0.0f;
+		uint32_t m_producedFrames = 0;
+		std::chrono::steady_clock::time_point m_frameStart;
+		uint64_t m_heapAllocationCount = 0;
+		uint64_t m_frameHeapAllocations = 0;
+		bool m_frameAllocationsReported = false;
 
-		std::array<std::future<void>, 5> m_asyncEventDispatchers{};
-		std::future<void> m_asyncImguiCmdRecord;
+		JobCounter m_eventJobs;
 	};
 
 	// To be defined in client
-	extern ShEngine* createApp();
+	extern ShEngine* createApp(int argc, char** argv);
 }
\ No newline at end of file
@@ -1,7 +1,6 @@
 #include"shpch.hpp"
 #include"EventDispatcher.hpp"
 
-#include<mutex>
 
 namespace Shadow
 {
@@ -9,12 +8,11 @@ namespace Shadow
 
 	EventDispatcher::EventDispatcher()
 	{
-		m_windowClosedEvents.reserve(5);
-		m_windowResizedEvents.reserve(5);
-		m_keyEvents.reserve(5);
-		m_mouseButtonEvents.reserve(5);
-		m_mousePosEvents.reserve(5);
-		m_mouseScrolledEvents.reserve(5);
+		m_registry.forEachEventType([this](auto tag)
+		{
+			using EventType = typename decltype(tag)::Type;
+			m_registry.getChannel<EventType>().events.reserve(5);
+		});
 	}
 
 	void EventDispatcher::init()
@@ -29,63 +27,13 @@ namespace Shadow
 
 	EventDispatcher& EventDispatcher::get() { return *s_instance; }
 
-	
-	void EventDispatcher::addEvent(WindowClosedEvent&& event)
+	void EventDispatcher::dispatchSynchronous()
 	{
-		m_windowClosedEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addEvent(KeyEvent&& event)
-	{
-		m_keyEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addEvent(MouseButtonEvent&& event)
-	{
-		m_mouseButtonEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addEvent(MouseMovedEvent&& event)
-	{
-		m_mousePosEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addEvent(MouseScrolledEvent&& event)
-	{
-		m_mouseScrolledEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addEvent(WindowResizedEvent&& event)
-	{
-		m_windowResizedEvents.emplace_back(std::move(event));
-	}
-
-	void EventDispatcher::addReciever(const std::function<bool(const WindowClosedEvent&)>& func)
-	{
-		m_windowClosedEventRecievers.emplace_back(func);
-	}
-
-	void EventDispatcher::addReciever(const std::function<bool(const KeyEvent&)>& func)
-	{
-		m_keyEventRecievers.emplace_back(func);
-	}
-	void EventDispatcher::addReciever(const std::function<bool(const MouseButtonEvent&)>& func)
-	{
-		m_mouseButtonEventRecievers.emplace_back(func);
-	}
-
-	void EventDispatcher::addReciever(const std::function<bool(const MouseMovedEvent&)>& func)
-	{
-		m_mousePosEventRecievers.emplace_back(func);
-	}
-
-	void EventDispatcher::addReciever(const std::function<bool(const WindowResizedEvent&)>& func)
-	{
-		m_winResizedEventRecievers.emplace_back(func);
-	}
-
-	void EventDispatcher::addReciever(const std::function<bool(const MouseScrolledEvent&)>& func)
-	{
-		m_mouseScrolledEventRecievers.emplace_back(func);
+		m_registry.forEachEventType([this](auto tag)
+		{
+			using EventType = typename decltype(tag)::Type;
+			if constexpr (EventTraits<EventType>::synchronous)
+				dispatch<EventType>();
+		});
 	}
 }
\ No newline at end of file
@@ -1,156 +1,197 @@
- #pragma once
+#pragma once
 
 #include"shpch.hpp"
+#include"Shadow/Core/Core.hpp"
 #include"Shadow/Events/EventTypes.hpp"
+#include"Shadow/Events/EventQueue.hpp"
 
-#include<future>
-#include<array>
+#include<tuple>
 
 namespace Shadow
 {
+	template<typename EventType>
+	using EventReciever = Delegate<bool(const EventType&)>;
+
+	// every receiver is stored as a batch receiver, per event receivers are wrapped into one (hence the room for a whole EventReciever)
+	template<typename EventType>
+	using EventBatchReciever = Delegate<bool(const EventSpan<EventType>&), 4 * sizeof(void*)>;
+
+	template<typename T>
+	struct IsEventSpan : std::false_type {};
+
+	template<typename EventType>
+	struct IsEventSpan<EventSpan<EventType>> : std::true_type { using Type = EventType; };
+
+	template<typename EventType, typename = void>
+	struct CanAccumulate : std::false_type {};
+
+	template<typename EventType>
+	struct CanAccumulate<EventType, std::void_t<decltype(EventTraits<EventType>::accumulate(std::declval<EventType&>(), std::declval<const EventType&>()))>>
+		: std::true_type {};
+
+	template<typename EventType>
+	struct EventChannel
+	{
+		EventQueue<EventType> queue;
+		std::vector<EventType> events; // drained events of the running dispatch, only touched by the consumer
+		std::vector<EventBatchReciever<EventType>> recievers;
+		EventBatchReciever<EventType> recorder; // sees the raw events before they are coalesced
+		CoalescePolicy policy = EventTraits<EventType>::coalescePolicy;
+	};
+
+	// one channel per event type of the list, resolved at compile time
+	template<typename List>
+	class EventRegistry;
+
+	template<typename ...EventTypes>
+	class EventRegistry<TypeList<EventTypes...>>
+	{
+	public:
+		template<typename EventType>
+		inline EventChannel<EventType>& getChannel() { return std::get<EventChannel<EventType>>(m_channels); }
+
+		// calls func(TypeTag<EventType>{}) for every registered event type
+		template<typename F>
+		inline void forEachEventType(F&& func) { (func(TypeTag<EventTypes>{}), ...); }
+	private:
+		std::tuple<EventChannel<EventTypes>...> m_channels;
+	};
+
 	class EventDispatcher
 	{
 	public:
 		static void init();
 		static void shutdown();
 		static EventDispatcher& get();
-		
-		void addEvent(WindowClosedEvent&& event);
-		void addEvent(WindowResizedEvent&& event);
-		void addEvent(KeyEvent&& event);
-		void addEvent(MouseButtonEvent&& event);
-		void addEvent(MouseMovedEvent&& event);
-		void addEvent(MouseScrolledEvent&& event);
-
-		void addReciever(const std::function<bool(const WindowClosedEvent&)>& func);
-		void addReciever(const std::function<bool(const WindowResizedEvent&)>& func);
-		void addReciever(const std::function<bool(const KeyEvent&)>& func);
-		void addReciever(const std::function<bool(const MouseButtonEvent&)>& func);
-		void addReciever(const std::function<bool(const MouseMovedEvent&)>& func);
-		void addReciever(const std::function<bool(const MouseScrolledEvent&)>& func);
-
-		template<class EventType>
-		void dispatch() {}
-
-		template<>
-		void dispatch<WindowClosedEvent>()
-		{
-			if (!m_windowClosedEvents.size())
-				return;
 
-			for (auto& reciever : m_windowClosedEventRecievers)
+		// thread safe and lock-free, the event is timestamped here
+		template<typename EventType>
+		void addEvent(EventType event)
+		{
+			if constexpr (EventTraits<EventType>::recorded)
 			{
-				for (auto& event : m_windowClosedEvents)
-					m_handled = reciever(event);
-
-				if (m_handled)
-					break;
+				// the replayed input replaces the live one
+				if (m_replaying.load(std::memory_order_relaxed))
+					return;
 			}
-			m_windowClosedEvents.clear();
+
+			event.timestamp = std::chrono::steady_clock::now();
+			if (!m_registry.getChannel<EventType>().queue.push(std::move(event)))
+				SH_WARN("event queue is full, the event has been dropped :<");
 		}
 
-		template<>
-		void dispatch<KeyEvent>()
+		// pushes an event that keeps its timestamp and bypasses the replay filter (InputRecorder)
+		template<typename EventType>
+		void injectEvent(EventType event)
 		{
-			if (!m_keyEvents.size())
-				return;
-
-			for (auto& reciever : m_keyEventRecievers)
-			{
-				for (auto& event : m_keyEvents)
-					m_handled = reciever(event);
-
-				if (m_handled)
-					break;
-			}
-			m_keyEvents.clear();
+			if (!m_registry.getChannel<EventType>().queue.push(std::move(event)))
+				SH_WARN("event queue is full, the injected event has been dropped :<");
 		}
 
-		template<>
-		void dispatch<MouseButtonEvent>()
+		// while replaying, addEvent drops the live events of the recorded types
+		inline void setReplaying(bool replaying) { m_replaying.store(replaying, std::memory_order_relaxed); }
+
+		// takes a delegate (SH_CALLBACK) or a small lambda, the event type is deduced from its parameter.
+		// receivers taking a const EventSpan<EventType>& get all events of a dispatch in one call
+		template<typename F>
+		void addReciever(F&& func)
 		{
-			if (!m_mouseButtonEvents.size())
-				return;
+			using ArgType = std::decay_t<typename CallableTraits<F>::template Arg<0>>;
 
-			for (auto& reciever : m_mouseButtonEventRecievers)
+			if constexpr (IsEventSpan<ArgType>::value)
 			{
-				for (auto& event : m_mouseButtonEvents)
-					m_handled = reciever(event);
-
-				if (m_handled)
-					break;
+				using EventType = typename IsEventSpan<ArgType>::Type;
+				m_registry.getChannel<EventType>().recievers.emplace_back(std::forward<F>(func));
+			}
+			else
+			{
+				EventReciever<ArgType> reciever(std::forward<F>(func));
+				m_registry.getChannel<ArgType>().recievers.emplace_back([reciever](const EventSpan<ArgType>& events)
+				{
+					// every event still reaches the reciever, any of them being handled stops the propagation
+					bool handled = false;
+					for (const ArgType& event : events)
+						handled |= reciever(event);
+
+					return handled;
+				});
 			}
-			m_mouseButtonEvents.clear();
 		}
 
-		template<>
-		void dispatch<MouseMovedEvent>()
+		// overrides EventTraits<EventType>::coalescePolicy, like addReciever it isn't synchronized with the dispatch
+		template<typename EventType>
+		void setCoalescePolicy(CoalescePolicy policy)
 		{
-			if (!m_mousePosEvents.size())
-				return;
-
-			for (auto& reciever : m_mousePosEventRecievers)
-			{
-				for (auto& event : m_mousePosEvents)
-					m_handled = reciever(event);
+			SH_ASSERT((policy != CoalescePolicy::AccumulateDeltas || CanAccumulate<EventType>::value), "event type has no EventTraits::accumulate o^o");
+			m_registry.getChannel<EventType>().policy = policy;
+		}
 
-				if (m_handled)
-					break;
-			}
-			m_mousePosEvents.clear();
+		// the recorder is called from the dispatch job of its event type, pass an empty delegate to remove it
+		template<typename EventType>
+		void setRecorder(const EventBatchReciever<EventType>& recorder)
+		{
+			m_registry.getChannel<EventType>().recorder = recorder;
 		}
 
-		template<>
-		void dispatch<WindowResizedEvent>()
+		// every event type is drained by a single dispatch job at a time, that makes the queues single consumer
+		template<typename EventType>
+		void dispatch()
 		{
-			if (!m_windowResizedEvents.size())
+			EventChannel<EventType>& channel = m_registry.getChannel<EventType>();
+			if (!channel.queue.drain(channel.events))
 				return;
 
-			for (auto& reciever : m_winResizedEventRecievers)
-			{
-				for (auto& event : m_windowResizedEvents)
-					m_handled = reciever(event);
+			if (channel.recorder)
+				channel.recorder(EventSpan<EventType>{ channel.events.data(), channel.events.size() });
 
-				if (m_handled)
+			coalesce(channel);
+
+			const EventSpan<EventType> events{ channel.events.data(), channel.events.size() };
+			for (const EventBatchReciever<EventType>& reciever : channel.recievers)
+			{
+				if (reciever(events))
 					break;
 			}
-			m_windowResizedEvents.clear();
+			channel.events.clear();
 		}
 
-		template<>
-		void dispatch<MouseScrolledEvent>()
+		// frame thread only, dispatches the event types marked as synchronous in EventTraits
+		void dispatchSynchronous();
+
+		template<typename F>
+		inline void forEachEventType(F&& func) { m_registry.forEachEventType(std::forward<F>(func)); }
+	private:
+		EventDispatcher();
+
+		template<typename EventType>
+		void coalesce(EventChannel<EventType>& channel)
 		{
-			if (!m_mouseScrolledEvents.size())
+			std::vector<EventType>& events = channel.events;
+			if (events.size() < 2)
 				return;
 
-			for (auto& reciever : m_mouseScrolledEventRecievers)
+			switch (channel.policy)
 			{
-				for (auto& event : m_mouseScrolledEvents)
-					m_handled = reciever(event);
-
-				if (m_handled)
-					break;
+			case CoalescePolicy::KeepLatest:
+				events.erase(events.begin(), events.end() - 1);
+				break;
+			case CoalescePolicy::AccumulateDeltas:
+				if constexpr (CanAccumulate<EventType>::value)
+				{
+					EventType& total = events.front();
+					for (size_t i = 1; i < events.size(); i++)
+						EventTraits<EventType>::accumulate(total, events[i]);
+
+					total.timestamp = events.back().timestamp;
+					events.erase(events.begin() + 1, events.end());
+				}
+				break;
+			case CoalescePolicy::KeepAll:
+				break;
 			}
-			m_mouseScrolledEvents.clear();
 		}
-
-	private:
-		EventDispatcher();
 	private:
-		bool m_handled = false;
-
-		std::vector<WindowClosedEvent> m_windowClosedEvents;
-		std::vector<WindowResizedEvent> m_windowResizedEvents; 
-		std::vector<KeyEvent> m_keyEvents;
-		std::vector<MouseButtonEvent> m_mouseButtonEvents;
-		std::vector<MouseMovedEvent> m_mousePosEvents;
-		std::vector<MouseScrolledEvent> m_mouseScrolledEvents;
-
-		std::vector<std::function<bool(const WindowClosedEvent&)>> m_windowClosedEventRecievers;
-		std::vector<std::function<bool(const WindowResizedEvent&)>> m_winResizedEventRecievers;
-		std::vector<std::function<bool(const KeyEvent&)>> m_keyEventRecievers;
-		std::vector<std::function<bool(const MouseButtonEvent&)>> m_mouseButtonEventRecievers;
-		std::vector<std::function<bool(const MouseMovedEvent&)>> m_mousePosEventRecievers;
-		std::vector<std::function<bool(const MouseScrolledEvent&)>> m_mouseScrolledEventRecievers;
+		EventRegistry<EngineEvents> m_registry;
+		std::atomic<bool> m_replaying{ false };
 	};
 }
\ No newline at end of file
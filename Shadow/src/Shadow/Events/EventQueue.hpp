@@ -0,0 +1,106 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace Shadow
+{
+	// bounded lock-free multi-producer single-consumer queue. every slot carries a sequence number that tells
+	// producers whether the slot is free and the consumer whether it has been published (Vyukov's bounded queue)
+	template<typename T, uint32_t Capacity = 1024>
+	class EventQueue
+	{
+		static_assert((Capacity & (Capacity - 1)) == 0, "event queue capacity must be a power of two o^o");
+	public:
+		EventQueue()
+		{
+			for (uint32_t i = 0; i < Capacity; i++)
+				m_slots[i].sequence.store(i, std::memory_order_relaxed);
+		}
+
+		~EventQueue()
+		{
+			T* pEvent = nullptr;
+			while ((pEvent = front()))
+				pop(pEvent);
+		}
+
+		EventQueue(const EventQueue& other) = delete;
+		EventQueue& operator=(const EventQueue& other) = delete;
+
+		// any thread. returns false (and drops the event) when the consumer has fallen Capacity events behind
+		bool push(T&& event)
+		{
+			Slot* pSlot = nullptr;
+			uint32_t position = m_head.load(std::memory_order_relaxed);
+
+			while (true)
+			{
+				pSlot = &m_slots[position & (Capacity - 1)];
+				const uint32_t sequence = pSlot->sequence.load(std::memory_order_acquire);
+				const int32_t difference = static_cast<int32_t>(sequence - position);
+
+				if (difference == 0)
+				{
+					if (m_head.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+						break;
+				}
+				else if (difference < 0)
+					return false;
+				else
+					position = m_head.load(std::memory_order_relaxed);
+			}
+
+			new (pSlot->storage) T(std::move(event));
+			pSlot->sequence.store(position + 1, std::memory_order_release);
+			return true;
+		}
+
+		// consumer thread only. moves every published event to the back of outEvents and returns how many there were
+		uint32_t drain(std::vector<T>& outEvents)
+		{
+			uint32_t count = 0;
+
+			T* pEvent = nullptr;
+			while ((pEvent = front()))
+			{
+				outEvents.emplace_back(std::move(*pEvent));
+				pop(pEvent);
+				count++;
+			}
+
+			return count;
+		}
+	private:
+		T* front()
+		{
+			Slot& slot = m_slots[m_tail & (Capacity - 1)];
+			const uint32_t sequence = slot.sequence.load(std::memory_order_acquire);
+
+			if (static_cast<int32_t>(sequence - (m_tail + 1)) < 0)
+				return nullptr;
+
+			return std::launder(reinterpret_cast<T*>(slot.storage));
+		}
+
+		void pop(T* pEvent)
+		{
+			pEvent->~T();
+			m_slots[m_tail & (Capacity - 1)].sequence.store(m_tail + Capacity, std::memory_order_release);
+			m_tail++;
+		}
+	private:
+		struct Slot
+		{
+			std::atomic<uint32_t> sequence;
+			alignas(T) unsigned char storage[sizeof(T)];
+		};
+
+		Slot m_slots[Capacity];
+		alignas(64) std::atomic<uint32_t> m_head{ 0 }; // shared by the producers
+		alignas(64) uint32_t m_tail = 0;                // owned by the consumer
+	};
+}
@@ -2,13 +2,20 @@
 
 #include "Shadow/Core/Log.hpp"
 
+#include <chrono>
+
 namespace Shadow
 {
+	// set by EventDispatcher::addEvent when the event is ingested, not when it is dispatched
+	using EventTimestamp = std::chrono::steady_clock::time_point;
+
 	struct WindowClosedEvent
 	{
 		WindowClosedEvent(WindowClosedEvent&& other) noexcept = default;
 
 		WindowClosedEvent& operator=(WindowClosedEvent&& other) noexcept = default;
+
+		EventTimestamp timestamp;
 	};
 
 	struct WindowResizedEvent
@@ -22,17 +29,20 @@ namespace Shadow
 		{
 			width = std::move(other.width);
 			height = std::move(other.height);
+			timestamp = other.timestamp;
 		}
 
 		WindowResizedEvent& operator=(WindowResizedEvent&& other) noexcept
 		{
 			width = std::move(other.width);
 			height = std::move(other.height);
+			timestamp = other.timestamp;
 
 			return *this;
 		}
 
 		int width, height;
+		EventTimestamp timestamp;
 	};
 
 	struct KeyEvent
@@ -46,18 +56,21 @@ namespace Shadow
 		{
 			keycode = std::move(other.keycode);
 			pressed = std::move(other.pressed);
+			timestamp = other.timestamp;
 		}
 
 		KeyEvent& operator=(KeyEvent&& other) noexcept
 		{
 			keycode = std::move(other.keycode);
 			pressed = std::move(other.pressed);
+			timestamp = other.timestamp;
 
 			return *this;
 		}
 
 		int keycode;
 		bool pressed;
+		EventTimestamp timestamp;
 	};
 
 	struct MouseButtonEvent
@@ -71,18 +84,21 @@ namespace Shadow
 		{
 			button = std::move(other.button);
 			pressed = std::move(other.pressed);
+			timestamp = other.timestamp;
 		}
 
 		MouseButtonEvent& operator=(MouseButtonEvent&& other) noexcept
 		{
 			button = std::move(other.button);
 			pressed = std::move(other.pressed);
+			timestamp = other.timestamp;
 
 			return *this;
 		}
 
 		int button;
 		bool pressed;
+		EventTimestamp timestamp;
 	};
 
 	struct MouseMovedEvent
@@ -96,17 +112,20 @@ namespace Shadow
 		{
 			x = std::move(other.x);
 			y = std::move(other.y);
+			timestamp = other.timestamp;
 		}
 
 		MouseMovedEvent& operator=(MouseMovedEvent&& other) noexcept
 		{
 			x = std::move(other.x);
 			y = std::move(other.y);
+			timestamp = other.timestamp;
 
 			return *this;
 		}
 
 		float x, y;
+		EventTimestamp timestamp;
 	};
 
 	struct MouseScrolledEvent
@@ -120,16 +139,121 @@ namespace Shadow
 		{
 			xOffset = std::move(other.xOffset);
 			yOffset = std::move(other.yOffset);
+			timestamp = other.timestamp;
 		}
 
 		MouseScrolledEvent& operator=(MouseScrolledEvent&& other) noexcept
 		{
 			xOffset = std::move(other.xOffset);
 			yOffset = std::move(other.yOffset);
+			timestamp = other.timestamp;
 
 			return *this;
 		}
 
 		float xOffset, yOffset;
+		EventTimestamp timestamp;
+	};
+
+	template<typename ...Types>
+	struct TypeList
+	{
+		static constexpr uint32_t size = sizeof...(Types);
+	};
+
+	template<typename T>
+	struct TypeTag { using Type = T; };
+
+	// position of T in a TypeList
+	template<typename T, typename List>
+	struct TypeIndex;
+
+	template<typename T, typename ...Types>
+	struct TypeIndex<T, TypeList<T, Types...>> { static constexpr uint32_t value = 0; };
+
+	template<typename T, typename U, typename ...Types>
+	struct TypeIndex<T, TypeList<U, Types...>> { static constexpr uint32_t value = 1 + TypeIndex<T, TypeList<Types...>>::value; };
+
+	// every event type the EventDispatcher knows about. a new event only has to be added here
+	using EngineEvents = TypeList<WindowClosedEvent, WindowResizedEvent, KeyEvent, MouseButtonEvent, MouseMovedEvent, MouseScrolledEvent>;
+
+	// contiguous view of the coalesced events of one dispatch, handed to batch receivers
+	template<typename EventType>
+	struct EventSpan
+	{
+		const EventType* pData = nullptr;
+		size_t count = 0;
+
+		inline const EventType* begin() const { return pData; }
+		inline const EventType* end() const { return pData + count; }
+		inline const EventType& back() const { return pData[count - 1]; }
+		inline size_t size() const { return count; }
+	};
+
+	// how the events of one type that arrived since the last dispatch are merged before the receivers see them
+	enum class CoalescePolicy : uint8_t
+	{
+		KeepAll,         // every event in arrival order
+		KeepLatest,      // only the newest one, for absolute state like the cursor position or the window size
+		AccumulateDeltas // a single event summing all of them up through EventTraits<EventType>::accumulate
+	};
+
+	// events are dispatched by jobs by default, synchronous ones are dispatched on the frame thread by dispatchSynchronous().
+	// recorded events are the user input captured and replayed by the InputRecorder
+	struct DefaultEventTraits
+	{
+		static constexpr bool synchronous = false;
+		static constexpr bool recorded = false;
+		static constexpr CoalescePolicy coalescePolicy = CoalescePolicy::KeepAll;
+	};
+
+	template<typename EventType>
+	struct EventTraits : DefaultEventTraits {};
+
+	template<>
+	struct EventTraits<WindowClosedEvent> : DefaultEventTraits
+	{
+		static constexpr CoalescePolicy coalescePolicy = CoalescePolicy::KeepLatest;
+	};
+
+	// resizing recreates the swapchain, that can't race with the frame. only the final size matters
+	template<>
+	struct EventTraits<WindowResizedEvent> : DefaultEventTraits
+	{
+		static constexpr bool synchronous = true;
+		static constexpr CoalescePolicy coalescePolicy = CoalescePolicy::KeepLatest;
+	};
+
+	template<>
+	struct EventTraits<KeyEvent> : DefaultEventTraits
+	{
+		static constexpr bool recorded = true;
+	};
+
+	template<>
+	struct EventTraits<MouseButtonEvent> : DefaultEventTraits
+	{
+		static constexpr bool recorded = true;
+	};
+
+	// high polling rate mice report dozens of positions per frame
+	template<>
+	struct EventTraits<MouseMovedEvent> : DefaultEventTraits
+	{
+		static constexpr bool recorded = true;
+		static constexpr CoalescePolicy coalescePolicy = CoalescePolicy::KeepLatest;
+	};
+
+	template<>
+	struct EventTraits<MouseScrolledEvent> : DefaultEventTraits
+	{
+		static constexpr bool recorded = true;
+		static constexpr CoalescePolicy coalescePolicy = CoalescePolicy::AccumulateDeltas;
+
+		static void accumulate(MouseScrolledEvent& total, const MouseScrolledEvent& event)
+		{
+			total.xOffset += event.xOffset;
+			total.yOffset += event.yOffset;
+		}
 	};
 }
\ No newline at end of file
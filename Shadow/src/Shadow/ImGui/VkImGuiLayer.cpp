@@ -6,11 +6,29 @@
 #include "Shadow/Renderer/Renderer.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/WindowLayer/Input.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
 
 #include <imgui/backends/imgui_impl_glfw.h>
+#include <GLFW/glfw3.h>
+
+// the GLFW backend's key mapping, a plain switch over the keycodes. exported but not declared in its header
+ImGuiKey ImGui_ImplGlfw_KeyToImGuiKey(int keycode, int scancode);
 
 namespace Shadow
 {
+	// ImGui allocates with malloc, this makes its allocations show up in the per frame heap allocation count
+	static void* imGuiAlloc(size_t size, void* pUserData)
+	{
+		FrameAllocator::countHeapAllocation();
+		return malloc(size);
+	}
+
+	static void imGuiFree(void* ptr, void* pUserData)
+	{
+		free(ptr);
+	}
+
 	VulkanImGuiLayer::VulkanImGuiLayer()
 	{
 		SH_PROFILE_FUNCTION();
@@ -18,19 +36,34 @@ namespace Shadow
 		EventDispatcher::get().addReciever(SH_CALLBACK(VulkanImGuiLayer::onWindowResized));
 
 		IMGUI_CHECKVERSION();
+		ImGui::SetAllocatorFunctions(imGuiAlloc, imGuiFree);
 		ImGui::CreateContext();
 
 		ImGuiIO& io = ImGui::GetIO(); (void)io;
 		io.ConfigFlags |= ImGuiConfigFlags_NavEnableKeyboard;
 		//io.ConfigFlags |= ImGuiConfigFlags_NavEnableGamepad; //Enable Gamepad Controls
 		io.ConfigFlags |= ImGuiConfigFlags_DockingEnable;
-		io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+
+		const Window& engineWindow = ShEngine::get().getWindow();
+		if (!engineWindow.isHeadless() && !engineWindow.hasInputThread())
+			io.ConfigFlags |= ImGuiConfigFlags_ViewportsEnable;
+
+		// platform windows and cursor shapes have to be created on the input thread, ImGui doesn't support that
+		if (engineWindow.hasInputThread())
+			io.ConfigFlags |= ImGuiConfigFlags_NoMouseCursorChange;
 
 		setupImGuiStyle();
 
-		GLFWwindow* window = static_cast<GLFWwindow*>(ShEngine::get().getWindow().getWindowHandle());
+		GLFWwindow* window = static_cast<GLFWwindow*>(engineWindow.getWindowHandle());
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		ImGui_ImplGlfw_InitForVulkan(window, true);
+
+		// the GLFW backend queries GLFW in its callbacks and NewFrame, which may only run on the input thread then.
+		// without a platform backend begin() feeds the display from the cached window state and the input comes
+		// through the engine events
+		if (engineWindow.hasInputThread())
+			forwardEngineEvents();
+		else if (window)
+			ImGui_ImplGlfw_InitForVulkan(window, true);
 
 		m_imguiFramebuffers.resize(device->getSwapchain()->getImageCount());
 
@@ -64,7 +97,9 @@ namespace Shadow
 		vkDeviceWaitIdle(vkDevice);
 
 		ImGui_ImplVulkan_Shutdown();
-		ImGui_ImplGlfw_Shutdown();
+		const Window& window = ShEngine::get().getWindow();
+		if (!window.isHeadless() && !window.hasInputThread())
+			ImGui_ImplGlfw_Shutdown();
 		ImGui::DestroyContext();
 
 		vkDestroyDescriptorPool(vkDevice, m_imGuiDescriptorPool, nullptr);
@@ -86,8 +121,32 @@ namespace Shadow
 	{
 		SH_PROFILE_FUNCTION();
 
+		// the forwarded events may be added by the event dispatch jobs meanwhile
+		std::scoped_lock<std::mutex> lock(m_inputMutex);
+
 		ImGui_ImplVulkan_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
+
+		const Window& window = ShEngine::get().getWindow();
+		if (window.isHeadless() || window.hasInputThread())
+		{
+			const WindowState state = window.getState();
+
+			ImGuiIO& io = ImGui::GetIO();
+			io.DisplaySize = ImVec2(static_cast<float>(state.width), static_cast<float>(state.height));
+			if (state.width > 0 && state.height > 0)
+				io.DisplayFramebufferScale = ImVec2(static_cast<float>(state.framebufferWidth) / state.width,
+					static_cast<float>(state.framebufferHeight) / state.height);
+			io.DeltaTime = std::max(ShEngine::get().getFrameRate() * 0.001f, 0.0001f);
+
+			if (state.focused != m_focused)
+			{
+				io.AddFocusEvent(state.focused);
+				m_focused = state.focused;
+			}
+		}
+		else
+			ImGui_ImplGlfw_NewFrame();
+
 		ImGui::NewFrame();
 	}
 
@@ -100,7 +159,7 @@ namespace Shadow
 		}
 
 		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		Ref<VulkanCmdBuffer> renderCmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
+		VulkanCmdBuffer* renderCmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
 		VkFence fence = renderCmdBuffer->getInFlightFence();
 		uint32_t currentFrame = renderCmdBuffer->currentFrame();
 
@@ -149,6 +208,55 @@ namespace Shadow
 		return false;
 	}
 
+	void VulkanImGuiLayer::forwardEngineEvents()
+	{
+		EventDispatcher& dispatcher = EventDispatcher::get();
+
+		dispatcher.addReciever([this](const KeyEvent& e)
+			{
+				std::scoped_lock<std::mutex> lock(m_inputMutex);
+				ImGuiIO& io = ImGui::GetIO();
+
+				// the key state is cached before the event is added, so it already includes this key
+				io.AddKeyEvent(ImGuiMod_Ctrl, Input::isKeyPressed(GLFW_KEY_LEFT_CONTROL) || Input::isKeyPressed(GLFW_KEY_RIGHT_CONTROL));
+				io.AddKeyEvent(ImGuiMod_Shift, Input::isKeyPressed(GLFW_KEY_LEFT_SHIFT) || Input::isKeyPressed(GLFW_KEY_RIGHT_SHIFT));
+				io.AddKeyEvent(ImGuiMod_Alt, Input::isKeyPressed(GLFW_KEY_LEFT_ALT) || Input::isKeyPressed(GLFW_KEY_RIGHT_ALT));
+				io.AddKeyEvent(ImGuiMod_Super, Input::isKeyPressed(GLFW_KEY_LEFT_SUPER) || Input::isKeyPressed(GLFW_KEY_RIGHT_SUPER));
+
+				// unlike the backend's callback the keycode isn't translated to the keyboard layout, that needs glfwGetKeyName
+				io.AddKeyEvent(ImGui_ImplGlfw_KeyToImGuiKey(e.keycode, 0), e.pressed);
+				return false;
+			});
+
+		dispatcher.addReciever([this](const MouseButtonEvent& e)
+			{
+				std::scoped_lock<std::mutex> lock(m_inputMutex);
+				ImGuiIO& io = ImGui::GetIO();
+
+				// the events are dispatched by different jobs, the cursor might not have been moved to the click yet
+				const WindowState state = ShEngine::get().getWindow().getState();
+				io.AddMousePosEvent(state.cursorX, state.cursorY);
+
+				if (e.button >= 0 && e.button < ImGuiMouseButton_COUNT)
+					io.AddMouseButtonEvent(e.button, e.pressed);
+				return false;
+			});
+
+		dispatcher.addReciever([this](const MouseMovedEvent& e)
+			{
+				std::scoped_lock<std::mutex> lock(m_inputMutex);
+				ImGui::GetIO().AddMousePosEvent(e.x, e.y);
+				return false;
+			});
+
+		dispatcher.addReciever([this](const MouseScrolledEvent& e)
+			{
+				std::scoped_lock<std::mutex> lock(m_inputMutex);
+				ImGui::GetIO().AddMouseWheelEvent(e.xOffset, e.yOffset);
+				return false;
+			});
+	}
+
 	void VulkanImGuiLayer::createImGuiRenderpass()
 	{
 		VkAttachmentDescription colorAttachment{};
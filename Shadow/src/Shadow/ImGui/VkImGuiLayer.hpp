@@ -5,6 +5,7 @@
 #include "Shadow/Vulkan/VulkanPipeline.hpp"
 
 #include <imgui/backends/imgui_impl_vulkan.h>
+#include <mutex>
 
 namespace Shadow
 {
@@ -22,6 +23,7 @@ namespace Shadow
 		inline VkCommandBuffer getCmdBuffer(uint32_t currentFrame) const { return m_imguiCmdBuffers[currentFrame]; }
 	private:
 		bool onWindowResized(const WindowResizedEvent& e);
+		void forwardEngineEvents();
 
 		void createImGuiDescriptorPool();
 		void createImGuiCmdBuffers();
@@ -38,5 +40,8 @@ namespace Shadow
 
 		VkRenderPass m_imguiRenderpass;
 		std::vector<VkFramebuffer> m_imguiFramebuffers;
+
+		std::mutex m_inputMutex;
+		bool m_focused = true; // last focus reported to ImGui without a platform backend
 	};
 }
\ No newline at end of file
@@ -130,6 +130,17 @@ namespace Shadow
         return nullptr;
     }
 
+    Ref<VertexArena> VertexArena::create(uint32_t stride, uint32_t blockVertexCount)
+    {
+        switch (Renderer::getRendererType())
+        {
+            case RendererType::None: return nullptr;
+            case RendererType::Vulkan: return createRef<VulkanVertexArena>(stride, blockVertexCount);
+        }
+        SH_ASSERT(false, "failed to create vertex arena :(");
+        return nullptr;
+    }
+
     IndexBuffer::IndexBuffer(uint32_t indexCount)
         : m_indexCount(indexCount)
     {
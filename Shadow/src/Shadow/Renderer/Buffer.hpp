@@ -18,6 +18,59 @@ namespace Shadow
 	};
 	SH_FLAG(BufferUsage)
 
+	// static resources return from creation right away while their data is copied on the gpu. a frame that uses the resource
+	// waits (on the gpu) for its ticket, Renderer::waitForUpload() waits on the cpu. 0 -> nothing to wait for
+	using UploadTicket = uint64_t;
+
+	// static: written once at creation, the data lives on the gpu only (staging and cpu copies are dropped after the upload).
+	// streaming: rewritten every frame it is drawn, the data goes straight into the per-frame ring buffer and nothing else is kept
+	enum class BufferPolicy
+	{
+		Static,
+		Streaming
+	};
+
+	// slice of the per-frame ring buffer (Renderer::allocateTransient). pData is persistently mapped, the data is written
+	// straight into it. nothing is freed, the memory is recycled once the gpu has executed the frame
+	struct TransientBuffer
+	{
+		void* pData = nullptr;
+		uint32_t offset = 0;
+		uint32_t size = 0;
+
+		inline explicit operator bool() const { return pData != nullptr; }
+	};
+
+	// slice of a VertexArena. slices that share a block lie back to back in the order they were allocated
+	struct ArenaSlice
+	{
+		void* pData = nullptr;
+		uint32_t block = 0;
+		uint32_t firstVertex = 0; // inside the block, the vertex offset of a draw that starts at the slice
+		uint32_t vertexCount = 0;
+		uint64_t frame = 0;
+	};
+
+	// per-frame vertex memory for geometry that is rebuilt every frame and outgrows the frame ring buffer. the memory is persistently
+	// mapped and recycled like the ring (once the gpu has executed the frame). when a frame runs out another block is added, the next
+	// frame that reuses the memory gets one block of the combined size, so a scene ends up in one block after its first frames
+	class VertexArena
+	{
+	public:
+		VertexArena(uint32_t stride)
+			: m_stride(stride) {}
+		virtual ~VertexArena() = default;
+
+		// frame thread (the one that records the draws)
+		virtual ArenaSlice allocate(uint32_t vertexCount) = 0;
+
+		inline uint32_t getStride() const { return m_stride; }
+
+		static Ref<VertexArena> create(uint32_t stride, uint32_t blockVertexCount);
+	private:
+		uint32_t m_stride;
+	};
+
 	class RenderBuffer
 	{
 	public:
@@ -28,6 +81,8 @@ namespace Shadow
 		inline uint32_t getSize() const { return m_size; }
 		inline uint32_t getElementCount() const { return m_elementCount; }
 
+		virtual UploadTicket getUploadTicket() const = 0;
+
 		static Ref<RenderBuffer> create(const void* data, uint32_t size, uint32_t stride, BufferUsage bufferUsage);
 		static Ref<RenderBuffer> createVertexBuffer(const void* data, uint32_t size, const VertexInput& layout);
 		static Ref<RenderBuffer> createVertexBuffer(const void* data, uint32_t size, uint32_t stride);
@@ -59,11 +114,13 @@ namespace Shadow
 		virtual void setData(const void* data, uint32_t size, uint32_t offset = 0) = 0;
 
 		virtual uint32_t getVertexCount() const = 0;
+		virtual BufferPolicy getPolicy() const = 0;
+		virtual UploadTicket getUploadTicket() const = 0;
 
 		static Ref<VertexBuffer> create(void* vertices, uint32_t size, const VertexInput& layout); // static buffer
 		static Ref<VertexBuffer> create(void* vertices, uint32_t size, uint32_t stride); // static buffer
-		static Ref<VertexBuffer> create(uint32_t size, const VertexInput& layout); // dynamic buffer
-		static Ref<VertexBuffer> create(uint32_t size, uint32_t stride); // dynamic buffer
+		static Ref<VertexBuffer> create(uint32_t size, const VertexInput& layout); // streaming buffer
+		static Ref<VertexBuffer> create(uint32_t size, uint32_t stride); // streaming buffer
 	};
 
 	// currently Shadow supports 32-bit index buffers
@@ -74,6 +131,7 @@ namespace Shadow
 		virtual ~IndexBuffer() = default;
 
 		inline uint32_t getCount() const { return m_indexCount; }
+		virtual UploadTicket getUploadTicket() const = 0;
 
 		static Ref<IndexBuffer> create(uint32_t* indices, uint32_t count);
 	private:
@@ -104,6 +162,7 @@ namespace Shadow
 		virtual uint32_t getSize() const = 0;
 		virtual uint32_t getElementCount() const = 0;
 		virtual BufferUsage getUsage() const = 0;
+		virtual UploadTicket getUploadTicket() const = 0;
 
 		static Ref<StorageBuffer> create(const void* data, uint32_t size, uint32_t stride, BufferUsage usage);
 	private:
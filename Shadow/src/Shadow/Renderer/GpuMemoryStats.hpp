@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+namespace Shadow
+{
+	enum class GpuMemoryCategory : uint8_t
+	{
+		Textures,
+		Geometry, // vertex & index buffers
+		Staging,
+		RenderTargets,
+		Uniforms,
+		Storage,
+		Transient, // per-frame ring buffer
+		Count
+	};
+
+	inline const char* getGpuMemoryCategoryName(GpuMemoryCategory category)
+	{
+		switch (category)
+		{
+		case GpuMemoryCategory::Textures:      return "Textures";
+		case GpuMemoryCategory::Geometry:      return "Vertex/Index buffers";
+		case GpuMemoryCategory::Staging:       return "Staging";
+		case GpuMemoryCategory::RenderTargets: return "Render targets";
+		case GpuMemoryCategory::Uniforms:      return "Uniform buffers";
+		case GpuMemoryCategory::Storage:       return "Storage buffers";
+		case GpuMemoryCategory::Transient:     return "Per-frame ring";
+		default:                               return "Unknown";
+		}
+	}
+
+	// memory a resource gave back once its upload was done
+	enum class ReclaimedMemory : uint8_t
+	{
+		Staging,    // staging copies of static buffers and textures
+		MeshData,   // cpu copies of mesh vertices and indices
+		ShaderCode, // spir-v kept after the shader modules were created
+		Count
+	};
+
+	inline const char* getReclaimedMemoryName(ReclaimedMemory reclaimed)
+	{
+		switch (reclaimed)
+		{
+		case ReclaimedMemory::Staging:    return "Staging";
+		case ReclaimedMemory::MeshData:   return "Mesh vertices/indices";
+		case ReclaimedMemory::ShaderCode: return "SPIR-V";
+		default:                          return "Unknown";
+		}
+	}
+
+	struct GpuHeapStats
+	{
+		uint64_t usage = 0;  // bytes the whole process uses on the heap
+		uint64_t budget = 0; // bytes the process can use before the driver starts evicting/failing
+		uint64_t blockBytes = 0;      // device memory the allocator has taken
+		uint64_t allocationBytes = 0; // part of blockBytes handed out to resources
+		bool deviceLocal = false;
+
+		// share of the allocator's blocks that isn't handed out
+		inline float getFragmentation() const { return blockBytes ? 1.0f - static_cast<float>(allocationBytes) / blockBytes : 0.0f; }
+	};
+
+	struct GpuDefragmentationStats
+	{
+		bool running = false;
+		uint32_t runs = 0; // finished runs
+		uint64_t bytesMoved = 0;
+		uint64_t bytesFreed = 0; // device memory blocks given back to the driver
+		uint32_t allocationsMoved = 0;
+
+		// device local heaps, at the start and at the end of the last finished run (see GpuHeapStats::getFragmentation)
+		float fragmentationBefore = 0.0f;
+		float fragmentationAfter = 0.0f;
+	};
+
+	struct GpuMemoryStats
+	{
+		static constexpr uint32_t s_maxHeaps = 16; // VK_MAX_MEMORY_HEAPS
+
+		std::array<GpuHeapStats, s_maxHeaps> heaps;
+		uint32_t heapCount = 0;
+
+		std::array<uint64_t, static_cast<size_t>(GpuMemoryCategory::Count)> categoryBytes{};
+		std::array<uint32_t, static_cast<size_t>(GpuMemoryCategory::Count)> categoryAllocations{};
+
+		// running totals, bytes that are no longer kept around (host memory for MeshData and ShaderCode)
+		std::array<uint64_t, static_cast<size_t>(ReclaimedMemory::Count)> reclaimedBytes{};
+
+		GpuDefragmentationStats defragmentation;
+
+		// without VK_EXT_memory_budget usage only counts the allocator's blocks and the budget is an estimate (80% of the heap)
+		bool budgetQueried = false;
+	};
+}
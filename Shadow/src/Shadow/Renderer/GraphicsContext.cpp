@@ -18,6 +18,17 @@ namespace Shadow
             SH_ASSERT(false, "Failed to create graphics context");
     }
 
+    void GraphicsContext::createHeadless(uint32_t width, uint32_t height)
+    {
+        switch (Renderer::getRendererType())
+        {
+            case RendererType::Vulkan: s_ctx = new VulkanContext(width, height); break;
+        }
+
+        if (!s_ctx)
+            SH_ASSERT(false, "Failed to create headless graphics context");
+    }
+
     void GraphicsContext::destroy()
     {
         delete s_ctx;
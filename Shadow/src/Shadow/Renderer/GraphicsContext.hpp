@@ -16,6 +16,7 @@ namespace Shadow
 
 		static void destroy();
 		static void create(GLFWwindow* windowHandle);
+		static void createHeadless(uint32_t width, uint32_t height);
 	private:
 		inline static GraphicsContext* s_ctx{ nullptr };
 	};
@@ -26,11 +26,23 @@ namespace Shadow
         SH_ASSERT((pScene && !(pScene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) && pScene->mRootNode),
             "assimp::%s", importer.GetErrorString());
 
+        // the geometry and all textures go to the gpu in one submission
+        Renderer::beginResourceBatch();
+
         processNode(pScene->mRootNode, pScene);
         loadMaterials(pScene);
 
-        for (auto& future : m_futures)
-            future.wait();
+        // texture decoding runs on the job system while this thread helps out
+        JobSystem::wait(m_materialJobs);
+
+        // the shaders sample the texture heap, the vertices carry the heap index of their material's texture.
+        // the vertex buffer is immutable, so are the indices
+        for (Ref<Texture2D>& texture : m_textures)
+            texture->pinHeapIndex();
+
+        for (Vertex& vertex : m_vertices)
+            vertex.materialIndex = m_textures[vertex.materialIndex]->getHeapIndex();
+
 #ifndef OLD
         m_vertexBuffer = VertexBuffer::create(m_vertices.data(), sizeof(Vertex) * m_vertices.size(), sizeof(Vertex));
         m_indexBuffer = IndexBuffer::create(m_indices.data(), m_indices.size());
@@ -38,6 +50,14 @@ namespace Shadow
         m_vertexBuffer = RenderBuffer::createVertexBuffer(m_vertices.data(), sizeof(Vertex) * m_vertices.size(), sizeof(Vertex));
         m_indexBuffer = RenderBuffer::createIndexBuffer(m_indices.data(), m_indices.size());
 #endif
+
+        // the buffers have copied the data into staging memory, the gpu holds the only copy from here on
+        const uint64_t meshDataBytes = m_vertices.capacity() * sizeof(Vertex) + m_indices.capacity() * sizeof(uint32_t);
+        std::vector<Vertex>().swap(m_vertices);
+        std::vector<uint32_t>().swap(m_indices);
+        Renderer::trackReclaimedMemory(ReclaimedMemory::MeshData, meshDataBytes);
+
+        Renderer::endResourceBatch();
     }
 
     Mesh::~Mesh()
@@ -76,12 +96,11 @@ namespace Shadow
     {
         m_textures.resize(pScene->mNumMaterials);
 
-        for (uint32_t i = 0; i < pScene->mNumMaterials; i++)
-        {
-            m_textures[i] = nullptr;
-            m_futures.emplace_back(std::move(std::async(std::launch::async, loadMaterialAsync, 
-                std::ref(m_textures), pScene->mMaterials[i], pScene, i, std::cref(m_directory))));
-        }
+        JobSystem::parallelFor(pScene->mNumMaterials, 1, [this, pScene](uint32_t first, uint32_t last)
+            {
+                for (uint32_t i = first; i < last; i++)
+                    loadMaterialAsync(m_textures, pScene->mMaterials[i], pScene, i, m_directory);
+            }, m_materialJobs);
     }
 
     void Mesh::processNode(aiNode* node, const aiScene* scene)
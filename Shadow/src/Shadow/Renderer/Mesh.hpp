@@ -2,11 +2,11 @@
 
 #include "Shadow/Renderer/Buffer.hpp"
 #include "Shadow/Renderer/Pipeline.hpp"
+#include "Shadow/Core/JobSystem.hpp"
 		 
 #include <glm/glm.hpp>
 #include <assimp/scene.h>
 
-#include <future>
 #include <vector>
 
 namespace Shadow
@@ -19,7 +19,7 @@ namespace Shadow
 			glm::vec3 position;
 			glm::vec3 normal;
 			glm::vec2 texCoords;
-			uint32_t materialIndex;
+			uint32_t materialIndex; // texture heap index once the mesh is loaded, see Texture2D::getHeapIndex()
 		};
 	public:
 		Mesh(const std::string& path);
@@ -35,6 +35,7 @@ namespace Shadow
 		void processNode(aiNode* node, const aiScene* scene);
 		void processMesh(aiMesh* mesh, const aiScene* scene);
 	private:
+		// only filled while loading, the gpu buffers are the one copy of the geometry
 		std::vector<Vertex> m_vertices;
 		std::vector<uint32_t> m_indices;
 		std::vector<Ref<Texture2D>> m_textures;
@@ -44,7 +45,7 @@ namespace Shadow
 
 		VertexInput m_vertexInput;
 
-		std::vector<std::future<void>> m_futures;
+		JobCounter m_materialJobs;
 		std::string m_directory;
 	};
 }
\ No newline at end of file
@@ -73,6 +73,8 @@ namespace Shadow
         virtual void setRenderpassInput(const std::string& shaderName, uint32_t imageIndex, const Ref<Renderpass>& src) = 0;
 
         virtual const GraphicsPipeConfiguration& getConfiguration() const = 0;
+        // size of the data pPushConstants has to point to when the pipeline is bound
+        virtual uint32_t getPushConstantsSize() const = 0;
 
 		static Ref<GraphicsPipeline> create(const GraphicsPipeConfiguration& config);
 	};
@@ -82,6 +84,8 @@ namespace Shadow
     public:
         virtual ~ComputePipeline() = default;
 
+        virtual uint32_t getPushConstantsSize() const = 0;
+
         static Ref<ComputePipeline> create(const Ref<Shader>& computeShader); 
     };
 }
\ No newline at end of file
@@ -63,5 +63,6 @@ namespace Shadow
 
 		bool primitiveRestartEnable = false;
 		float lineWidth = 1.0f;
+		bool depthWriteEnable = true; // the depth test is always on
 	};
 }
\ No newline at end of file
@@ -0,0 +1,236 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+
+#include "Shadow/Renderer/QuadBuilder.hpp"
+
+#include <glm/ext.hpp>
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(__SSE2__)
+	#define SH_QUAD_BUILDER_SSE2
+	#include <emmintrin.h>
+#elif defined(_M_ARM64) || defined(__aarch64__)
+	#define SH_QUAD_BUILDER_NEON
+	#include <arm_neon.h>
+#endif
+
+namespace Shadow
+{
+	namespace
+	{
+		constexpr float s_degToRad = 0.01745329251994329577f;
+
+		// corners of 4 quads, [corner][quad]
+		struct QuadCorners
+		{
+			alignas(16) float x[4][4];
+			alignas(16) float y[4][4];
+			alignas(16) float z[4];
+		};
+
+		const glm::vec2 s_texCoords[4] = { { 0.0f, 0.0f }, { 1.0f, 0.0f }, { 1.0f, 1.0f }, { 0.0f, 1.0f } };
+
+		inline const glm::vec4& getColor(const RotatedQuads& quads, uint32_t i) { return quads.pColors ? quads.pColors[i] : quads.color; }
+		inline uint32_t getTexIndex(const RotatedQuads& quads, uint32_t i) { return quads.pTexIndices ? quads.pTexIndices[i] : quads.texIndex; }
+		inline float getTilingFactor(const RotatedQuads& quads, uint32_t i) { return quads.pTilingFactors ? quads.pTilingFactors[i] : quads.tilingFactor; }
+
+		inline void writeQuad(QuadVertex* pVertices, const float (&x)[4], const float (&y)[4], float z,
+			const glm::vec4& color, uint32_t texIndex, float tilingFactor)
+		{
+			for (uint32_t corner = 0; corner < 4; corner++)
+			{
+				pVertices[corner].position = { x[corner], y[corner], z };
+				pVertices[corner].color = color;
+				pVertices[corner].texCoords = s_texCoords[corner];
+				pVertices[corner].texIndex = texIndex;
+				pVertices[corner].tilingFactor = tilingFactor;
+			}
+		}
+
+		inline void writeQuads(const RotatedQuads& quads, uint32_t first, uint32_t count, const QuadCorners& corners, QuadVertex* pVertices)
+		{
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const float x[4] = { corners.x[0][i], corners.x[1][i], corners.x[2][i], corners.x[3][i] };
+				const float y[4] = { corners.y[0][i], corners.y[1][i], corners.y[2][i], corners.y[3][i] };
+				writeQuad(pVertices + (first + i) * 4, x, y, corners.z[i], getColor(quads, first + i), getTexIndex(quads, first + i), getTilingFactor(quads, first + i));
+			}
+		}
+
+		// same affine math as the simd paths, for the tail and the targets without them
+		void buildScalar(const RotatedQuads& quads, uint32_t first, QuadVertex* pVertices)
+		{
+			for (uint32_t i = first; i < quads.count; i++)
+			{
+				const glm::vec3& p = quads.pPositions[i];
+				const float angle = quads.pAngles[i] * s_degToRad;
+				const float s = std::sin(angle), c = std::cos(angle);
+				const float hx = 0.5f * quads.pSizes[i].x, hy = 0.5f * quads.pSizes[i].y;
+
+				// rotated half axes, a along the quad's x and b along its y
+				const float ax = c * hx, ay = s * hx;
+				const float bx = -s * hy, by = c * hy;
+
+				const float x[4] = { p.x - ax - bx, p.x + ax - bx, p.x + ax + bx, p.x - ax + bx };
+				const float y[4] = { p.y - ay - by, p.y + ay - by, p.y + ay + by, p.y - ay + by };
+				writeQuad(pVertices + i * 4, x, y, p.z, getColor(quads, i), getTexIndex(quads, i), getTilingFactor(quads, i));
+			}
+		}
+
+#if defined(SH_QUAD_BUILDER_SSE2)
+		// 4 lanes of sin and cos: reduction to [-pi/4, pi/4] by quadrants of pi/2 (cody-waite, 3 parts) and the cephes polynomials
+		inline void sincos4(__m128 x, __m128& outSin, __m128& outCos)
+		{
+			const __m128i quadrant = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(0.63661977236758134f)));
+			const __m128 q = _mm_cvtepi32_ps(quadrant);
+
+			__m128 r = _mm_sub_ps(x, _mm_mul_ps(q, _mm_set1_ps(1.5703125f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(4.837512969970703125e-4f)));
+			r = _mm_sub_ps(r, _mm_mul_ps(q, _mm_set1_ps(7.54978995489188216e-8f)));
+			const __m128 z = _mm_mul_ps(r, r);
+
+			__m128 sinPoly = _mm_add_ps(_mm_set1_ps(8.3321608736e-3f), _mm_mul_ps(z, _mm_set1_ps(-1.9515295891e-4f)));
+			sinPoly = _mm_add_ps(_mm_set1_ps(-1.6666654611e-1f), _mm_mul_ps(z, sinPoly));
+			sinPoly = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(r, z), sinPoly));
+
+			__m128 cosPoly = _mm_add_ps(_mm_set1_ps(-1.388731625493765e-3f), _mm_mul_ps(z, _mm_set1_ps(2.443315711809948e-5f)));
+			cosPoly = _mm_add_ps(_mm_set1_ps(4.166664568298827e-2f), _mm_mul_ps(z, cosPoly));
+			cosPoly = _mm_add_ps(_mm_sub_ps(_mm_set1_ps(1.0f), _mm_mul_ps(_mm_set1_ps(0.5f), z)), _mm_mul_ps(_mm_mul_ps(z, z), cosPoly));
+
+			// odd quadrants swap sin and cos, quadrants 2 and 3 negate sin, 1 and 2 negate cos
+			const __m128i one = _mm_set1_epi32(1), two = _mm_set1_epi32(2);
+			const __m128 swap = _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(quadrant, one), one));
+			const __m128 sinSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(quadrant, two), 30));
+			const __m128 cosSign = _mm_castsi128_ps(_mm_slli_epi32(_mm_and_si128(_mm_add_epi32(quadrant, one), two), 30));
+
+			const __m128 s = _mm_or_ps(_mm_and_ps(swap, cosPoly), _mm_andnot_ps(swap, sinPoly));
+			const __m128 c = _mm_or_ps(_mm_and_ps(swap, sinPoly), _mm_andnot_ps(swap, cosPoly));
+			outSin = _mm_xor_ps(s, sinSign);
+			outCos = _mm_xor_ps(c, cosSign);
+		}
+
+		inline void computeCorners4(const RotatedQuads& quads, uint32_t first, QuadCorners& corners)
+		{
+			// 4 vec3 -> x, y, z lanes
+			const float* pPositions = &quads.pPositions[first].x;
+			const __m128 p0 = _mm_loadu_ps(pPositions), p1 = _mm_loadu_ps(pPositions + 4), p2 = _mm_loadu_ps(pPositions + 8);
+			const __m128 px = _mm_shuffle_ps(_mm_shuffle_ps(p0, p0, _MM_SHUFFLE(3, 3, 0, 0)), _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(1, 1, 2, 2)), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 py = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(0, 0, 1, 1)), _mm_shuffle_ps(p1, p2, _MM_SHUFFLE(2, 2, 3, 3)), _MM_SHUFFLE(2, 0, 2, 0));
+			const __m128 pz = _mm_shuffle_ps(_mm_shuffle_ps(p0, p1, _MM_SHUFFLE(1, 1, 2, 2)), _mm_shuffle_ps(p2, p2, _MM_SHUFFLE(3, 3, 0, 0)), _MM_SHUFFLE(2, 0, 2, 0));
+
+			// 4 vec2 -> half sizes
+			const float* pSizes = &quads.pSizes[first].x;
+			const __m128 s0 = _mm_loadu_ps(pSizes), s1 = _mm_loadu_ps(pSizes + 4);
+			const __m128 half = _mm_set1_ps(0.5f);
+			const __m128 hx = _mm_mul_ps(half, _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(2, 0, 2, 0)));
+			const __m128 hy = _mm_mul_ps(half, _mm_shuffle_ps(s0, s1, _MM_SHUFFLE(3, 1, 3, 1)));
+
+			__m128 s, c;
+			sincos4(_mm_mul_ps(_mm_loadu_ps(quads.pAngles + first), _mm_set1_ps(s_degToRad)), s, c);
+
+			const __m128 ax = _mm_mul_ps(c, hx), ay = _mm_mul_ps(s, hx);
+			const __m128 bx = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(s, hy)), by = _mm_mul_ps(c, hy);
+			const __m128 lx = _mm_add_ps(ax, bx), ly = _mm_add_ps(ay, by);
+			const __m128 dx = _mm_sub_ps(ax, bx), dy = _mm_sub_ps(ay, by);
+
+			_mm_store_ps(corners.x[0], _mm_sub_ps(px, lx)); _mm_store_ps(corners.y[0], _mm_sub_ps(py, ly));
+			_mm_store_ps(corners.x[1], _mm_add_ps(px, dx)); _mm_store_ps(corners.y[1], _mm_add_ps(py, dy));
+			_mm_store_ps(corners.x[2], _mm_add_ps(px, lx)); _mm_store_ps(corners.y[2], _mm_add_ps(py, ly));
+			_mm_store_ps(corners.x[3], _mm_sub_ps(px, dx)); _mm_store_ps(corners.y[3], _mm_sub_ps(py, dy));
+			_mm_store_ps(corners.z, pz);
+		}
+#elif defined(SH_QUAD_BUILDER_NEON)
+		// same reduction and polynomials as the sse2 path
+		inline void sincos4(float32x4_t x, float32x4_t& outSin, float32x4_t& outCos)
+		{
+			const int32x4_t quadrant = vcvtnq_s32_f32(vmulq_n_f32(x, 0.63661977236758134f));
+			const float32x4_t q = vcvtq_f32_s32(quadrant);
+
+			float32x4_t r = vmlsq_n_f32(x, q, 1.5703125f);
+			r = vmlsq_n_f32(r, q, 4.837512969970703125e-4f);
+			r = vmlsq_n_f32(r, q, 7.54978995489188216e-8f);
+			const float32x4_t z = vmulq_f32(r, r);
+
+			float32x4_t sinPoly = vmlaq_n_f32(vdupq_n_f32(8.3321608736e-3f), z, -1.9515295891e-4f);
+			sinPoly = vmlaq_f32(vdupq_n_f32(-1.6666654611e-1f), z, sinPoly);
+			sinPoly = vmlaq_f32(r, vmulq_f32(r, z), sinPoly);
+
+			float32x4_t cosPoly = vmlaq_n_f32(vdupq_n_f32(-1.388731625493765e-3f), z, 2.443315711809948e-5f);
+			cosPoly = vmlaq_f32(vdupq_n_f32(4.166664568298827e-2f), z, cosPoly);
+			cosPoly = vmlaq_f32(vmlsq_n_f32(vdupq_n_f32(1.0f), z, 0.5f), vmulq_f32(z, z), cosPoly);
+
+			const int32x4_t one = vdupq_n_s32(1), two = vdupq_n_s32(2);
+			const uint32x4_t swap = vtstq_s32(quadrant, one);
+			const uint32x4_t sinSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(quadrant, two)), 30);
+			const uint32x4_t cosSign = vshlq_n_u32(vreinterpretq_u32_s32(vandq_s32(vaddq_s32(quadrant, one), two)), 30);
+
+			const float32x4_t s = vbslq_f32(swap, cosPoly, sinPoly);
+			const float32x4_t c = vbslq_f32(swap, sinPoly, cosPoly);
+			outSin = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(s), sinSign));
+			outCos = vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(c), cosSign));
+		}
+
+		inline void computeCorners4(const RotatedQuads& quads, uint32_t first, QuadCorners& corners)
+		{
+			const float32x4x3_t p = vld3q_f32(&quads.pPositions[first].x);
+			const float32x4x2_t size = vld2q_f32(&quads.pSizes[first].x);
+			const float32x4_t hx = vmulq_n_f32(size.val[0], 0.5f), hy = vmulq_n_f32(size.val[1], 0.5f);
+
+			float32x4_t s, c;
+			sincos4(vmulq_n_f32(vld1q_f32(quads.pAngles + first), s_degToRad), s, c);
+
+			const float32x4_t ax = vmulq_f32(c, hx), ay = vmulq_f32(s, hx);
+			const float32x4_t bx = vnegq_f32(vmulq_f32(s, hy)), by = vmulq_f32(c, hy);
+			const float32x4_t lx = vaddq_f32(ax, bx), ly = vaddq_f32(ay, by);
+			const float32x4_t dx = vsubq_f32(ax, bx), dy = vsubq_f32(ay, by);
+
+			vst1q_f32(corners.x[0], vsubq_f32(p.val[0], lx)); vst1q_f32(corners.y[0], vsubq_f32(p.val[1], ly));
+			vst1q_f32(corners.x[1], vaddq_f32(p.val[0], dx)); vst1q_f32(corners.y[1], vaddq_f32(p.val[1], dy));
+			vst1q_f32(corners.x[2], vaddq_f32(p.val[0], lx)); vst1q_f32(corners.y[2], vaddq_f32(p.val[1], ly));
+			vst1q_f32(corners.x[3], vsubq_f32(p.val[0], dx)); vst1q_f32(corners.y[3], vsubq_f32(p.val[1], dy));
+			vst1q_f32(corners.z, p.val[2]);
+		}
+#endif
+	}
+
+	void QuadBuilder::build(const RotatedQuads& quads, QuadVertex* pVertices)
+	{
+		uint32_t first = 0;
+
+#if defined(SH_QUAD_BUILDER_SSE2) || defined(SH_QUAD_BUILDER_NEON)
+		QuadCorners corners;
+		for (; first + 4 <= quads.count; first += 4)
+		{
+			computeCorners4(quads, first, corners);
+			writeQuads(quads, first, 4, corners, pVertices);
+		}
+#endif
+
+		buildScalar(quads, first, pVertices);
+	}
+
+	void QuadBuilder::buildReference(const RotatedQuads& quads, QuadVertex* pVertices)
+	{
+		const glm::vec4 vertexPositions[4] = {
+			{ -0.5f,-0.5f,0.0f,1.0f },
+			{  0.5f,-0.5f,0.0f,1.0f },
+			{  0.5f, 0.5f,0.0f,1.0f },
+			{ -0.5f, 0.5f,0.0f,1.0f } };
+
+		for (uint32_t i = 0; i < quads.count; i++)
+		{
+			glm::mat4 transform = glm::translate(glm::mat4(1.0f), quads.pPositions[i])
+				* glm::rotate(glm::mat4(1.0f), glm::radians(quads.pAngles[i]), { 0.0f,0.0f,1.0f })
+				* glm::scale(glm::mat4(1.0f), { quads.pSizes[i].x, quads.pSizes[i].y, 1.0f });
+
+			for (uint32_t corner = 0; corner < 4; corner++)
+			{
+				QuadVertex& vertex = pVertices[i * 4 + corner];
+				vertex.position = transform * vertexPositions[corner];
+				vertex.color = getColor(quads, i);
+				vertex.texCoords = s_texCoords[corner];
+				vertex.texIndex = getTexIndex(quads, i);
+				vertex.tilingFactor = getTilingFactor(quads, i);
+			}
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+namespace Shadow
+{
+	// vertex of Renderer2D's batched quads, the layout texture.vert reads
+	struct QuadVertex
+	{
+		glm::vec3 position;
+		glm::vec4 color;
+		glm::vec2 texCoords;
+		uint32_t texIndex;
+		float tilingFactor;
+	};
+
+	// quads rotated around their centers. structure of arrays, the kernel loads the inputs of several quads at once
+	struct RotatedQuads
+	{
+		uint32_t count = 0;
+		const glm::vec3* pPositions = nullptr; // centers
+		const glm::vec2* pSizes = nullptr;
+		const float* pAngles = nullptr;        // degrees, counter-clockwise
+		const glm::vec4* pColors = nullptr;    // nullptr -> every quad has 'color'
+		const uint32_t* pTexIndices = nullptr; // nullptr -> 'texIndex'
+		const float* pTilingFactors = nullptr; // nullptr -> 'tilingFactor'
+		glm::vec4 color{ 1.0f };
+		uint32_t texIndex = 0;
+		float tilingFactor = 1.0f;
+	};
+
+	class QuadBuilder
+	{
+	public:
+		// 4 vertices per quad, in the order of Renderer2D's index buffer (bottom left, bottom right, top right, top left).
+		// the corners come from a 2d affine transform (no mat4), 4 quads per iteration with SSE2 or NEON
+		static void build(const RotatedQuads& quads, QuadVertex* pVertices);
+
+		// one quad at a time through glm mat4s (translate * rotate * scale), the way Renderer2D used to build rotated quads.
+		// the baseline of the quad build benchmark
+		static void buildReference(const RotatedQuads& quads, QuadVertex* pVertices);
+	};
+}
@@ -4,6 +4,12 @@
 
 namespace Shadow
 {
+	enum class SubpassContents
+	{
+		Inline,
+		SecondaryCmdBuffers  // the render pass only executes secondary command buffers
+	};
+
 	class RenderCmdBuffer
 	{
 	public:
@@ -14,9 +20,16 @@ namespace Shadow
 		virtual void submit() = 0;
 
 		virtual void setViewport(float x, float y, float width, float height) = 0;
-		virtual void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr) = 0;
+		virtual void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr, SubpassContents contents = SubpassContents::Inline) = 0;
 		virtual void endRenderPass() = 0;
-		virtual void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr) = 0;
+		virtual void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr, SubpassContents contents = SubpassContents::Inline) = 0;
+		virtual void bindPipeline(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr) = 0;
+
+		// secondary command buffers are recorded by the calling thread, every draw call of that thread goes into it until endSecondary().
+		// executeSecondaries() runs the ones recorded since the last call in ascending order of 'order'
+		virtual void beginSecondary(const Ref<GraphicsPipeline>& pipe, uint32_t order, const void* pPushConstants = nullptr) = 0;
+		virtual void endSecondary() = 0;
+		virtual void executeSecondaries() = 0;
 
 		virtual void drawMesh(const Mesh& mesh) = 0;
 		virtual void draw(uint32_t verticesCount, uint32_t firstVertex = 0) = 0;
@@ -25,6 +38,13 @@ namespace Shadow
 		virtual void drawIndexed(const Ref<VertexBuffer>& vertexBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount = 0) = 0;
 		virtual void drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, uint32_t instanceCount) = 0;
 		virtual void drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t instanceCount) = 0;
+		virtual void draw(const TransientBuffer& vertices, uint32_t vertexCount) = 0;
+		virtual void drawIndexed(const TransientBuffer& vertices, const TransientBuffer& indices, uint32_t indexCount) = 0;
+		virtual void drawIndexed(const TransientBuffer& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount) = 0;
+		virtual void drawIndexed(const Ref<VertexArena>& arena, const ArenaSlice& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount, uint32_t firstIndex) = 0;
+
+		// any thread, see Renderer::allocateTransient()
+		virtual TransientBuffer allocateTransient(uint32_t size, BufferUsage usage) = 0;
 
 		virtual void beginTransfer() = 0;
 		virtual void submitTransfer(PipelineStages graphicsWaitStage) = 0;
@@ -32,6 +52,7 @@ namespace Shadow
 		virtual void beginCompute(const Ref<ComputePipeline>& pipe, uint32_t descriptorSet, const void* pPushConstants = nullptr) = 0;
 		virtual void submitCompute(PipelineStages graphicsWaitStage) = 0;
 		virtual void dispatch(uint32_t groupX, uint32_t groupY, uint32_t groupZ) = 0;
+		virtual void computeBarrier() = 0;
 
 		virtual void acquireFromGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess) = 0;
 		virtual void releaseToGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages srcStage, AccessFlags srcAccess) = 0;
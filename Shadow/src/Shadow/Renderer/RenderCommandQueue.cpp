@@ -0,0 +1,67 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+#include "Shadow/Renderer/RenderCommandQueue.hpp"
+
+namespace Shadow
+{
+	struct RenderCommandHeader
+	{
+		RenderCommandQueue::RenderCommandFn func;
+		uint32_t size; // aligned size of the command that follows the header
+	};
+
+	static constexpr uint32_t alignUp(uint32_t size, uint32_t alignment)
+	{
+		return (size + alignment - 1) & ~(alignment - 1);
+	}
+
+	RenderCommandQueue::RenderCommandQueue(uint32_t capacity)
+		: m_capacity(capacity)
+	{
+		m_bufferBase = static_cast<uint8_t*>(::operator new(capacity, std::align_val_t(s_alignment)));
+		m_bufferPtr = m_bufferBase;
+	}
+
+	RenderCommandQueue::~RenderCommandQueue()
+	{
+		// commands that have never been executed still own their captures
+		execute();
+		::operator delete(m_bufferBase, std::align_val_t(s_alignment));
+	}
+
+	void* RenderCommandQueue::allocate(RenderCommandFn func, uint32_t size)
+	{
+		const uint32_t headerSize = alignUp(sizeof(RenderCommandHeader), s_alignment);
+		const uint32_t commandSize = alignUp(size, s_alignment);
+
+		SH_ASSERT((getUsedSize() + headerSize + commandSize <= m_capacity), "render command queue is full :<");
+
+		RenderCommandHeader* pHeader = reinterpret_cast<RenderCommandHeader*>(m_bufferPtr);
+		pHeader->func = func;
+		pHeader->size = commandSize;
+
+		void* pCommand = m_bufferPtr + headerSize;
+		m_bufferPtr += headerSize + commandSize;
+		m_commandCount++;
+
+		return pCommand;
+	}
+
+	void RenderCommandQueue::execute()
+	{
+		SH_PROFILE_FUNCTION();
+
+		const uint32_t headerSize = alignUp(sizeof(RenderCommandHeader), s_alignment);
+		uint8_t* pCurrent = m_bufferBase;
+
+		for (uint32_t i = 0; i < m_commandCount; i++)
+		{
+			RenderCommandHeader* pHeader = reinterpret_cast<RenderCommandHeader*>(pCurrent);
+			pHeader->func(pCurrent + headerSize);
+			pCurrent += headerSize + pHeader->size;
+		}
+
+		m_bufferPtr = m_bufferBase;
+		m_commandCount = 0;
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Shadow
+{
+	// linear buffer of type-erased commands. every command is stored as [header][callable] and is destroyed right after it has been executed
+	class RenderCommandQueue
+	{
+	public:
+		typedef void(*RenderCommandFn)(void* pCommand);
+
+		RenderCommandQueue(uint32_t capacity = 2 * 1024 * 1024);
+		~RenderCommandQueue();
+		RenderCommandQueue(const RenderCommandQueue& other) = delete;
+		RenderCommandQueue& operator=(const RenderCommandQueue& other) = delete;
+
+		template<typename F>
+		void submit(F&& func)
+		{
+			using Command = std::decay_t<F>;
+			static_assert(alignof(Command) <= s_alignment, "render command is over-aligned :<");
+
+			RenderCommandFn commandFn = [](void* pCommand)
+			{
+				Command& command = *static_cast<Command*>(pCommand);
+				command();
+				command.~Command();
+			};
+
+			void* pStorage = allocate(commandFn, static_cast<uint32_t>(sizeof(Command)));
+			new (pStorage) Command(std::forward<F>(func));
+		}
+
+		// executes the commands in submission order and empties the queue
+		void execute();
+
+		inline uint32_t getCommandCount() const { return m_commandCount; }
+		inline uint32_t getUsedSize() const { return static_cast<uint32_t>(m_bufferPtr - m_bufferBase); }
+	private:
+		void* allocate(RenderCommandFn func, uint32_t size);
+	private:
+		static constexpr uint32_t s_alignment = 16;
+
+		uint8_t* m_bufferBase;
+		uint8_t* m_bufferPtr;
+		uint32_t m_capacity;
+		uint32_t m_commandCount = 0;
+	};
+}
@@ -0,0 +1,101 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+#include "Shadow/Renderer/RenderThread.hpp"
+
+namespace Shadow
+{
+	RenderThread::RenderThread()
+	{
+	}
+
+	RenderThread::~RenderThread()
+	{
+		if (isRunning())
+			stop();
+	}
+
+	void RenderThread::start()
+	{
+		SH_ASSERT(!isRunning(), "render thread is already running o^o");
+
+		m_running.store(true, std::memory_order_release);
+		m_thread = std::thread(&RenderThread::renderLoop, this);
+	}
+
+	void RenderThread::stop()
+	{
+		waitIdle();
+
+		{
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			m_running.store(false, std::memory_order_release);
+		}
+		m_stateCondition.notify_all();
+		m_thread.join();
+
+		// whatever has been submitted after the last kick is executed on the caller's thread
+		m_queues[m_submitIndex].execute();
+	}
+
+	void RenderThread::kick()
+	{
+		SH_PROFILE_FUNCTION();
+
+		waitIdle();
+
+		m_executeIndex = m_submitIndex;
+		m_submitIndex = (m_submitIndex + 1) % static_cast<uint32_t>(m_queues.size());
+
+		// release makes the filled queue and m_executeIndex visible to the render thread
+		{
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			m_state.store(State::Kicked, std::memory_order_release);
+		}
+		m_stateCondition.notify_all();
+	}
+
+	void RenderThread::waitIdle() const
+	{
+		SH_PROFILE_FUNCTION();
+
+		if (m_state.load(std::memory_order_acquire) == State::Idle)
+			return;
+
+		std::unique_lock<std::mutex> lock(m_stateMutex);
+		m_stateCondition.wait(lock, [this]()
+			{
+				return m_state.load(std::memory_order_acquire) == State::Idle;
+			});
+	}
+
+	void RenderThread::renderLoop()
+	{
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_stateMutex);
+				m_stateCondition.wait(lock, [this]()
+					{
+						return m_state.load(std::memory_order_acquire) == State::Kicked || !m_running.load(std::memory_order_acquire);
+					});
+
+				// stop() waits for the last kick to be executed before it clears m_running
+				if (m_state.load(std::memory_order_acquire) != State::Kicked)
+					return;
+
+				m_state.store(State::Busy, std::memory_order_relaxed);
+			}
+
+			{
+				SH_PROFILE_SCOPE("RenderThread - execute");
+				m_queues[m_executeIndex].execute();
+			}
+
+			{
+				std::scoped_lock<std::mutex> lock(m_stateMutex);
+				m_state.store(State::Idle, std::memory_order_release);
+			}
+			m_stateCondition.notify_all();
+		}
+	}
+}
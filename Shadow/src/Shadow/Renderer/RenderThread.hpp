@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Shadow/Renderer/RenderCommandQueue.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Shadow
+{
+	// the main thread fills one queue while the render thread executes the other one.
+	// the hand-off is a single state, the waiting side sleeps on m_stateCondition until the other one changes it
+	class RenderThread
+	{
+	public:
+		RenderThread();
+		~RenderThread();
+		RenderThread(const RenderThread& other) = delete;
+
+		void start();
+		void stop();
+
+		// hands the submit queue over to the render thread (after it has finished the previous one) and swaps the queues
+		void kick();
+		void waitIdle() const;
+
+		inline RenderCommandQueue& getSubmitQueue() { return m_queues[m_submitIndex]; }
+		inline bool isRenderThread() const { return std::this_thread::get_id() == m_thread.get_id(); }
+		inline bool isRunning() const { return m_running.load(std::memory_order_acquire); }
+	private:
+		void renderLoop();
+	private:
+		enum class State : uint32_t
+		{
+			Idle,
+			Kicked,
+			Busy
+		};
+
+		std::thread m_thread;
+		std::array<RenderCommandQueue, 2> m_queues;
+		uint32_t m_submitIndex = 0;  // only touched by the main thread
+		uint32_t m_executeIndex = 1; // published to the render thread through m_state
+
+		std::atomic<State> m_state{ State::Idle }; // changed under m_stateMutex, so a waiter can't miss the notification
+		std::atomic<bool> m_running{ false };
+
+		mutable std::mutex m_stateMutex;
+		mutable std::condition_variable m_stateCondition;
+	};
+}
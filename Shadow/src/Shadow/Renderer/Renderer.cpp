@@ -2,6 +2,13 @@
 #include "Shadow/Core/Core.hpp"	
 #include "Shadow/Renderer/Renderer.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
+#include "Shadow/Core/JobSystem.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
+
+#include <thread>
 
 namespace Shadow
 {
@@ -9,126 +16,281 @@ namespace Shadow
 	{
 		ShaderLibrary shaderLib;
 		Ref<RenderCmdBuffer> cmdBuffer;
+
+		Scope<RenderThread> renderThread;
+		std::thread::id mainThreadID;
+
+		RendererCapabilities capabilities;
 	};
 	static RendererData* s_data;
 
-	void Renderer::init()
+	// push constants are read when the command gets executed, so the caller's data has to be copied
+	struct PushConstantsCopy
 	{
+		std::array<uint8_t, 128> data; // 128 bytes is the guaranteed minimum of maxPushConstantsSize
+		bool valid = false;
+
+		PushConstantsCopy(const void* pPushConstants, uint32_t size)
+		{
+			SH_ASSERT((size <= data.size()), "push constants don't fit into 128 bytes :<");
+
+			if (pPushConstants)
+			{
+				memcpy(data.data(), pPushConstants, size);
+				valid = true;
+			}
+		}
+
+		inline const void* get() const { return valid ? data.data() : nullptr; }
+	};
+
+	void Renderer::init(bool useRenderThread)
+	{
+		FrameAllocator::init(VulkanDevice::s_maxFramesInFlight);
+
 		s_data = new RendererData();
 		s_data->cmdBuffer = createRef<VulkanCmdBuffer>();
+		s_data->mainThreadID = std::this_thread::get_id();
+
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(VulkanContext::getVulkanDevice()->getPhysicalDevice(), &properties);
+		s_data->capabilities.maxPerStageTextures = std::min(properties.limits.maxPerStageDescriptorSamplers, properties.limits.maxPerStageDescriptorSampledImages);
+		s_data->capabilities.maxBoundDescriptorSets = properties.limits.maxBoundDescriptorSets;
+		s_data->capabilities.textureHeapCapacity = VulkanContext::getVulkanDevice()->getTextureHeap().getCapacity();
+
+		if (useRenderThread)
+		{
+			s_data->renderThread = createScope<RenderThread>();
+			s_data->renderThread->start();
+		}
 	}
 
 	void Renderer::shutdown()
 	{
+		if (s_data->renderThread)
+			s_data->renderThread->stop();
+
 		delete s_data;
+		FrameAllocator::shutdown();
+	}
+
+	void Renderer::setFrameThread()
+	{
+		s_data->mainThreadID = std::this_thread::get_id();
+	}
+
+	bool Renderer::isRenderThreadEnabled()
+	{
+		return s_data->renderThread != nullptr;
+	}
+
+	RenderThread* Renderer::getRenderThread()
+	{
+		return s_data->renderThread.get();
+	}
+
+	RenderCommandQueue* Renderer::getSubmitQueue()
+	{
+		if (!s_data->renderThread || std::this_thread::get_id() != s_data->mainThreadID)
+			return nullptr;
+
+		return &s_data->renderThread->getSubmitQueue();
 	}
 
 	void Renderer::begin()
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->begin();
+		submit([]() { s_data->cmdBuffer->begin(); });
 	}
 
 	void Renderer::end()
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->end();
+		submit([]() { s_data->cmdBuffer->end(); });
 	}
 
 	void Renderer::drawMesh(const Mesh& mesh)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->drawMesh(mesh);
+		const Mesh* pMesh = &mesh;
+		submit([pMesh]() { s_data->cmdBuffer->drawMesh(*pMesh); });
 	}
 
 	void Renderer::setViewport(float x, float y, float width, float height)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->setViewport(x, y, width, height);
+		submit([=]() { s_data->cmdBuffer->setViewport(x, y, width, height); });
 	}
 
-	void Renderer::beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	void Renderer::beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->beginRenderPass(pipe, pPushConstants);
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, pushConstants, contents]() { s_data->cmdBuffer->beginRenderPass(pipe, pushConstants.get(), contents); });
 	}
 
 	void Renderer::endRenderPass()
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->endRenderPass();
+		submit([]() { s_data->cmdBuffer->endRenderPass(); });
 	};
 
 	void Renderer::draw(uint32_t verticesCount, uint32_t firstVertex)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->draw(verticesCount, firstVertex);
+		submit([=]() { s_data->cmdBuffer->draw(verticesCount, firstVertex); });
+	}
+
+	void Renderer::nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, pushConstants, contents]() { s_data->cmdBuffer->nextSubpass(pipe, pushConstants.get(), contents); });
+	}
+
+	void Renderer::bindPipeline(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, pushConstants]() { s_data->cmdBuffer->bindPipeline(pipe, pushConstants.get()); });
+	}
+
+	void Renderer::beginSecondary(const Ref<GraphicsPipeline>& pipe, uint32_t order, const void* pPushConstants)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, order, pushConstants]() { s_data->cmdBuffer->beginSecondary(pipe, order, pushConstants.get()); });
+	}
+
+	void Renderer::endSecondary()
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([]() { s_data->cmdBuffer->endSecondary(); });
+	}
+
+	void Renderer::executeSecondaries()
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([]() { s_data->cmdBuffer->executeSecondaries(); });
 	}
 
-	void Renderer::nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	void Renderer::recordParallel(const Ref<GraphicsPipeline>& pipe, uint32_t chunkCount, const std::function<void(uint32_t)>& recordChunk,
+		const void* pPushConstants)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->nextSubpass(pipe, pPushConstants);
+
+		// the chunks call back into this facade from job system threads, which never defer, so the whole recording is a single command
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, chunkCount, recordChunk, pushConstants]()
+			{
+				JobSystem::parallelFor(chunkCount, 1, [&](uint32_t first, uint32_t last)
+					{
+						for (uint32_t chunk = first; chunk < last; chunk++)
+						{
+							s_data->cmdBuffer->beginSecondary(pipe, chunk, pushConstants.get());
+							recordChunk(chunk);
+							s_data->cmdBuffer->endSecondary();
+						}
+					});
+
+				s_data->cmdBuffer->executeSecondaries();
+			});
 	}
 
 	void Renderer::draw(const Ref<VertexBuffer>& vertexBuffer)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->draw(vertexBuffer);
+		submit([=]() { s_data->cmdBuffer->draw(vertexBuffer); });
 	}
 
 	void Renderer::draw(const Ref<StorageBuffer>& vertexBuffer)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->draw(vertexBuffer);
+		submit([=]() { s_data->cmdBuffer->draw(vertexBuffer); });
 	}
 
 	void Renderer::drawIndexed(const Ref<VertexBuffer>& vertexBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->drawIndexed(vertexBuffer, indexBuffer, indexCount);
+		submit([=]() { s_data->cmdBuffer->drawIndexed(vertexBuffer, indexBuffer, indexCount); });
 	}
 
 	void Renderer::drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, uint32_t instanceCount)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->drawInstanced(vertexBuffer,instanceBuffer, instanceCount);
+		submit([=]() { s_data->cmdBuffer->drawInstanced(vertexBuffer,instanceBuffer, instanceCount); });
 	}
 
 	void Renderer::drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t instanceCount)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->drawInstanced(vertexBuffer, instanceBuffer, indexBuffer, instanceCount);
+		submit([=]() { s_data->cmdBuffer->drawInstanced(vertexBuffer, instanceBuffer, indexBuffer, instanceCount); });
+	}
+
+	TransientBuffer Renderer::allocateTransient(uint32_t size, BufferUsage usage)
+	{
+		return s_data->cmdBuffer->allocateTransient(size, usage);
+	}
+
+	void Renderer::draw(const TransientBuffer& vertices, uint32_t vertexCount)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([=]() { s_data->cmdBuffer->draw(vertices, vertexCount); });
+	}
+
+	void Renderer::drawIndexed(const TransientBuffer& vertices, const TransientBuffer& indices, uint32_t indexCount)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([=]() { s_data->cmdBuffer->drawIndexed(vertices, indices, indexCount); });
+	}
+
+	void Renderer::drawIndexed(const TransientBuffer& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([=]() { s_data->cmdBuffer->drawIndexed(vertices, indexBuffer, indexCount); });
+	}
+
+	void Renderer::drawIndexed(const Ref<VertexArena>& arena, const ArenaSlice& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount, uint32_t firstIndex)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([=]() { s_data->cmdBuffer->drawIndexed(arena, vertices, indexBuffer, indexCount, firstIndex); });
 	}
 
 	void Renderer::beginTransfer()
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->beginTransfer();
+		submit([]() { s_data->cmdBuffer->beginTransfer(); });
 	}
 
 	void Renderer::submitTransfer(PipelineStages graphicsWaitStage)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->submitTransfer(graphicsWaitStage);
+		submit([=]() { s_data->cmdBuffer->submitTransfer(graphicsWaitStage); });
 	}
 
 	void Renderer::submitCompute(PipelineStages graphicsWaitStage)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->submitCompute(graphicsWaitStage);
+		submit([=]() { s_data->cmdBuffer->submitCompute(graphicsWaitStage); });
 	}
 
 	void Renderer::beginCompute(const Ref<ComputePipeline>& pipe, uint32_t descriptorSet, const void* pPushConstants)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->beginCompute(pipe, descriptorSet, pPushConstants);
+		PushConstantsCopy pushConstants(pPushConstants, pipe->getPushConstantsSize());
+		submit([pipe, descriptorSet, pushConstants]() { s_data->cmdBuffer->beginCompute(pipe, descriptorSet, pushConstants.get()); });
 	}
 
 	void Renderer::dispatch(uint32_t groupX, uint32_t groupY, uint32_t groupZ)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->dispatch(groupX, groupY, groupZ);
+		submit([=]() { s_data->cmdBuffer->dispatch(groupX, groupY, groupZ); });
+	}
+
+	void Renderer::computeBarrier()
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+		submit([]() { s_data->cmdBuffer->computeBarrier(); });
 	}
 
 	void Renderer::memoryBarrier(PipelineStages srcStage, PipelineStages dstStage, AccessFlags srcAccess, AccessFlags dstAccess)
@@ -153,32 +315,77 @@ namespace Shadow
 		return s_data->cmdBuffer;
 	}
 
+	GpuMemoryStats Renderer::getMemoryStats()
+	{
+		return VulkanContext::getVulkanDevice()->getMemoryStats();
+	}
+
+	void Renderer::trackReclaimedMemory(ReclaimedMemory reclaimed, uint64_t bytes)
+	{
+		VulkanContext::getVulkanDevice()->trackReclaimed(reclaimed, bytes);
+	}
+
+	void Renderer::defragmentMemory()
+	{
+		VulkanContext::getVulkanDevice()->getDefragmenter().request();
+	}
+
+	bool Renderer::isUploadComplete(UploadTicket ticket)
+	{
+		return VulkanContext::getVulkanDevice()->getUploadManager().isComplete(ticket);
+	}
+
+	void Renderer::waitForUpload(UploadTicket ticket)
+	{
+		VulkanContext::getVulkanDevice()->getUploadManager().wait(ticket);
+	}
+
+	void Renderer::useUpload(UploadTicket ticket)
+	{
+		VulkanContext::getVulkanDevice()->getUploadManager().use(ticket);
+	}
+
+	void Renderer::beginResourceBatch()
+	{
+		VulkanContext::getVulkanDevice()->getUploadManager().beginBatch();
+	}
+
+	UploadTicket Renderer::endResourceBatch()
+	{
+		return VulkanContext::getVulkanDevice()->getUploadManager().endBatch();
+	}
+
 	RendererType Renderer::getRendererType()
 	{
 		return RendererType::Vulkan;
 	}
 
+	const RendererCapabilities& Renderer::getCapabilities()
+	{
+		return s_data->capabilities;
+	}
+
 	void Renderer::acquireFromGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->acquireFromGraphicsQueue(buffer, dstStage, dstAccess);
+		submit([=]() { s_data->cmdBuffer->acquireFromGraphicsQueue(buffer, dstStage, dstAccess); });
 	}
 
 	void Renderer::releaseToGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages srcStage, AccessFlags srcAccess)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->releaseToGraphicsQueue(buffer, srcStage, srcAccess);
+		submit([=]() { s_data->cmdBuffer->releaseToGraphicsQueue(buffer, srcStage, srcAccess); });
 	}
 
 	void Renderer::acquireFromComputeQueue(const Ref<StorageBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->acquireFromGraphicsQueue(buffer, dstStage, dstAccess);
+		submit([=]() { s_data->cmdBuffer->acquireFromGraphicsQueue(buffer, dstStage, dstAccess); });
 	}
 
 	void Renderer::releaseToComputeQueue(const Ref<StorageBuffer>& buffer, PipelineStages srcStage, AccessFlags srcAccess)
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
-		s_data->cmdBuffer->releaseToComputeQueue(buffer, srcStage, srcAccess);
+		submit([=]() { s_data->cmdBuffer->releaseToComputeQueue(buffer, srcStage, srcAccess); });
 	}
 }
\ No newline at end of file
@@ -7,6 +7,8 @@
 #include "Shadow/Renderer/Shader.hpp"
 #include "Shadow/Renderer/Camera.hpp"
 #include "Shadow/Renderer/RenderCmdBuffer.hpp"
+#include "Shadow/Renderer/RenderThread.hpp"
+#include "Shadow/Renderer/GpuMemoryStats.hpp"
 
 struct GLFWwindow;
 
@@ -18,19 +20,57 @@ namespace Shadow
 		Vulkan
 	};
 
+	// device limits the renderers size their resources by, filled in by Renderer::init()
+	struct RendererCapabilities
+	{
+		uint32_t maxPerStageTextures = 0; // textures (combined image samplers) one shader stage can access
+		uint32_t maxBoundDescriptorSets = 0;
+		uint32_t textureHeapCapacity = 0; // textures that can be alive at once, see Texture2D::getHeapIndex()
+	};
+
+	// with the render thread enabled every call the main thread makes through this facade is recorded into the render command queue
+	// and executed one frame later on the render thread. arguments are captured by value (push constants are copied),
+	// everything passed by reference (meshes, buffers behind Refs) has to stay alive until the frame has been executed
 	class Renderer
 	{
 	public:
-		static void init();
+		static void init(bool useRenderThread = false);
 		static void shutdown();
 
+		template<typename F>
+		static void submit(F&& func)
+		{
+			if (RenderCommandQueue* pQueue = getSubmitQueue())
+				pQueue->submit(std::forward<F>(func));
+			else
+				func();
+		}
+
+		// the thread whose calls are deferred to the render thread, the one that called init() by default
+		static void setFrameThread();
+		static bool isRenderThreadEnabled();
+		static RenderThread* getRenderThread();
+
 		static void begin();
 		static void end();
 
 		static void setViewport(float x, float y, float width, float height);
-		static void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr);
+		static void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr, SubpassContents contents = SubpassContents::Inline);
 		static void endRenderPass();
-		static void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr);
+		static void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr, SubpassContents contents = SubpassContents::Inline);
+		// switches to another pipeline of the same subpass, the draws that follow use it
+		static void bindPipeline(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants = nullptr);
+
+		static void beginSecondary(const Ref<GraphicsPipeline>& pipe, uint32_t order, const void* pPushConstants = nullptr);
+		static void endSecondary();
+		static void executeSecondaries();
+
+		// records chunkCount secondary command buffers on the job system and executes them in chunk order.
+		// has to be called inside a render pass (or subpass) that was begun with SubpassContents::SecondaryCmdBuffers.
+		// with the render thread enabled recordChunk runs after this has returned: capture by value, or make sure what it
+		// references stays alive until the render thread has executed the frame
+		static void recordParallel(const Ref<GraphicsPipeline>& pipe, uint32_t chunkCount, const std::function<void(uint32_t)>& recordChunk,
+			const void* pPushConstants = nullptr);
 
 		static void drawMesh(const Mesh& mesh);
 		static void draw(const Ref<VertexBuffer>& vertexBuffer);
@@ -44,11 +84,23 @@ namespace Shadow
 		static void drawInstanced(const Ref<RenderBuffer>& vertexBuffer, const Ref<RenderBuffer>& instanceBuffer,
 			const Ref<RenderBuffer>& indexBuffer, uint32_t instanceCount = 0);
 
+		// per-frame geometry: allocateTransient() runs right away on the calling thread (any thread) and returns mapped memory
+		// that is valid for the draws of the frame being recorded. fill it before the frame gets executed
+		static TransientBuffer allocateTransient(uint32_t size, BufferUsage usage);
+		static void draw(const TransientBuffer& vertices, uint32_t vertexCount);
+		static void drawIndexed(const TransientBuffer& vertices, const TransientBuffer& indices, uint32_t indexCount);
+		static void drawIndexed(const TransientBuffer& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount);
+		// the draw starts at the slice's vertex (vertexOffset) and may run past it into the slices allocated after it in the same block
+		static void drawIndexed(const Ref<VertexArena>& arena, const ArenaSlice& vertices, const Ref<IndexBuffer>& indexBuffer,
+			uint32_t indexCount, uint32_t firstIndex = 0);
+
 		static void beginTransfer();
 		static void submitTransfer(PipelineStages graphicsWaitStage);
 
 		static void beginCompute(const Ref<ComputePipeline>& pipe, uint32_t descriptorSet, const void* pPushConstants = nullptr);
 		static void dispatch(uint32_t groupX, uint32_t groupY, uint32_t groupZ);
+		// between dispatches of one compute pass: the following dispatches see what the previous ones have written
+		static void computeBarrier();
 		static void submitCompute(PipelineStages graphicsWaitStage);
 
 		static void acquireFromGraphicsQueue(const Ref<RenderBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess);
@@ -66,8 +118,31 @@ namespace Shadow
 		static void computeToGraphicsBarrier(const Ref<RenderBuffer>& buffer, PipelineStages srcStageMask, PipelineStages dstStageMask, AccessFlags srcAccess, AccessFlags dstAccess);
 		//////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
+		// live gpu memory usage per heap and per resource category, safe to call from any thread
+		static GpuMemoryStats getMemoryStats();
+		// resources that drop memory after their upload report it here, it shows up in GpuMemoryStats::reclaimedBytes
+		static void trackReclaimedMemory(ReclaimedMemory reclaimed, uint64_t bytes);
+		// moves the static buffers and textures closer together over the next frames, runs by itself once memory has fragmented
+		static void defragmentMemory();
+
+		// any thread. resources never have to be waited for before they are used, see UploadTicket
+		static bool isUploadComplete(UploadTicket ticket);
+		static void waitForUpload(UploadTicket ticket);
+		// the next frame waits (on the gpu) for the upload. the draws do it for what they bind, this is for resources that are
+		// read without being bound, like the textures in the texture heap
+		static void useUpload(UploadTicket ticket);
+
+		// any thread, scopes nest. the data of every resource created in the scope goes to the gpu as one batch (one command buffer,
+		// one submit) when the outermost scope ends. the returned ticket covers all of them, wait on it once if needed
+		static void beginResourceBatch();
+		static UploadTicket endResourceBatch();
+
 		static ShaderLibrary& getShaderLibrary();
 		static const Ref<RenderCmdBuffer>& getCmdBuffer();
 		static RendererType getRendererType();
+		static const RendererCapabilities& getCapabilities();
+	private:
+		// nullptr -> commands are executed immediately (no render thread, or the caller isn't the main thread)
+		static RenderCommandQueue* getSubmitQueue();
 	};
 }
\ No newline at end of file
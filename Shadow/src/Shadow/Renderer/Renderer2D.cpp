@@ -4,6 +4,7 @@
 
 #include "Shadow/Renderer/Renderer2D.hpp"
 #include "Shadow/Renderer/Renderer.hpp"
+#include "Shadow/Renderer/QuadBuilder.hpp"
 #include "Shadow/Renderer/Pipeline.hpp"
 #include "Shadow/ImGui/VkImGuiLayer.hpp"
 #include "Shadow/Vulkan/VulkanBuffer.hpp"
@@ -14,23 +15,16 @@
 
 namespace Shadow
 {
-	struct QuadVertex
-	{
-		glm::vec3 position;
-		glm::vec4 color;
-		glm::vec2 texCoords;
-		uint32_t texIndex;
-		float tilingFactor;
-	};
-
 	struct Renderer2DData
 	{
-		static const uint32_t maxQuads = 1000;
-		static const uint32_t maxVertices = maxQuads * 4;
+		static const uint32_t maxQuads = 128 * 1024; // per draw, the shared index buffer covers this many quads
 		static const uint32_t maxIndices = maxQuads * 6;
-	    static const uint32_t maxTextureSlots = 32; // TODO: RenderCapabilities
+		static const uint32_t chunkQuads = 4096;        // the quads are written into arena slices of this size
+		static const uint32_t arenaBlockQuads = 64 * 1024; // the first arena block, it grows to what a scene needs
 
-		Ref<GraphicsPipeline> graphicsPipeline;
+		// the pipeline field of the sort keys indexes these
+		enum PipelineIndex : uint8_t { OpaquePipeline = 0, TranslucentPipeline = 1, PipelineCount };
+		std::array<Ref<GraphicsPipeline>, PipelineCount> pipelines;
 		Ref<Shader> shader;
 		Ref<VertexBuffer> quadVertexBuffer;
 		Ref<IndexBuffer> quadIndexBuffer;
@@ -38,17 +32,63 @@ namespace Shadow
 		Ref<Renderpass> renderpass;
 		Ref<Texture2D> whiteTexture;
 
+		// every flush of the scene appends to the arena, the batches are drawn at endScene() with a vertex offset each
+		Ref<VertexArena> quadArena;
+
+		struct QuadBatch
+		{
+			ArenaSlice vertices; // first vertex of the batch, the rest follow it in the same arena block
+			uint32_t indexCount = 0;
+			uint8_t pipeline = OpaquePipeline;
+		};
+		std::vector<QuadBatch> batches;
+
+		// the current batch
+		ArenaSlice batchStart;
 		uint32_t quadIndexCount = 0;
-		uint32_t quadVertexOffset = 0;
-		uint32_t quadIndexOffset = 0;
+		uint8_t batchPipeline = OpaquePipeline;
+
+		// the quads of the scene in call order. flush() sorts them by their keys (see makeSortKey()) and builds their vertices in that order
+		struct QuadRecords
+		{
+			std::vector<glm::vec3> positions; // centers
+			std::vector<glm::vec2> sizes;
+			std::vector<float> angles;
+			std::vector<glm::vec4> colors;
+			std::vector<uint32_t> texIndices;
+			std::vector<float> tilingFactors;
+
+			inline uint32_t size() const { return static_cast<uint32_t>(positions.size()); }
+
+			void resize(uint32_t count)
+			{
+				positions.resize(count);
+				sizes.resize(count);
+				angles.resize(count);
+				colors.resize(count);
+				texIndices.resize(count);
+				tilingFactors.resize(count);
+			}
+		};
+		QuadRecords recordedQuads;
+		std::vector<uint64_t> sortKeys;
+		uint8_t layer = 0;
+
+		// radix sort and gather scratch, kept across scenes
+		QuadRecords sortedQuads;
+		std::vector<uint32_t> sortOrder, orderScratch;
+		std::vector<uint64_t> keyScratch;
+
+		glm::mat4 viewProjection{ 1.0f }; // push constant of the pipelines
 
+		// arena slice the quads are written into
+		ArenaSlice quadChunk;
 		QuadVertex* quadVertexBufferBase = nullptr;
 		QuadVertex* quadVertexBufferPtr = nullptr;
+		QuadVertex* quadVertexBufferEnd = nullptr;
 
-		std::array<Ref<Texture2D>, maxTextureSlots> textureSlots;
-		uint32_t textureSlotIndex = 1; // 0 = white texture
-
-		glm::vec4 quadVertexPositions[4];
+		// the quads index the texture heap, the untextured ones sample the white texture
+		uint32_t whiteTexIndex = 0;
 
 		struct QuadInstance
 		{
@@ -65,6 +105,69 @@ namespace Shadow
 	};
 	static Renderer2DData* s_rendererData; 
 
+	static constexpr uint64_t s_pipelineKeyMask = 0x7f;
+
+	// layer (8 bits) | translucent (1) | depth (32) | texture (16) | pipeline (7), the quads are drawn in ascending key order.
+	// larger z is closer to the camera: the opaque quads go front to back so the depth test rejects what they hide before it is shaded,
+	// the translucent ones back to front so they blend over what is behind them. equal keys keep the order of the calls
+	static uint64_t makeSortKey(uint8_t layer, bool translucent, float z, uint32_t texIndex)
+	{
+		// the float bits turned into an unsigned integer that grows with z
+		uint32_t depth;
+		memcpy(&depth, &z, sizeof(float));
+		depth = (depth & 0x80000000u) ? ~depth : depth | 0x80000000u;
+		if (!translucent)
+			depth = ~depth;
+
+		const uint64_t pipeline = translucent ? Renderer2DData::TranslucentPipeline : Renderer2DData::OpaquePipeline;
+
+		return (static_cast<uint64_t>(layer) << 56) | (static_cast<uint64_t>(translucent) << 55) | (static_cast<uint64_t>(depth) << 23) |
+			(static_cast<uint64_t>(texIndex & 0xffff) << 7) | pipeline;
+	}
+
+	// stable lsd radix sort, 8 bits per pass, the payload indices move with their keys. the bytes every key shares (the layer of a
+	// scene with one layer, the high texture bits...) are skipped, all histograms come from one read of the keys
+	static void radixSort(std::vector<uint64_t>& keys, std::vector<uint32_t>& indices, std::vector<uint64_t>& keyScratch, std::vector<uint32_t>& indexScratch)
+	{
+		const uint32_t count = static_cast<uint32_t>(keys.size());
+
+		uint32_t histograms[8][256]{};
+		for (uint64_t key : keys)
+		{
+			for (uint32_t pass = 0; pass < 8; pass++)
+				histograms[pass][(key >> (pass * 8)) & 0xff]++;
+		}
+
+		keyScratch.resize(count);
+		indexScratch.resize(count);
+
+		for (uint32_t pass = 0; pass < 8; pass++)
+		{
+			const uint32_t shift = pass * 8;
+			uint32_t* histogram = histograms[pass];
+			if (histogram[(keys[0] >> shift) & 0xff] == count)
+				continue;
+
+			uint32_t offset = 0;
+			for (uint32_t digit = 0; digit < 256; digit++)
+			{
+				const uint32_t digitCount = histogram[digit];
+				histogram[digit] = offset;
+				offset += digitCount;
+			}
+
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const uint32_t dst = histogram[(keys[i] >> shift) & 0xff]++;
+				keyScratch[dst] = keys[i];
+				indexScratch[dst] = indices[i];
+			}
+
+			keys.swap(keyScratch);
+			indices.swap(indexScratch);
+		}
+	}
+
 	void Renderer2D::init()                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                                          
 	{
 		s_rendererData = new Renderer2DData();
@@ -72,6 +175,8 @@ namespace Shadow
 		s_rendererData->whiteTexture = Texture2D::create(1, 1);
 		uint32_t whiteTextureData = 0xffffffff;
 		s_rendererData->whiteTexture->setData(&whiteTextureData);
+		s_rendererData->whiteTexIndex = s_rendererData->whiteTexture->getHeapIndex();
+		Renderer::useUpload(s_rendererData->whiteTexture->getUploadTicket());
 
 		std::string assetsPath = "C:/dev/Shadow/Shadow/assets/";
 
@@ -129,7 +234,16 @@ namespace Shadow
 		pipeConfig.shader = s_rendererData->shader;
 		pipeConfig.renderpass = s_rendererData->renderpass;
 		pipeConfig.subpass = 0;
-		s_rendererData->graphicsPipeline = GraphicsPipeline::create(pipeConfig);
+		s_rendererData->pipelines[Renderer2DData::OpaquePipeline] = GraphicsPipeline::create(pipeConfig);
+
+		// quads with a color alpha below 1 are blended over what is behind them, they are drawn after the opaque ones and don't hide each other
+		pipeConfig.states.blendState.blendEnable = true;
+		pipeConfig.states.blendState.srcColorBlendFactor = BlendFactor::SrcAlpha;
+		pipeConfig.states.blendState.dstColorBlendFactor = BlendFactor::OneMinusSrcAlpha;
+		pipeConfig.states.blendState.srcAlphaBlendFactor = BlendFactor::One;
+		pipeConfig.states.blendState.dstAlphaBlendFactor = BlendFactor::OneMinusSrcAlpha;
+		pipeConfig.states.depthWriteEnable = false;
+		s_rendererData->pipelines[Renderer2DData::TranslucentPipeline] = GraphicsPipeline::create(pipeConfig);
 
 #ifdef RENDERER2D_INSTANCED
 		float vertices[5 * 4]{
@@ -146,9 +260,6 @@ namespace Shadow
 		s_data->instanceBuffer = VertexBuffer::create(sizeof(s_data->quadInstances[0]) * s_data->quadInstances.size());
 		s_data->shader = Shader::create("texture", assetsPath + "shaders/instanced2d.vert.spv", assetsPath + "shaders/texture.frag.spv");
 #else
-		s_rendererData->quadVertexBuffer = VertexBuffer::create(Renderer2DData::maxVertices * sizeof(QuadVertex), quadVertInput);
-		s_rendererData->quadVertexBufferBase = new QuadVertex[Renderer2DData::maxIndices];
-
 		uint32_t* quadIndices = new uint32_t[Renderer2DData::maxIndices];
 
 		uint32_t offset = 0;
@@ -167,25 +278,13 @@ namespace Shadow
 
 		s_rendererData->quadIndexBuffer = IndexBuffer::create(quadIndices, Renderer2DData::maxIndices);
 		delete[] quadIndices;
-#endif
 
-		s_rendererData->textureSlots[0] = s_rendererData->whiteTexture;
-		s_rendererData->textureSlotIndex = 1;
-
-		s_rendererData->quadIndexCount = 0;
-		s_rendererData->quadVertexBufferPtr = s_rendererData->quadVertexBufferBase;
-		
-		s_rendererData->quadVertexPositions[0] = { -0.5f,-0.5f,0.0f,1.0f };
-		s_rendererData->quadVertexPositions[1] = {  0.5f,-0.5f,0.0f,1.0f };
-		s_rendererData->quadVertexPositions[2] = {  0.5f, 0.5f,0.0f,1.0f };
-		s_rendererData->quadVertexPositions[3] = { -0.5f, 0.5f,0.0f,1.0f };
+		s_rendererData->quadArena = VertexArena::create(sizeof(QuadVertex), Renderer2DData::arenaBlockQuads * 4);
+#endif
 	}
 
 	void Renderer2D::shutdown()
 	{
-#ifndef RENDERER2D_INSTANCED
-		delete[] s_rendererData->quadVertexBufferBase;
-#endif 
 		delete s_rendererData;
 	}
 
@@ -193,59 +292,121 @@ namespace Shadow
 	{
 #ifdef RENDERER2D_INSTANCED
 		s_data->instanceCount = 0;
+#else
+		// the first quad of the scene asks the arena for a chunk
+		s_rendererData->batches.clear();
+		s_rendererData->quadChunk = {};
+		s_rendererData->quadVertexBufferBase = nullptr;
+		s_rendererData->quadVertexBufferPtr = nullptr;
+		s_rendererData->quadVertexBufferEnd = nullptr;
+		s_rendererData->quadIndexCount = 0;
+		s_rendererData->batchPipeline = Renderer2DData::OpaquePipeline;
+		s_rendererData->layer = 0;
 #endif
-		s_rendererData->quadIndexOffset = 0;
-		s_rendererData->quadVertexOffset = 0;
-		s_rendererData->quadVertexBufferPtr = s_rendererData->quadVertexBufferBase;
+		s_rendererData->viewProjection = camera.getVPMatrix();
 
 		const Window& window = Shadow::ShEngine::get().getWindow();
 
 		Renderer::setViewport(0, 0, static_cast<float>(window.getWidth()), static_cast<float>(window.getHeight()));
-		Renderer::beginRenderPass(s_rendererData->graphicsPipeline, &camera.getVPMatrix());
+		Renderer::beginRenderPass(s_rendererData->pipelines[Renderer2DData::OpaquePipeline], &s_rendererData->viewProjection);
 	}
 
 	void Renderer2D::endScene()
 	{
 		flush();
+
+#ifndef RENDERER2D_INSTANCED
+		// the textures are all in the texture heap, nothing has to be written between the draws. only the pipeline changes
+		uint8_t boundPipeline = Renderer2DData::OpaquePipeline;
+		for (const Renderer2DData::QuadBatch& batch : s_rendererData->batches)
+		{
+			if (batch.pipeline != boundPipeline)
+			{
+				Renderer::bindPipeline(s_rendererData->pipelines[batch.pipeline], &s_rendererData->viewProjection);
+				boundPipeline = batch.pipeline;
+			}
+
+			Renderer::drawIndexed(s_rendererData->quadArena, batch.vertices, s_rendererData->quadIndexBuffer, batch.indexCount);
+
+#ifdef RENDERER_STATISTICS
+			s_rendererData->stats.drawCalls++;
+#endif
+		}
+		s_rendererData->batches.clear();
+#endif
 		Renderer::endRenderPass();
 	}
 
 	void Renderer2D::flush()
 	{
-		//SH_PROFILE_RENDERER_FUNCTION();
+#ifndef RENDERER2D_INSTANCED
+		buildQuads();
+#endif
+		drawBatch();
+	}
+
+	void Renderer2D::setLayer(uint8_t layer)
+	{
+		s_rendererData->layer = layer;
+	}
 
-		s_rendererData->shader->writeDescriptorSet("u_samplers", s_rendererData->textureSlotIndex, s_rendererData->textureSlots.data(), 0);
+	void Renderer2D::beginBatch()
+	{
+		// the batch starts where the next quad will be written
+		s_rendererData->batchStart = s_rendererData->quadChunk;
+		s_rendererData->batchStart.firstVertex += static_cast<uint32_t>(s_rendererData->quadVertexBufferPtr - s_rendererData->quadVertexBufferBase);
+		s_rendererData->quadIndexCount = 0;
+	}
+
+	void Renderer2D::drawBatch()
+	{
+		//SH_PROFILE_RENDERER_FUNCTION();
 
 #ifdef RENDERER2D_INSTANCED
 		s_data->instanceBuffer->setData(s_data->quadInstances.data(), 0);
 		Renderer::drawInstanced(s_data->quadVertexBuffer, s_data->quadIndexBuffer, s_data->instanceBuffer, s_data->instanceCount);
 #else
-		uint32_t dataSize = static_cast<uint32_t>((uint8_t*)s_rendererData->quadVertexBufferPtr - ((uint8_t*)s_rendererData->quadVertexBufferBase+s_rendererData->quadVertexOffset));
+		// nothing is drawn yet, the batch is kept until endScene()
+		if (s_rendererData->quadIndexCount)
+		{
+			Renderer2DData::QuadBatch& batch = s_rendererData->batches.emplace_back();
+			batch.vertices = s_rendererData->batchStart;
+			batch.indexCount = s_rendererData->quadIndexCount;
+			batch.pipeline = s_rendererData->batchPipeline;
+		}
 
-		Renderer::beginTransfer();
-		s_rendererData->quadVertexBuffer->setData(s_rendererData->quadVertexBufferBase, dataSize);
-		Renderer::submitTransfer(PipelineStages::VertexInput);
+		beginBatch();
+#endif
+	}
 
-		Renderer::drawIndexed(s_rendererData->quadVertexBuffer, s_rendererData->quadIndexBuffer);
+	void Renderer2D::nextChunk()
+	{
+		// the quads are written straight into memory the gpu reads, there is no staging copy and no transfer queue involved
+		const ArenaSlice chunk = s_rendererData->quadArena->allocate(Renderer2DData::chunkQuads * 4);
 
-		s_rendererData->quadIndexCount = 0;
-		s_rendererData->textureSlotIndex = 1;
-#endif
+		// a batch is one draw, so its quads have to be contiguous in one arena block and covered by the index buffer
+		if (s_rendererData->quadIndexCount && (chunk.block != s_rendererData->batchStart.block ||
+			s_rendererData->quadIndexCount + Renderer2DData::chunkQuads * 6 > Renderer2DData::maxIndices))
+		{
+			drawBatch();
+		}
 
-#ifdef RENDERER_STATISTICS
-		s_rendererData->stats.drawCalls++;
-#endif
+		s_rendererData->quadChunk = chunk;
+		s_rendererData->quadVertexBufferBase = static_cast<QuadVertex*>(chunk.pData);
+		s_rendererData->quadVertexBufferPtr = s_rendererData->quadVertexBufferBase;
+		s_rendererData->quadVertexBufferEnd = s_rendererData->quadVertexBufferBase + chunk.vertexCount;
+
+		if (!s_rendererData->quadIndexCount)
+			beginBatch();
 	}
 
 	void Renderer2D::drawQuad(const QuadProperties& properties)
 	{
-		uint32_t texIndex = properties.texture ? retrieveTexIndex(properties.texture) : 0;
+		uint32_t texIndex = properties.texture ? retrieveTexIndex(properties.texture) : s_rendererData->whiteTexIndex;
 
 #ifndef RENDERER2D_INSTANCED
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		setVerticesData(properties.position, properties.size, properties.color, texIndex, properties.tilingFactor);
+		// drawQuad() positions are the bottom left corner, the quads are recorded by their centers
+		recordQuad(properties.position + glm::vec3(0.5f * properties.size, 0.0f), properties.size, 0.0f, properties.color, texIndex, properties.tilingFactor);
 #else
 		s_data->quadInstances[s_data->instanceCount].transform = 
 			glm::translate(glm::mat4(1.0f), properties.position) * glm::scale(glm::mat4(1.0f), { properties.size, 1.0 });
@@ -267,14 +428,11 @@ namespace Shadow
 
 	void Renderer2D::drawQuad(const glm::vec3& position, const glm::vec2& size, const glm::vec4& color)
 	{
-		const uint32_t texIndex = 0;
+		const uint32_t texIndex = s_rendererData->whiteTexIndex;
 		const float tilingFactor = 1.0f;
 
 #ifndef RENDERER2D_INSTANCED
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		setVerticesData(position, size, color, 0, 1.0f);
+		recordQuad(position + glm::vec3(0.5f * size, 0.0f), size, 0.0f, color, texIndex, tilingFactor);
 #else
 		s_data->quadInstances[s_data->instanceCount].transform = 
 			glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), { size, 1.0 });
@@ -297,10 +455,7 @@ namespace Shadow
 		uint32_t texIndex = retrieveTexIndex(texture);
 
 #ifndef RENDERER2D_INSTANCED
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		setVerticesData(position, size, color, texIndex, tilingFactor);
+		recordQuad(position + glm::vec3(0.5f * size, 0.0f), size, 0.0f, color, texIndex, tilingFactor);
 #else
 		s_data->quadInstances[s_data->instanceCount].transform = 
 			glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), { size, 1.0 });
@@ -325,10 +480,7 @@ namespace Shadow
 		uint32_t texIndex = retrieveTexIndex(texture);
 
 #ifndef RENDERER2D_INSTANCED
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		setVerticesData(position, size, color, texIndex, tilingFactor);
+		recordQuad(position + glm::vec3(0.5f * size, 0.0f), size, 0.0f, color, texIndex, tilingFactor);
 #else
 		s_data->quadInstances[s_data->instanceCount].transform =
 			glm::translate(glm::mat4(1.0f), position) * glm::scale(glm::mat4(1.0f), { size, 1.0 });
@@ -345,7 +497,7 @@ namespace Shadow
 
 	void Renderer2D::drawRotatedQuad(const QuadProperties& properties, float angle)
 	{
-		uint32_t texIndex = properties.texture ? retrieveTexIndex(properties.texture) : 0;
+		uint32_t texIndex = properties.texture ? retrieveTexIndex(properties.texture) : s_rendererData->whiteTexIndex;
 
 #ifdef  RENDERER2D_INSTANCED
 		s_data->quadInstances[s_data->instanceCount].transform = glm::translate(glm::mat4(1.0f), properties.position)
@@ -356,14 +508,7 @@ namespace Shadow
 		s_data->quadInstances[s_data->instanceCount].texIndex = texIndex;
 		s_data->quadInstances[s_data->instanceCount++].tilingFactor = properties.tilingFactor;
 #else
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		glm::mat4 transform = glm::translate(glm::mat4(1.0f), properties.position)
-			* glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f,0.0f,1.0f })
-			* glm::scale(glm::mat4(1.0f), { properties.size.x, properties.size.y, 1.0f });
-
-		setVerticesData(transform, properties.color, texIndex, properties.tilingFactor);
+		recordQuad(properties.position, properties.size, angle, properties.color, texIndex, properties.tilingFactor);
 #endif
 
 #ifdef RENDERER_STATISTICS
@@ -386,17 +531,10 @@ namespace Shadow
 
 		s_data->quadInstances[s_data->instanceCount++].color = color;
 #else
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		const uint32_t texIndex = 0;
+		const uint32_t texIndex = s_rendererData->whiteTexIndex;
 		const float tilingFactor = 1.0f;
 
-		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position)
-			* glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f,0.0f,1.0f })
-			* glm::scale(glm::mat4(1.0f), {size.x, size.y, 1.0f });
-
-		setVerticesData(transform, color, texIndex, tilingFactor);
+		recordQuad(position, size, angle, color, texIndex, tilingFactor);
 #endif
 
 #ifdef RENDERER_STATISTICS
@@ -423,14 +561,7 @@ namespace Shadow
 		s_data->quadInstances[s_data->instanceCount].texIndex = texIndex;
 		s_data->quadInstances[s_data->instanceCount++].tilingFactor = tilingFactor;
 #else
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position)
-			* glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f,0.0f,1.0f })
-			* glm::scale(glm::mat4(1.0f), { size.x, size.y, 1.0f });
-
-		setVerticesData(transform, color, texIndex, tilingFactor);
+		recordQuad(position, size, angle, color, texIndex, tilingFactor);
 #endif
 
 #ifdef RENDERER_STATISTICS
@@ -456,14 +587,7 @@ namespace Shadow
 		s_data->quadInstances[s_data->instanceCount].texIndex = texIndex;
 		s_data->quadInstances[s_data->instanceCount++].tilingFactor = tilingFactor;
 #else
-		if (s_rendererData->quadIndexCount >= Renderer2DData::maxIndices)
-			flush();
-
-		glm::mat4 transform = glm::translate(glm::mat4(1.0f), position)
-			* glm::rotate(glm::mat4(1.0f), glm::radians(angle), { 0.0f,0.0f,1.0f })
-			* glm::scale(glm::mat4(1.0f), { size.x, size.y, 1.0f });
-
-		setVerticesData(transform, color, texIndex, tilingFactor);
+		recordQuad(position, size, angle, color, texIndex, tilingFactor);
 #endif
 
 #ifdef RENDERER_STATISTICS
@@ -471,6 +595,25 @@ namespace Shadow
 #endif
 	}
 
+	void Renderer2D::drawRotatedQuads(uint32_t count, const glm::vec3* pPositions, const glm::vec2* pSizes, const float* pAngles,
+		const glm::vec4* pColors, const Ref<Texture2D>& texture, float tilingFactor)
+	{
+#ifdef RENDERER2D_INSTANCED
+		for (uint32_t i = 0; i < count; i++)
+			drawRotatedQuad({ pPositions[i], pSizes[i], pColors ? pColors[i] : glm::vec4(1.0f), texture, tilingFactor }, pAngles[i]);
+#else
+		const uint32_t texIndex = texture ? retrieveTexIndex(texture) : s_rendererData->whiteTexIndex;
+		const glm::vec4 white{ 1.0f };
+
+		for (uint32_t i = 0; i < count; i++)
+			recordQuad(pPositions[i], pSizes[i], pAngles[i], pColors ? pColors[i] : white, texIndex, tilingFactor);
+
+#ifdef RENDERER_STATISTICS
+		s_rendererData->stats.quadCount += count;
+#endif
+#endif
+	}
+
 	void Renderer2D::resetStats()
 	{
 		memset(&s_rendererData->stats, 0, sizeof(Statistics));
@@ -481,92 +624,89 @@ namespace Shadow
 		return s_rendererData->stats;
 	}
 
-	void Renderer2D::setVerticesData(const glm::vec3& position, const glm::vec2& size, const glm::vec4& color, uint32_t texIndex, float tilingFactor)
-	{
-		s_rendererData->quadVertexBufferPtr->position = position;
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 0.0f, 0.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = { position.x + size.x, position.y, position.z };
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 1.0f, 0.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = { position.x + size.x, position.y + size.y, position.z };
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 1.0f, 1.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = { position.x, position.y + size.y, position.z };
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 0.0f, 1.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadIndexCount += 6;
-	}
-
-	void Renderer2D::setVerticesData(const glm::mat4& transform, const glm::vec4& color, uint32_t texIndex, float tilingFactor)
-	{
-		s_rendererData->quadVertexBufferPtr->position = transform * s_rendererData->quadVertexPositions[0];
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 0.0f, 0.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = transform * s_rendererData->quadVertexPositions[1];
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 1.0f, 0.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = transform * s_rendererData->quadVertexPositions[2];
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 1.0f, 1.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadVertexBufferPtr->position = transform * s_rendererData->quadVertexPositions[3];
-		s_rendererData->quadVertexBufferPtr->color = color;
-		s_rendererData->quadVertexBufferPtr->texCoords = { 0.0f, 1.0f };
-		s_rendererData->quadVertexBufferPtr->texIndex = texIndex;
-		s_rendererData->quadVertexBufferPtr->tilingFactor = tilingFactor;
-		s_rendererData->quadVertexBufferPtr++;
-
-		s_rendererData->quadIndexCount += 6;
+	void Renderer2D::recordQuad(const glm::vec3& position, const glm::vec2& size, float angle, const glm::vec4& color, uint32_t texIndex, float tilingFactor)
+	{
+		Renderer2DData::QuadRecords& quads = s_rendererData->recordedQuads;
+		quads.positions.push_back(position);
+		quads.sizes.push_back(size);
+		quads.angles.push_back(angle);
+		quads.colors.push_back(color);
+		quads.texIndices.push_back(texIndex);
+		quads.tilingFactors.push_back(tilingFactor);
+
+		s_rendererData->sortKeys.push_back(makeSortKey(s_rendererData->layer, color.a < 1.0f, position.z, texIndex));
 	}
 
-	uint32_t Renderer2D::retrieveTexIndex(const Ref<Texture2D>& texture)
+	void Renderer2D::buildQuads()
 	{
-		uint32_t textureIndex = 0;
+		const Renderer2DData::QuadRecords& recorded = s_rendererData->recordedQuads;
+		const uint32_t count = recorded.size();
+		if (!count)
+			return;
+
+		std::vector<uint64_t>& keys = s_rendererData->sortKeys;
+		std::vector<uint32_t>& order = s_rendererData->sortOrder;
+		order.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+			order[i] = i;
+
+		radixSort(keys, order, s_rendererData->keyScratch, s_rendererData->orderScratch);
+
+		// the kernel reads the quads in draw order
+		Renderer2DData::QuadRecords& sorted = s_rendererData->sortedQuads;
+		sorted.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			const uint32_t quad = order[i];
+			sorted.positions[i] = recorded.positions[quad];
+			sorted.sizes[i] = recorded.sizes[quad];
+			sorted.angles[i] = recorded.angles[quad];
+			sorted.colors[i] = recorded.colors[quad];
+			sorted.texIndices[i] = recorded.texIndices[quad];
+			sorted.tilingFactors[i] = recorded.tilingFactors[quad];
+		}
 
-		for (uint32_t i = 1; i < s_rendererData->textureSlotIndex; i++)
+		RotatedQuads quads;
+		for (uint32_t first = 0; first < count; first += quads.count)
 		{
-			if (*s_rendererData->textureSlots[i].get() == *texture.get())
+			// a batch is drawn with one pipeline
+			const uint8_t pipeline = static_cast<uint8_t>(keys[first] & s_pipelineKeyMask);
+			if (pipeline != s_rendererData->batchPipeline)
 			{
-				textureIndex = i;
-				break;
+				drawBatch();
+				s_rendererData->batchPipeline = pipeline;
 			}
-		}
 
-		if (textureIndex == 0)
-		{
-			textureIndex = s_rendererData->textureSlotIndex;
-			s_rendererData->textureSlots[textureIndex] = texture;
-			s_rendererData->textureSlotIndex++;
+			if (s_rendererData->quadVertexBufferPtr == s_rendererData->quadVertexBufferEnd)
+				nextChunk();
+
+			// as many quads of the pipeline as the chunk has room for per call of the kernel
+			const uint32_t room = static_cast<uint32_t>(s_rendererData->quadVertexBufferEnd - s_rendererData->quadVertexBufferPtr) / 4;
+			uint32_t last = first + 1;
+			while (last < count && last - first < room && (keys[last] & s_pipelineKeyMask) == pipeline)
+				last++;
+
+			quads.count = last - first;
+			quads.pPositions = sorted.positions.data() + first;
+			quads.pSizes = sorted.sizes.data() + first;
+			quads.pAngles = sorted.angles.data() + first;
+			quads.pColors = sorted.colors.data() + first;
+			quads.pTexIndices = sorted.texIndices.data() + first;
+			quads.pTilingFactors = sorted.tilingFactors.data() + first;
+
+			QuadBuilder::build(quads, s_rendererData->quadVertexBufferPtr);
+			s_rendererData->quadVertexBufferPtr += quads.count * 4;
+			s_rendererData->quadIndexCount += quads.count * 6;
 		}
 
-		return textureIndex;
+		s_rendererData->recordedQuads.resize(0);
+		keys.clear();
+	}
+
+	uint32_t Renderer2D::retrieveTexIndex(const Ref<Texture2D>& texture)
+	{
+		// the frame reads the texture through the heap, it has to wait for the upload itself
+		Renderer::useUpload(texture->getUploadTicket());
+		return texture->getHeapIndex();
 	}
 }
\ No newline at end of file
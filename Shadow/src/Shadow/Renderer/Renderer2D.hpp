@@ -22,8 +22,13 @@ namespace Shadow
 
 		static void beginScene(const OrthoCamera& camera);
 		static void endScene();
+		// sorts the quads drawn since the last flush and closes the batch. endScene() does it as well
 		static void flush();
 
+		// the quads drawn after this are sorted by layer before anything else, lower layers are drawn first. the depth test still
+		// decides what covers what, the layer orders the draws (blending of translucent quads). beginScene() starts at layer 0
+		static void setLayer(uint8_t layer);
+
 		// primitives
 		static void drawQuad(const QuadProperties& properties);
 		static void drawQuad(const glm::vec2& position, const glm::vec2& size, const glm::vec4& color);    
@@ -40,6 +45,9 @@ namespace Shadow
 		static void drawRotatedQuad(const glm::vec3& position, const glm::vec2& size, float angle, const Ref<Texture2D>& texture, float tilingFactor = 1.0f);
 		static void drawRotatedQuad(const glm::vec2& position, const glm::vec2& size, float angle, const glm::vec4& color, const Ref<Texture2D>& texture, float tilingFactor = 1.0f);
 		static void drawRotatedQuad(const glm::vec3& position, const glm::vec2& size, float angle, const glm::vec4& color, const Ref<Texture2D>& texture, float tilingFactor = 1.0f);
+		// many quads with one texture (or none). pColors may be nullptr (white quads)
+		static void drawRotatedQuads(uint32_t count, const glm::vec3* pPositions, const glm::vec2* pSizes, const float* pAngles,
+			const glm::vec4* pColors = nullptr, const Ref<Texture2D>& texture = nullptr, float tilingFactor = 1.0f);
 
 		// stats
 		struct Statistics
@@ -53,8 +61,13 @@ namespace Shadow
 		static void resetStats();
 		static const Statistics& getStats();
 	private:
+		static void beginBatch();
+		static void drawBatch();
+		static void nextChunk();
+
 		static uint32_t retrieveTexIndex(const Ref<Texture2D>& texture);
-		static void setVerticesData(const glm::vec3& position, const glm::vec2& size, const glm::vec4& color, uint32_t texIndex, float tilingFactor);
-		static void setVerticesData(const glm::mat4& transform, const glm::vec4& color, uint32_t texIndex, float tilingFactor);
+		// quads are recorded by their center and get their vertices when they have been sorted, quads with color.a < 1 are translucent
+		static void recordQuad(const glm::vec3& position, const glm::vec2& size, float angle, const glm::vec4& color, uint32_t texIndex, float tilingFactor);
+		static void buildQuads();
 	};
 }
\ No newline at end of file
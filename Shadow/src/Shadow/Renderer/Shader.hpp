@@ -7,7 +7,6 @@
 
 namespace Shadow
 {
-	class Mesh;
 	class UniformBuffer;
 	class StorageBuffer;
 	class Texture2D;
@@ -57,7 +56,6 @@ namespace Shadow
 		virtual void writeDescriptorSet(const std::string& name, const Texture2D& texture) = 0;
 		virtual void writeDescriptorSet(const std::string& name, const Ref<Texture2D>& texture) = 0;
 		virtual void writeDescriptorSet(const std::string& name, uint32_t count, const Ref<Texture2D>* pTextures, uint32_t dstArrIndex = 0) = 0;
-		virtual void writeDescriptorSet(const std::string& name, const Mesh& mesh) = 0;
 
 		virtual bool isComputeShader() const = 0;
 
@@ -3,10 +3,38 @@
 #include"Shadow/Renderer/Renderer.hpp"
 #include"Shadow/Vulkan/VkTexture.hpp"
 
+#include <mutex>
+
 namespace Shadow
 {
 	SH_FLAG_DEF(AttachmentUsage, uint8_t);
 
+	// textures are created on any thread
+	static std::mutex s_idMutex;
+	static std::vector<uint32_t> s_freeIDs;
+	static uint32_t s_nextID = 0;
+
+	Texture2D::Texture2D()
+	{
+		std::scoped_lock<std::mutex> lock(s_idMutex);
+
+		if (s_freeIDs.empty())
+		{
+			m_id = s_nextID++;
+		}
+		else
+		{
+			m_id = s_freeIDs.back();
+			s_freeIDs.pop_back();
+		}
+	}
+
+	Texture2D::~Texture2D()
+	{
+		std::scoped_lock<std::mutex> lock(s_idMutex);
+		s_freeIDs.push_back(m_id);
+	}
+
 	Ref<Texture2D> Texture2D::create(uint32_t width, uint32_t height, const Sampler& sampler)
 	{
 		switch (Renderer::getRendererType())
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Shadow/Core/Core.hpp"
+#include "Shadow/Renderer/Buffer.hpp"
 
 namespace Shadow
 {
@@ -56,18 +57,34 @@ namespace Shadow
 	class Texture2D
 	{
 	public:
-		virtual ~Texture2D() = default;
+		Texture2D();
+		virtual ~Texture2D();
+		Texture2D(const Texture2D& other) = delete;
+		Texture2D& operator=(const Texture2D& other) = delete;
 
 		virtual void setData(void* data) = 0;
 		virtual void resize(uint32_t newWidth, uint32_t newHeight) = 0;
 
 		virtual uint8_t getMipLevelCount() const = 0;
 		virtual const std::string& getPath() const = 0;
+		virtual UploadTicket getUploadTicket() const = 0;
+		// index of the texture in the bindless texture heap, shaders sample it as u_textures[index]. resize() and the gpu memory
+		// defragmentation hand out a new one, read it when recording. textures that can't be sampled (depth/color-only attachments)
+		// don't have one
+		virtual uint32_t getHeapIndex() const = 0;
+		// for callers that bake the heap index into gpu data: the texture isn't moved by the defragmentation from now on
+		virtual void pinHeapIndex() = 0;
 
 		static Ref<Texture2D> create(uint32_t width, uint32_t height, const Sampler& sampler = Sampler());
 		static Ref<Texture2D> create(const std::string& imagePath, const Sampler& sampler = Sampler());
 		static Ref<Texture2D> create(uint8_t* pixels, uint32_t length, const Sampler& sampler = Sampler());
 
 		virtual bool operator==(const Texture2D& other) const = 0;
+
+		// small integer that is unique among the living textures, the ids of destroyed textures are handed out again.
+		// it can index tables directly
+		inline uint32_t getID() const { return m_id; }
+	private:
+		uint32_t m_id;
 	};
 }
\ No newline at end of file
@@ -52,8 +52,7 @@ namespace Shadow
 
 	DescriptorSetAllocator::~DescriptorSetAllocator()
 	{
-		vkDeviceWaitIdle(VulkanContext::getVulkanDevice()->getVkDevice());
-		vkDestroyDescriptorPool(VulkanContext::getVulkanDevice()->getVkDevice(), m_descriptorPool, nullptr);
+		VulkanContext::getVulkanDevice()->retireDescriptorPool(m_descriptorPool);
 	}
 
 	void DescriptorSetAllocator::allocateDescriptorSets(std::array<VkDescriptorSet, 4>& sets, const std::array<VkDescriptorSetLayout, 4>& layouts)
@@ -4,9 +4,11 @@
 #include "Shadow/Vulkan/Swapchain.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
 #include "Shadow/Vulkan/VulkanImage.hpp"
+#include "Shadow/Core/ShEngine.hpp"
 		 
 #include <GLFW/glfw3.h>
 #include <minmax.h>
+#include <thread>
 
 namespace Shadow
 {
@@ -19,8 +21,21 @@ namespace Shadow
 		EventDispatcher::get().addReciever(SH_CALLBACK(Swapchain::recreateSwapchain));
 	}
 
+	Swapchain::Swapchain(VkExtent2D extent)
+		: m_WindowHandle(nullptr), m_imageCount(s_headlessImageCount), m_imageFormat(VK_FORMAT_R8G8B8A8_UNORM), m_extent(extent)
+	{
+		m_surfaceFormat = { m_imageFormat, VK_COLORSPACE_SRGB_NONLINEAR_KHR };
+
+		createOffscreenImages();
+		SH_TRACE("created a headless swapchain (%u offscreen images) <3", m_imageCount);
+	}
+
 	Swapchain::~Swapchain()
 	{
+		// offscreen images and their views are released by m_offscreenImages
+		if (isHeadless())
+			return;
+
 		vkDestroySwapchainKHR(VulkanContext::getVulkanDevice()->getVkDevice(), m_swapchain, nullptr);
 
 		for (size_t i = 0; i < m_imageViews.size(); i++)
@@ -31,6 +46,12 @@ namespace Shadow
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
 
+		if (isHeadless())
+		{
+			m_imageIndex = (m_imageIndex + 1) % m_imageCount;
+			return;
+		}
+
 		vkAcquireNextImageKHR(VulkanContext::getVulkanDevice()->getVkDevice(), m_swapchain,
 			UINT64_MAX, toSignalSemaphore, VK_NULL_HANDLE, &m_imageIndex);
 	}
@@ -84,6 +105,21 @@ namespace Shadow
 			m_imageViews[i] = VulkanContext::getVulkanDevice()->createImageView(m_images[i], m_imageFormat, VK_IMAGE_ASPECT_COLOR_BIT, 1);
 	}
 
+	void Swapchain::createOffscreenImages()
+	{
+		VulkanDevice* device = VulkanContext::getVulkanDevice();
+
+		// transfer src lets benchmarks read the frames back
+		for (uint32_t i = 0; i < m_imageCount; i++)
+		{
+			device->allocateImage(m_extent.width, m_extent.height, m_imageFormat, VK_IMAGE_TILING_OPTIMAL,
+				VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, 1, m_offscreenImages[i]);
+
+			m_images[i] = m_offscreenImages[i].vkImage;
+			m_imageViews[i] = m_offscreenImages[i].imageView;
+		}
+	}
+
 	Swapchain::SurfaceDetails Swapchain::querySurfaceSupport(VkPhysicalDevice device, VkSurfaceKHR surface)
 	{
 		SurfaceDetails details;
@@ -131,7 +167,7 @@ namespace Shadow
 	VkExtent2D Swapchain::chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities)
 	{
 		int width = 0, height = 0;
-		glfwGetFramebufferSize(m_WindowHandle, &width, &height);
+		getFramebufferSize(width, height);
 
 		VkExtent2D extent = { static_cast<uint32_t>(width), static_cast<uint32_t>(height) };
 		extent.width = std::clamp(static_cast<uint32_t>(width), capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
@@ -142,15 +178,25 @@ namespace Shadow
 
 	bool Swapchain::recreateSwapchain(const WindowResizedEvent& event)
 	{
+		// the offscreen ring has a fixed size
+		if (isHeadless())
+			return false;
+
 		int width = 0, height = 0;
-		glfwGetFramebufferSize(m_WindowHandle, &width, &height);
+		getFramebufferSize(width, height);
 
 		// in case of window minimization
+		const bool inputThread = ShEngine::get().getWindow().hasInputThread();
 		while (width == 0 || height == 0)
 		{
 			SH_TRACE("Win minimazed");
-			glfwGetFramebufferSize(m_WindowHandle, &width, &height);
-			glfwWaitEvents();
+			getFramebufferSize(width, height);
+
+			// the input thread owns the GLFW event loop
+			if (inputThread)
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			else
+				glfwWaitEvents();
 		}
 
 		VulkanDevice* pVkDevice = VulkanContext::getVulkanDevice();
@@ -164,4 +210,15 @@ namespace Shadow
 
 		return false;
 	}
+
+	void Swapchain::getFramebufferSize(int& outWidth, int& outHeight) const
+	{
+		// the user pointer is set before the swapchain is created, ShEngine doesn't own the window yet at that point
+		const Window* window = static_cast<const Window*>(glfwGetWindowUserPointer(m_WindowHandle));
+
+		uint32_t width = 0, height = 0;
+		window->getFramebufferSize(width, height);
+		outWidth = static_cast<int>(width);
+		outHeight = static_cast<int>(height);
+	}
 }
\ No newline at end of file
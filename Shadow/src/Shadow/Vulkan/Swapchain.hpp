@@ -1,6 +1,7 @@
 #pragma once
 
 #include"Shadow/Events/EventDispatcher.hpp"
+#include"Shadow/Vulkan/VulkanImage.hpp"
 
 #include<vulkan/vulkan.h>
 #include<future>
@@ -14,8 +15,11 @@ namespace Shadow
 	{
 	public:
 		Swapchain(GLFWwindow* windowHandle, VkSurfaceKHR surface);
+		// headless stand-in: a fixed ring of offscreen color images, acquisition and presentation only rotate the ring
+		Swapchain(VkExtent2D extent);
 		~Swapchain();
 
+		// toSignalSemaphore isn't signaled by a headless swapchain, the image is available as soon as its frame fence has been waited on
 		void acquireNextImage(VkSemaphore toSignalSemaphore);
 
 		inline const VkExtent2D getExtent() const { return m_extent; }
@@ -27,20 +31,24 @@ namespace Shadow
 		inline const VkSwapchainKHR getVkSwapchain() const { return m_swapchain; }
 		inline const VkImageView getCurrentImageView() const { return m_imageViews[m_imageIndex]; }
 		inline const VkImage getCurrentImage() const { return m_images[m_imageIndex]; }
+		inline bool isHeadless() const { return m_swapchain == VK_NULL_HANDLE; }
 	private:
+		static constexpr uint32_t s_headlessImageCount = 3;
+
 		GLFWwindow* m_WindowHandle;
 
 		uint32_t m_imageIndex = 0;
 		uint32_t m_imageCount;
 
-		VkSwapchainKHR m_swapchain;
-		VkSurfaceKHR m_surface;
+		VkSwapchainKHR m_swapchain = VK_NULL_HANDLE;
+		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
 		VkSurfaceFormatKHR m_surfaceFormat;
 		VkFormat m_imageFormat;
 		VkExtent2D m_extent;
 
 		std::array<VkImage, 3> m_images;
 		std::array<VkImageView, 3> m_imageViews;
+		std::array<VulkanImage, s_headlessImageCount> m_offscreenImages; // owns m_images/m_imageViews when headless
 
 		struct SurfaceDetails
 		{
@@ -51,11 +59,14 @@ namespace Shadow
 	private:
 		void createSwapchain();
 		void createImageViews();
+		void createOffscreenImages();
 
 		SurfaceDetails querySurfaceSupport(VkPhysicalDevice device, VkSurfaceKHR surface);
 		VkSurfaceFormatKHR chooseSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats);
 		VkPresentModeKHR choosePresentMode(const std::vector<VkPresentModeKHR>& presentModes);
 		VkExtent2D chooseExtent(const VkSurfaceCapabilitiesKHR& capabilities);
+		// through the window, which caches the size when GLFW can't be queried from this thread
+		void getFramebufferSize(int& outWidth, int& outHeight) const;
 
 		bool recreateSwapchain(const WindowResizedEvent& event);
 	};
@@ -6,6 +6,8 @@
 #include "Shadow/Vulkan/VkTexture.hpp"
 #include "Shadow/Vulkan/VulkanBuffer.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
 		 
 #define  STB_IMAGE_IMPLEMENTATION
 #include <stb_image/stb_image.h>
@@ -35,6 +37,7 @@ namespace Shadow
 		}
 
 		createSampler(sampler);
+		addToTextureHeap();
 	}
 
 	VulkanTexture2D::VulkanTexture2D(const std::string& imagePath, const Sampler& sampler)
@@ -60,6 +63,8 @@ namespace Shadow
 
 		setData(pixels);
 		createSampler(sampler);
+		addToTextureHeap();
+		registerForDefragmentation();
 
 		stbi_image_free(pixels);
 	}
@@ -87,6 +92,8 @@ namespace Shadow
 
 		setData(pixels);
 		createSampler(sampler);
+		addToTextureHeap();
+		registerForDefragmentation();
 
 		stbi_image_free(pixels);
 	}
@@ -111,48 +118,44 @@ namespace Shadow
 		}
 
 		createSampler(sampler);
+		if (m_imageUsage & VK_IMAGE_USAGE_SAMPLED_BIT)
+			addToTextureHeap();
 	}
 
 	VulkanTexture2D::~VulkanTexture2D()
 	{
-		vkDeviceWaitIdle(VulkanContext::getVulkanDevice()->getVkDevice());
-		vkDestroySampler(VulkanContext::getVulkanDevice()->getVkDevice(), m_sampler, nullptr);
+		VulkanDevice* device = VulkanContext::getVulkanDevice();
+
+		// the image is retired after this, its copy may still be queued if it has never been used
+		device->getUploadManager().wait(m_uploadTicket);
+		device->getTextureHeap().remove(m_heapIndex);
+		device->retireSampler(m_sampler);
 	}
 
 	void VulkanTexture2D::setData(void* pixels)
 	{
-		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		VkDeviceSize imageSize = static_cast<VkDeviceSize>(m_width * m_height * 4);
-
-		VkBuffer stagingBuffer = VK_NULL_HANDLE;
-		VmaAllocation stagingBufferAllocation = VK_NULL_HANDLE;
-		device->allocateBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &stagingBuffer, &stagingBufferAllocation);
-
-		void* data;
-		vmaMapMemory(device->getVmaAllocator(), stagingBufferAllocation, &data);
-		memcpy(data, pixels, static_cast<size_t>(imageSize));
-		vmaUnmapMemory(device->getVmaAllocator(), stagingBufferAllocation);
-
-		{
-			std::scoped_lock<std::mutex> lock(s_imageMutex);
-
-			Ref<VulkanCmdBuffer> cmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
-			VkCommandBuffer vkCmdBuffer = cmdBuffer->beginSingleTimeCmdBuffer(device->getGraphicsQueueIndex());
+		VkDeviceSize imageSize = static_cast<VkDeviceSize>(m_width) * m_height * 4;
 
-			device->transitionImageLayout(vkCmdBuffer, m_image.vkImage, VK_FORMAT_R8G8B8A8_SRGB,
-				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
-				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-				0, VK_ACCESS_TRANSFER_WRITE_BIT, m_mipLevels);
+		m_uploadTicket = VulkanContext::getVulkanDevice()->getUploadManager().uploadImage(m_image.vkImage, m_format, pixels, imageSize,
+			m_width, m_height, m_mipLevels);
+	}
 
-			device->copyBufferToImage(vkCmdBuffer, stagingBuffer, m_image.vkImage, m_width, m_height);
+	void VulkanTexture2D::registerForDefragmentation()
+	{
+		// only the textures with fixed contents, render targets stay where they are. after addToTextureHeap(), a move replaces the heap index
+		VulkanContext::getVulkanDevice()->getDefragmenter().registerImage(&m_image, m_format, m_width, m_height, m_mipLevels,
+			m_imageUsage, &m_uploadTicket, &m_heapIndex, m_sampler);
+	}
 
-			// transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
-			device->generateMipmaps(vkCmdBuffer, m_image.vkImage, VK_FORMAT_R8G8B8A8_SRGB, m_width, m_height, m_mipLevels);
-			cmdBuffer->submitSingleTimeCmdBuffer(vkCmdBuffer, device->getGraphicsQueueIndex());
-		}
+	void VulkanTexture2D::addToTextureHeap()
+	{
+		m_heapIndex = VulkanContext::getVulkanDevice()->getTextureHeap().add(m_image.imageView, m_sampler);
+	}
 
-		vkQueueWaitIdle(device->getGraphicsQueue());
-		vmaDestroyBuffer(device->getVmaAllocator(), stagingBuffer, stagingBufferAllocation);
+	void VulkanTexture2D::pinHeapIndex()
+	{
+		// the defragmenter would hand out a new index when it moves the image
+		VulkanContext::getVulkanDevice()->getDefragmenter().unregister(m_image.allocation);
 	}
 
 	void VulkanTexture2D::resize(uint32_t newWidth, uint32_t newHeight)
@@ -162,6 +165,10 @@ namespace Shadow
 
 		m_image.deallocate();
 		VulkanContext::getVulkanDevice()->allocateImage(newWidth, newHeight, m_format, VK_IMAGE_TILING_OPTIMAL, m_imageUsage, m_mipLevels, m_image);
+
+		// the frames in flight still sample the old slot, the ones recorded from now on pick up the new index
+		if (m_heapIndex != VulkanTextureHeap::s_invalidIndex)
+			m_heapIndex = VulkanContext::getVulkanDevice()->getTextureHeap().replace(m_heapIndex, m_image.imageView, m_sampler);
 	}
 
 	void VulkanTexture2D::createSampler(const Sampler& sampler)
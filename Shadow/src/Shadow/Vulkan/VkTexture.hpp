@@ -3,6 +3,7 @@
 #include "Shadow/Renderer/Texture.hpp"
 #include "Shadow/Vulkan/VulkanDevice.hpp"
 #include "Shadow/Vulkan/VulkanImage.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
 		 
 #include <vulkan/vulkan.h>
 #include <string>
@@ -20,9 +21,12 @@ namespace Shadow
 
 		virtual void setData(void* data) override;
 		virtual void resize(uint32_t newWidth, uint32_t newHeight) override;
+		virtual void pinHeapIndex() override;
 
 		inline virtual uint8_t getMipLevelCount() const override { return m_mipLevels; }
 		inline virtual const std::string& getPath() const override { return m_path; }
+		inline virtual UploadTicket getUploadTicket() const override { return m_uploadTicket; }
+		inline virtual uint32_t getHeapIndex() const override { return m_heapIndex; }
 
 		inline const VulkanImage& getImage() const { return m_image; }
 		inline const VkSampler getSampler() const { return m_sampler; }
@@ -33,6 +37,8 @@ namespace Shadow
 		}
 	private:
 		void createSampler(const Sampler& sampler);
+		void registerForDefragmentation();
+		void addToTextureHeap();
 	private:
 		VulkanImage m_image;
 		VkSampler m_sampler;
@@ -42,5 +48,8 @@ namespace Shadow
 		std::string m_path;
 		uint32_t m_width, m_height;
 		uint8_t m_mipLevels;
+
+		UploadTicket m_uploadTicket = 0;
+		uint32_t m_heapIndex = VulkanTextureHeap::s_invalidIndex;
 	};
 }
\ No newline at end of file
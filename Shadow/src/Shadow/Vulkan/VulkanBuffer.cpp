@@ -4,6 +4,8 @@
 #include "Shadow/Vulkan/VulkanBuffer.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
 
 namespace Shadow
 {
@@ -11,222 +13,302 @@ namespace Shadow
 		: RenderBuffer(usage, size, size / stride)
 	{
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = size;
 		VkBufferUsageFlags bufferUsage = static_cast<VkBufferUsageFlags>(usage) | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-		VkBuffer stagingBuffer = VK_NULL_HANDLE;
-		VmaAllocation stagingBufferAllocation = VK_NULL_HANDLE;
-
-		device->allocateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &stagingBuffer, &stagingBufferAllocation);
-		device->allocateBuffer(bufferSize, bufferUsage, VMA_MEMORY_USAGE_GPU_ONLY, &m_buffer, &m_allocation);
-
-		void* mappedData;
-		vmaMapMemory(device->getVmaAllocator(), stagingBufferAllocation, &mappedData);
-		memcpy(mappedData, data, size);
-		vmaUnmapMemory(device->getVmaAllocator(), stagingBufferAllocation);
-
-		Ref<VulkanCmdBuffer> cmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
-		VkCommandBuffer vkCmdBuffer = cmdBuffer->beginSingleTimeCmdBuffer(device->getTransferQueueIndex());
-		device->copyBufferToBuffer(vkCmdBuffer, stagingBuffer, m_buffer, bufferSize, 0, 0);
-		cmdBuffer->submitSingleTimeCmdBuffer(vkCmdBuffer, device->getTransferQueueIndex());
-
-		vkQueueWaitIdle(device->getTransferQueue());
-		vmaDestroyBuffer(device->getVmaAllocator(), stagingBuffer, stagingBufferAllocation);
+		device->allocateBuffer(size, bufferUsage, VMA_MEMORY_USAGE_GPU_ONLY, &m_buffer, &m_allocation);
+		m_uploadTicket = device->getUploadManager().uploadBuffer(m_buffer, data, size);
 	}
 
 	VulkanRenderBuffer::~VulkanRenderBuffer()
 	{
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		vkQueueWaitIdle(device->getTransferQueue());
-		vmaDestroyBuffer(device->getVmaAllocator(), m_buffer, m_allocation);
+
+		// the copy may still be queued if the buffer has never been used
+		device->getUploadManager().wait(m_uploadTicket);
+		device->retireBuffer(m_buffer, m_allocation);
 	}
 
 	VulkanVertexBuffer::VulkanVertexBuffer(uint32_t size, uint32_t stride)
-		: m_vertexCount(size/stride)
+		: m_size(size), m_vertexCount(size/stride), m_policy(BufferPolicy::Streaming)
+	{
+		SH_ASSERT((size <= as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer().getRegionSize()),
+			"a streaming vertex buffer (%u bytes) has to fit into one region of the frame ring buffer :<", size);
+	}
+
+	VulkanVertexBuffer::VulkanVertexBuffer(void* vertices, uint32_t size, uint32_t stride)
+		: m_size(size), m_vertexCount(size/stride), m_policy(BufferPolicy::Static)
 	{
 		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = size;
 
-		VkBufferCreateInfo stagingBufferCI{};
-		stagingBufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		stagingBufferCI.size = bufferSize;
-		stagingBufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		// transfer src -> the defragmenter can move it
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		vulkanDevice->allocateBuffer(size, usage, VMA_MEMORY_USAGE_GPU_ONLY, &m_buffer, &m_allocation);
+		m_uploadTicket = vulkanDevice->getUploadManager().uploadBuffer(m_buffer, vertices, size);
+		vulkanDevice->getDefragmenter().registerBuffer(m_allocation, &m_buffer, size, usage, &m_uploadTicket);
+	}
 
-		VmaAllocationCreateInfo stagingAllocCI{};
-		stagingAllocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-		stagingAllocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-		VK_CHECK_RESULT(vmaCreateBuffer(vulkanDevice->getVmaAllocator(), &stagingBufferCI, &stagingAllocCI,
-			&m_stagingBuffer.buffer, &m_stagingBuffer.allocation, &m_stagingBuffer.allocInfo));
+	VulkanVertexBuffer::~VulkanVertexBuffer()
+	{
+		if (m_policy == BufferPolicy::Streaming)
+			return;
 
-		VkBufferCreateInfo bufferCI{};
-		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		bufferCI.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-		bufferCI.size = bufferSize;
-		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
 
-		VmaAllocationCreateInfo allocCI{};
-		allocCI.usage = VMA_MEMORY_USAGE_GPU_ONLY;
-		VK_CHECK_RESULT(vmaCreateBuffer(vulkanDevice->getVmaAllocator(), &bufferCI, &allocCI,
-			&m_vertexBuffer.buffer, &m_vertexBuffer.allocation, VK_NULL_HANDLE));
+		vulkanDevice->getUploadManager().wait(m_uploadTicket);
+		vulkanDevice->retireBuffer(m_buffer, m_allocation);
 	}
 
-	VulkanVertexBuffer::VulkanVertexBuffer(void* vertices, uint32_t size, uint32_t stride)
-		: m_vertexCount(size/stride)
+	void VulkanVertexBuffer::setData(const void* data, uint32_t size, uint32_t offset)
 	{
-		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = size;
+		SH_ASSERT((offset + size <= m_size), "vertex buffer overflow :<");
+
+		// there is no staging copy any more, an upload would overwrite the buffer while frames in flight still read it
+		SH_ASSERT((m_policy == BufferPolicy::Streaming), "static vertex buffers are immutable, create a streaming one to update it :<");
+		if (m_policy == BufferPolicy::Static)
+			return;
+
+		VulkanRingBuffer& ring = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer();
+
+		VulkanRingBuffer::Allocation slice;
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
 
-		VkBufferCreateInfo stagingBufferCI{};
-		stagingBufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-		stagingBufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-		stagingBufferCI.size = bufferSize;
-		stagingBufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			// one slice per ring frame, the following writes of the frame go into the same slice
+			if (m_recordedSlice.pData && m_recordedSlice.frame == ring.getFrame())
+			{
+				memcpy(static_cast<uint8_t*>(m_recordedSlice.pData) + offset, data, size);
+				return;
+			}
 
-		VmaAllocationCreateInfo stagingAllocCI{};
-		stagingAllocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-		stagingAllocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-		VK_CHECK_RESULT(vmaCreateBuffer(vulkanDevice->getVmaAllocator(), &stagingBufferCI, &stagingAllocCI,
-			&m_stagingBuffer.buffer, &m_stagingBuffer.allocation, &m_stagingBuffer.allocInfo));
+			slice = ring.allocate(m_size, BufferUsage::VertexBuffer);
+			if (!slice.pData)
+				return;
 
-		memcpy(m_stagingBuffer.allocInfo.pMappedData, vertices, size);
+			memcpy(static_cast<uint8_t*>(slice.pData) + offset, data, size);
+			m_recordedSlice = slice;
+		}
 
-		vulkanDevice->allocateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &m_vertexBuffer.buffer, &m_vertexBuffer.allocation);
+		// the commands recorded after this call bind the new slice
+		Renderer::submit([this, slice]()
+			{
+				std::scoped_lock<std::mutex> lock(m_mutex);
+				m_drawSlice = slice;
+			});
+	}
 
-		Ref<VulkanCmdBuffer> cmdBuffer = Renderer::getCmdBuffer();
-		VkCommandBuffer vkCmdBuffer = cmdBuffer->beginSingleTimeCmdBuffer(vulkanDevice->getTransferQueueIndex());
-		vulkanDevice->copyBufferToBuffer(vkCmdBuffer, m_stagingBuffer.buffer, m_vertexBuffer.buffer, bufferSize, 0, 0);
-		cmdBuffer->submitSingleTimeCmdBuffer(vkCmdBuffer, vulkanDevice->getTransferQueueIndex());
+	VkBuffer VulkanVertexBuffer::getVkBuffer() const
+	{
+		return m_policy == BufferPolicy::Static ? m_buffer : as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer().getVkBuffer();
 	}
 
-	VulkanVertexBuffer::~VulkanVertexBuffer()
+	VkDeviceSize VulkanVertexBuffer::getOffset()
 	{
-		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
+		if (m_policy == BufferPolicy::Static)
+			return 0;
 
-		vkQueueWaitIdle(vulkanDevice->getTransferQueue());
-		vmaDestroyBuffer(vulkanDevice->getVmaAllocator(), m_vertexBuffer.buffer, m_vertexBuffer.allocation);
+		VulkanRingBuffer& ring = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer();
+		std::scoped_lock<std::mutex> lock(m_mutex);
 
-		if (m_stagingBuffer.buffer != VK_NULL_HANDLE)
-			vmaDestroyBuffer(vulkanDevice->getVmaAllocator(), m_stagingBuffer.buffer, m_stagingBuffer.allocation);
+		SH_ASSERT((m_drawSlice.pData && ring.getFrame() - m_drawSlice.frame <= 1),
+			"streaming vertex buffer drawn without setData() in the frame, its old contents are gone :<");
+		return m_drawSlice.offset;
 	}
 
-	// TODO: offsets
-	void VulkanVertexBuffer::setData(const void* data, uint32_t size, uint32_t offset)
+	VulkanVertexArena::VulkanVertexArena(uint32_t stride, uint32_t blockVertexCount)
+		: VertexArena(stride), m_blockVertexCount(blockVertexCount)
 	{
-		memcpy(m_stagingBuffer.allocInfo.pMappedData, data, size);
+	}
 
-		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = offset;
-		copyRegion.dstOffset = offset;
-		copyRegion.size = size;
-		vkCmdCopyBuffer(as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getTransferCmdBuffer(), m_stagingBuffer.buffer, m_vertexBuffer.buffer, 1, &copyRegion);
+	VulkanVertexArena::~VulkanVertexArena()
+	{
+		for (Region& region : m_regions)
+			retireBlocks(region);
 	}
 
-	VulkanIndexBuffer::VulkanIndexBuffer(uint32_t* indices, uint32_t count)
-		: IndexBuffer(count)
+	ArenaSlice VulkanVertexArena::allocate(uint32_t vertexCount)
 	{
-		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = sizeof(uint32_t) * count;
+		const uint64_t frame = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer().getFrame();
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		Region& region = m_regions[frame % m_regions.size()];
 
-		VkBuffer stagingBuffer = VK_NULL_HANDLE;
-		VmaAllocation stagingBufferAllocation = VK_NULL_HANDLE;
+		// the gpu is done with the region's previous frame, a frame that needed several blocks gets them merged into one
+		if (region.frame != frame)
+		{
+			if (region.blocks.size() > 1)
+			{
+				uint32_t merged = 0;
+				for (const Block& block : region.blocks)
+					merged += block.vertexCount;
+
+				retireBlocks(region);
+				addBlock(region, merged);
+			}
+
+			region.head = 0;
+			region.frame = frame;
+		}
 
-		vulkanDevice->allocateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &stagingBuffer, &stagingBufferAllocation);
-		vulkanDevice->allocateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &m_buffer, &m_allocation);
+		if (region.blocks.empty() || region.head + vertexCount > region.blocks.back().vertexCount)
+		{
+			uint32_t blockVertexCount = m_blockVertexCount;
+			for (const Block& block : region.blocks)
+				blockVertexCount = std::max(blockVertexCount, block.vertexCount * 2);
 
-		void* data;
-		vmaMapMemory(VulkanContext::getVulkanDevice()->getVmaAllocator(), stagingBufferAllocation, &data);
-		memcpy(data, indices, (size_t)bufferSize);
-		vmaUnmapMemory(vulkanDevice->getVmaAllocator(), stagingBufferAllocation);
+			addBlock(region, std::max(blockVertexCount, vertexCount));
+			region.head = 0;
+		}
 
-		Ref<VulkanCmdBuffer> cmdBuffer = Renderer::getCmdBuffer();
-		VkCommandBuffer vkCmdBuffer = cmdBuffer->beginSingleTimeCmdBuffer(vulkanDevice->getTransferQueueIndex());
-		vulkanDevice->copyBufferToBuffer(vkCmdBuffer, stagingBuffer, m_buffer, bufferSize, 0, 0);
-		cmdBuffer->submitSingleTimeCmdBuffer(vkCmdBuffer, vulkanDevice->getTransferQueueIndex());
+		const Block& block = region.blocks.back();
 
-		vkQueueWaitIdle(vulkanDevice->getTransferQueue());
-		vmaDestroyBuffer(vulkanDevice->getVmaAllocator(), stagingBuffer, stagingBufferAllocation);
+		ArenaSlice slice;
+		slice.pData = block.pData + static_cast<size_t>(region.head) * getStride();
+		slice.block = static_cast<uint32_t>(region.blocks.size() - 1);
+		slice.firstVertex = region.head;
+		slice.vertexCount = vertexCount;
+		slice.frame = frame;
+
+		region.head += vertexCount;
+		return slice;
 	}
 
-	VulkanIndexBuffer::~VulkanIndexBuffer()
+	VkBuffer VulkanVertexArena::getVkBuffer(const ArenaSlice& slice)
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		const Region& region = m_regions[slice.frame % m_regions.size()];
+
+		SH_ASSERT((region.frame == slice.frame), "arena slice drawn after its memory has been recycled :<");
+		return region.blocks[slice.block].buffer;
+	}
+
+	void VulkanVertexArena::addBlock(Region& region, uint32_t vertexCount)
 	{
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		vkQueueWaitIdle(device->getGraphicsQueue());
-		vmaDestroyBuffer(device->getVmaAllocator(), m_buffer, m_allocation);
+
+		VkBufferCreateInfo bufferCI{};
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.size = static_cast<VkDeviceSize>(vertexCount) * getStride();
+		bufferCI.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		// coherent like the ring, but the blocks can get too big for a BAR heap so plain host visible memory is fine
+		VmaAllocationCreateInfo allocCI{};
+		allocCI.usage = VMA_MEMORY_USAGE_UNKNOWN;
+		allocCI.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		Block& block = region.blocks.emplace_back();
+		block.vertexCount = vertexCount;
+
+		VmaAllocationInfo allocInfo;
+		VK_CHECK_RESULT(vmaCreateBuffer(device->getVmaAllocator(), &bufferCI, &allocCI, &block.buffer, &block.allocation, &allocInfo));
+		device->trackAllocation(block.allocation, GpuMemoryCategory::Transient);
+		block.pData = static_cast<uint8_t*>(allocInfo.pMappedData);
 	}
 
-	VulkanUniformBuffer::VulkanUniformBuffer(uint32_t size)
-		: UniformBuffer(size)
+	void VulkanVertexArena::retireBlocks(Region& region)
+	{
+		VulkanDevice* device = VulkanContext::getVulkanDevice();
+
+		for (const Block& block : region.blocks)
+			device->retireBuffer(block.buffer, block.allocation);
+		region.blocks.clear();
+	}
+
+	VulkanIndexBuffer::VulkanIndexBuffer(uint32_t* indices, uint32_t count)
+		: IndexBuffer(count)
 	{
 		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = size;
+		VkDeviceSize bufferSize = sizeof(uint32_t) * count;
 
-		for (size_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
-		{
-			VkBufferCreateInfo bufferCI{};
-			bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-			bufferCI.size = size;
-			bufferCI.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-			bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-			VmaAllocationCreateInfo allocCI{};
-			allocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
-			allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
-			VK_CHECK_RESULT(vmaCreateBuffer(vulkanDevice->getVmaAllocator(), &bufferCI, &allocCI, &m_buffers[i], &m_allocations[i], &m_allocInfos[i]));
-		}
+		const VkBufferUsageFlags usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
+		vulkanDevice->allocateBuffer(bufferSize, usage, VMA_MEMORY_USAGE_GPU_ONLY, &m_buffer, &m_allocation);
+		m_uploadTicket = vulkanDevice->getUploadManager().uploadBuffer(m_buffer, indices, bufferSize);
+		vulkanDevice->getDefragmenter().registerBuffer(m_allocation, &m_buffer, bufferSize, usage, &m_uploadTicket);
 	}
 
-	VulkanUniformBuffer::~VulkanUniformBuffer()
+	VulkanIndexBuffer::~VulkanIndexBuffer()
 	{
-		VulkanDevice* device = VulkanContext::getVulkanDevice();
-		vkQueueWaitIdle(device->getGraphicsQueue());
+		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
 
-		for (size_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
-			vmaDestroyBuffer(device->getVmaAllocator(), m_buffers[i], m_allocations[i]);
+		vulkanDevice->getUploadManager().wait(m_uploadTicket);
+		vulkanDevice->retireBuffer(m_buffer, m_allocation);
+	}
+
+	VulkanUniformBuffer::VulkanUniformBuffer(uint32_t size)
+		: UniformBuffer(size), m_recorded(size, 0), m_executed(size, 0)
+	{
 	}
 
 	void VulkanUniformBuffer::setData(const void* data, uint32_t size, uint32_t offset)
 	{
-		for (uint32_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
-			memcpy(m_allocInfos[i].pMappedData, data, size);
+		SH_ASSERT((offset + size <= getSize()), "uniform buffer overflow :<");
+		VulkanRingBuffer& ring = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer();
+
+		VulkanRingBuffer::Allocation slice;
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+			memcpy(m_recorded.data() + offset, data, size);
+
+			slice = ring.allocate(getSize(), BufferUsage::UniformBuffer);
+			if (!slice.pData)
+				return;
+
+			memcpy(slice.pData, m_recorded.data(), getSize());
+		}
+
+		// the commands recorded after this call read the new slice
+		Renderer::submit([this, slice]()
+			{
+				std::scoped_lock<std::mutex> lock(m_mutex);
+				memcpy(m_executed.data(), slice.pData, getSize());
+
+				m_sliceOffset = slice.offset;
+				m_sliceFrame = slice.frame;
+				m_hasSlice = true;
+			});
 	}
 
 	void VulkanUniformBuffer::setData_RT(const void* data, uint32_t size, uint32_t offset)
 	{
-		memcpy(m_allocInfos[Renderer::getCmdBuffer()->currentFrame()].pMappedData, data, size);
+		setData(data, size, offset);
+	}
+
+	uint32_t VulkanUniformBuffer::getDynamicOffset()
+	{
+		VulkanRingBuffer& ring = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer();
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		if (!m_hasSlice || ring.getFrame() - m_sliceFrame > 1)
+		{
+			VulkanRingBuffer::Allocation slice = ring.allocate(getSize(), BufferUsage::UniformBuffer);
+			if (!slice.pData)
+				return 0;
+
+			memcpy(slice.pData, m_executed.data(), getSize());
+			m_sliceOffset = slice.offset;
+			m_sliceFrame = slice.frame;
+			m_hasSlice = true;
+		}
+
+		return m_sliceOffset;
 	}
 
 	VulkanStorageBuffer::VulkanStorageBuffer(const void* data, uint32_t size, uint32_t stride, BufferUsage usage)
 		: m_size(size), m_elemCount(size/stride), m_usage(BufferUsage::StorageBuffer | usage)
 	{
 		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		VkDeviceSize bufferSize = size;
 		VkBufferUsageFlags bufferUsage = static_cast<VkBufferUsageFlags>(usage) | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-		VkBuffer stagingBuffer = VK_NULL_HANDLE;
-		VmaAllocation stagingBufferAllocation = VK_NULL_HANDLE;
-
-		vulkanDevice->allocateBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &stagingBuffer, &stagingBufferAllocation);
-		vulkanDevice->allocateBuffer(bufferSize, bufferUsage, VMA_MEMORY_USAGE_GPU_ONLY, &m_vkBuffer, &m_allocation);
-
-		void* mappedData;
-		vmaMapMemory(vulkanDevice->getVmaAllocator(), stagingBufferAllocation, &mappedData);
-		memcpy(mappedData, data, size);
-		vmaUnmapMemory(vulkanDevice->getVmaAllocator(), stagingBufferAllocation);
-
-		Ref<VulkanCmdBuffer> cmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
-		VkCommandBuffer vkCmdBuffer = cmdBuffer->beginSingleTimeCmdBuffer(vulkanDevice->getTransferQueueIndex());
-		vulkanDevice->copyBufferToBuffer(vkCmdBuffer, stagingBuffer, m_vkBuffer, bufferSize, 0, 0);
-		cmdBuffer->submitSingleTimeCmdBuffer(vkCmdBuffer, vulkanDevice->getTransferQueueIndex());
-
-		vkQueueWaitIdle(vulkanDevice->getTransferQueue());
-		vmaDestroyBuffer(vulkanDevice->getVmaAllocator(), stagingBuffer, stagingBufferAllocation);
+		vulkanDevice->allocateBuffer(size, bufferUsage, VMA_MEMORY_USAGE_GPU_ONLY, &m_vkBuffer, &m_allocation);
+		m_uploadTicket = vulkanDevice->getUploadManager().uploadBuffer(m_vkBuffer, data, size);
 	}
 
 	VulkanStorageBuffer::~VulkanStorageBuffer()
 	{
 		VulkanDevice* vulkanDevice = VulkanContext::getVulkanDevice();
-		vkQueueWaitIdle(vulkanDevice->getGraphicsQueue());
-	    vmaDestroyBuffer(vulkanDevice->getVmaAllocator(), m_vkBuffer, m_allocation);
+
+		vulkanDevice->getUploadManager().wait(m_uploadTicket);
+		vulkanDevice->retireBuffer(m_vkBuffer, m_allocation);
 	}
 }
\ No newline at end of file
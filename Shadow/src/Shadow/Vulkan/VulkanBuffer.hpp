@@ -2,8 +2,10 @@
 
 #include "Shadow/Renderer/Buffer.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
+#include "Shadow/Vulkan/VulkanRingBuffer.hpp"
 		 
 #include <vma/vk_mem_alloc.h>
+#include <mutex>
 
 namespace Shadow
 {
@@ -13,12 +15,17 @@ namespace Shadow
 		VulkanRenderBuffer(const void* data, uint32_t size, uint32_t stride, BufferUsage bufferUsage);
 		virtual ~VulkanRenderBuffer();
 
+		virtual UploadTicket getUploadTicket() const override { return m_uploadTicket; }
+
 		inline const VkBuffer getVkBuffer() const { return m_buffer; }
 	private:
 		VkBuffer m_buffer;
 		VmaAllocation m_allocation;
+		UploadTicket m_uploadTicket = 0;
 	};
 
+	// static buffers live in gpu memory and are filled through the upload manager. streaming buffers don't own any memory,
+	// every frame's setData() writes into a slice of the frame ring buffer and the draws of that frame bind the slice
 	class VulkanVertexBuffer : public VertexBuffer
 	{
 	public:
@@ -26,26 +33,66 @@ namespace Shadow
 		VulkanVertexBuffer(void* data, uint32_t size, uint32_t stride);
 		virtual ~VulkanVertexBuffer();
 
+		// streaming buffers only, static ones are immutable after their upload.
+		// the contents don't carry over to the next frame, the part a frame draws has to be written in that frame
 		virtual void setData(const void* data, uint32_t size, uint32_t offset) override;
 
 		virtual uint32_t getVertexCount() const { return m_vertexCount; }
+		virtual BufferPolicy getPolicy() const override { return m_policy; }
+		virtual UploadTicket getUploadTicket() const override { return m_uploadTicket; }
 
-		inline const VkBuffer getVkBuffer() const { return m_vertexBuffer.buffer; }
+		// executing thread, the binding of the frame being recorded
+		VkBuffer getVkBuffer() const;
+		VkDeviceSize getOffset();
 	private:
+		uint32_t m_size;
 		uint32_t m_vertexCount;
+		BufferPolicy m_policy;
+		UploadTicket m_uploadTicket = 0;
+
+		// static buffers only
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		VmaAllocation m_allocation = VK_NULL_HANDLE;
+
+		// streaming buffers only
+		VulkanRingBuffer::Allocation m_recordedSlice; // written by setData() in the current ring frame
+		VulkanRingBuffer::Allocation m_drawSlice;     // read by the recorded commands
+		std::mutex m_mutex;
+	};
+
+	// the blocks of a frame are picked by the frame ring buffer's frame, so an arena slice lives exactly as long as a ring allocation
+	class VulkanVertexArena : public VertexArena
+	{
+	public:
+		VulkanVertexArena(uint32_t stride, uint32_t blockVertexCount);
+		virtual ~VulkanVertexArena();
 
-		struct
+		virtual ArenaSlice allocate(uint32_t vertexCount) override;
+
+		// executing thread
+		VkBuffer getVkBuffer(const ArenaSlice& slice);
+	private:
+		struct Block
 		{
 			VkBuffer buffer = VK_NULL_HANDLE;
 			VmaAllocation allocation = VK_NULL_HANDLE;
-		} m_vertexBuffer;
+			uint8_t* pData = nullptr;
+			uint32_t vertexCount = 0;
+		};
 
-		struct
+		struct Region
 		{
-			VkBuffer buffer;
-			VmaAllocation allocation;
-			VmaAllocationInfo allocInfo;
-		} m_stagingBuffer;
+			std::vector<Block> blocks;
+			uint32_t head = 0; // vertices used in the last block
+			uint64_t frame = UINT64_MAX;
+		};
+
+		void addBlock(Region& region, uint32_t vertexCount);
+		void retireBlocks(Region& region);
+	private:
+		uint32_t m_blockVertexCount;
+		std::array<Region, VulkanRingBuffer::s_regionCount> m_regions;
+		std::mutex m_mutex;
 	};
 
 	class VulkanIndexBuffer : public IndexBuffer
@@ -54,27 +101,37 @@ namespace Shadow
 		VulkanIndexBuffer(uint32_t* indices, uint32_t count);
 		virtual ~VulkanIndexBuffer();
 
+		virtual UploadTicket getUploadTicket() const override { return m_uploadTicket; }
+
 		inline const VkBuffer getVkBuffer() const { return m_buffer; }
 	private:
 		VkBuffer m_buffer;
 		VmaAllocation m_allocation;
+		UploadTicket m_uploadTicket = 0;
 	};
 
+	// every setData() writes the whole buffer into a fresh slice of the frame ring buffer, the shader binds it through a dynamic offset.
+	// the buffer has to stay alive until the frames that recorded setData() have been executed
 	class VulkanUniformBuffer : public UniformBuffer
 	{
 	public:
 		VulkanUniformBuffer(uint32_t size);
-		virtual ~VulkanUniformBuffer();
+		virtual ~VulkanUniformBuffer() = default;
 
 		virtual void setData(const void* data, uint32_t size, uint32_t offset) override;
 		virtual void setData_RT(const void* data, uint32_t size, uint32_t offset) override;
 
-		inline const std::array<VkBuffer, VulkanDevice::s_maxFramesInFlight>& getBuffers() const { return m_buffers; }
-		inline const VkBuffer const getVkBuffer(uint16_t index) const { return m_buffers[index]; }
+		// executing thread. a slice that is too old to be read by the frame being recorded is copied into the current region first
+		uint32_t getDynamicOffset();
 	private:
-		std::array<VkBuffer, VulkanDevice::s_maxFramesInFlight> m_buffers;
-		std::array<VmaAllocation, VulkanDevice::s_maxFramesInFlight> m_allocations;
-		std::array<VmaAllocationInfo, VulkanDevice::s_maxFramesInFlight> m_allocInfos;
+		std::vector<uint8_t> m_recorded; // contents as seen by the thread calling setData()
+		std::vector<uint8_t> m_executed; // contents as seen by the recorded commands
+
+		uint32_t m_sliceOffset = 0;
+		uint64_t m_sliceFrame = 0;
+		bool m_hasSlice = false;
+
+		std::mutex m_mutex;
 	};
 
 	class VulkanStorageBuffer : public StorageBuffer
@@ -86,6 +143,7 @@ namespace Shadow
 		virtual uint32_t getSize() const { return m_size; }
 		virtual uint32_t getElementCount() const { return m_elemCount; }
 		virtual BufferUsage getUsage() const { return m_usage; }
+		virtual UploadTicket getUploadTicket() const override { return m_uploadTicket; }
 
 		inline const VkBuffer getVkBuffer() const { return m_vkBuffer; }
 	private:
@@ -95,5 +153,6 @@ namespace Shadow
 
 		VkBuffer m_vkBuffer;
 		VmaAllocation m_allocation;
+		UploadTicket m_uploadTicket = 0;
 	};
 }
\ No newline at end of file
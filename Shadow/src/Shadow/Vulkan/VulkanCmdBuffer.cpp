@@ -5,17 +5,43 @@
 #include "Shadow/Vulkan/VulkanPipeline.hpp"
 #include "Shadow/Vulkan/VulkanRenderpass.hpp"
 #include "Shadow/Vulkan/VulkanBuffer.hpp"
+#include "Shadow/Vulkan/VulkanShader.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
+
+#include "Shadow/Core/JobSystem.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
 
 #include "Shadow/ImGui/VkImGuiLayer.hpp"
 #include "Shadow/Renderer/Mesh.hpp"
 
 namespace Shadow
 {
+	// every job system worker plus the main and the render thread record secondaries with their own recorder
+	static constexpr uint32_t s_externalRecordingThreads = 2;
+	static std::atomic<uint32_t> s_recorderCount{ 0 };
+	static thread_local uint32_t s_recorderIndex = UINT32_MAX;
+
+	// bytes every frame can bump through the ring buffer (transient geometry and uniform data)
+	static constexpr uint32_t s_ringRegionSize = 8 * 1024 * 1024;
+
+	static uint32_t getRecorderIndex()
+	{
+		if (s_recorderIndex == UINT32_MAX)
+			s_recorderIndex = s_recorderCount.fetch_add(1, std::memory_order_relaxed);
+
+		return s_recorderIndex;
+	}
+
 	VulkanCmdBuffer::VulkanCmdBuffer()
 	{
 		createCmdBufferPools();
 		createCmdBuffers();
 		createSyncObjects();
+		createSecondaryCmdPools();
+
+		m_ringBuffer = createScope<VulkanRingBuffer>(VulkanContext::getVulkanDevice(), s_ringRegionSize);
 
 		for (uint32_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
 		{
@@ -51,6 +77,12 @@ namespace Shadow
 			vkDestroyFence(device, m_compute.inFlightFences[i], nullptr);
 		}
 
+		for (auto& recorder : m_secondaryRecorders)
+		{
+			for (VkCommandPool cmdPool : recorder.cmdPools)
+				vkDestroyCommandPool(device, cmdPool, nullptr);
+		}
+
 		vkDestroyCommandPool(device, m_graphics.cmdPool, nullptr);
 		vkDestroyCommandPool(device, m_transfer.cmdPool, nullptr);
 		vkDestroyCommandPool(device, m_compute.cmdPool, nullptr);
@@ -63,9 +95,21 @@ namespace Shadow
 		vkWaitForFences(device->getVkDevice(), 1, &m_graphics.inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
 		vkResetFences(device->getVkDevice(), 1, &m_graphics.inFlightFences[m_currentFrame]);
 
+		// nothing recorded N frames ago is read anymore
+		FrameAllocator::beginFrame(m_currentFrame);
+		device->beginFrame(m_currentFrame);
+		m_ringBuffer->beginFrame();
+
 		device->getSwapchain()->acquireNextImage(m_graphics.imageAvailableSemaphores[m_currentFrame]);
 		vkResetCommandBuffer(m_graphics.cmdBuffers[m_currentFrame], 0);
 
+		// the fence guarantees that the secondaries of this frame aren't in use anymore
+		for (auto& recorder : m_secondaryRecorders)
+		{
+			vkResetCommandPool(device->getVkDevice(), recorder.cmdPools[m_currentFrame], 0);
+			recorder.usedCount[m_currentFrame] = 0;
+		}
+
 		VkCommandBufferBeginInfo beginInfo{};
 		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
 		beginInfo.flags = 0;
@@ -82,6 +126,14 @@ namespace Shadow
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
 		VkSubmitInfo2 submitInfos[2]{};
 
+		// the uploads recorded since the last frame go out as one batch, the frame only waits for the ones it uses
+		VulkanUploadManager& uploads = device->getUploadManager();
+		uploads.flush();
+		const UploadTicket uploadWait = uploads.getFrameWait();
+		// the handles this frame uses may point at memory a defragmentation pass is still copying into
+		VulkanDefragmenter& defragmenter = device->getDefragmenter();
+		const uint64_t defragWait = defragmenter.getFrameWait();
+
 		// rendering submission
 		VkCommandBufferSubmitInfo cmdSubmit{};
 		cmdSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
@@ -90,7 +142,11 @@ namespace Shadow
 		submitInfos[0].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
 		submitInfos[0].commandBufferInfoCount = 1;
 		submitInfos[0].pCommandBufferInfos = &cmdSubmit;
-		submitInfos[0].waitSemaphoreInfoCount = static_cast<uint32_t>(m_graphics.waitStages.size());
+		// a headless swapchain never signals the image available semaphore (always the first wait semaphore)
+		const bool headless = device->isHeadless();
+		const uint32_t firstWaitSemaphore = headless ? 1 : 0;
+
+		submitInfos[0].waitSemaphoreInfoCount = static_cast<uint32_t>(m_graphics.waitStages.size()) - firstWaitSemaphore;
 		submitInfos[0].signalSemaphoreInfoCount = static_cast<uint32_t>(m_graphics.signalSemaphores[m_currentFrame].size());
 
 		VkSemaphoreSubmitInfo semaphoreSubmits[10] = {}; // 0-4 -> waitSemaphores; 5-9 -> signalSemaphores
@@ -98,8 +154,26 @@ namespace Shadow
 		for (uint32_t i = 0; i < submitInfos[0].waitSemaphoreInfoCount; i++) // wait semaphore submit infos
 		{
 			semaphoreSubmits[i].sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
-			semaphoreSubmits[i].semaphore = m_graphics.waitSemaphores[m_currentFrame][i];
-			semaphoreSubmits[i].stageMask = m_graphics.waitStages[i];
+			semaphoreSubmits[i].semaphore = m_graphics.waitSemaphores[m_currentFrame][i + firstWaitSemaphore];
+			semaphoreSubmits[i].stageMask = m_graphics.waitStages[i + firstWaitSemaphore];
+		}
+
+		if (uploadWait)
+		{
+			VkSemaphoreSubmitInfo& uploadSemaphore = semaphoreSubmits[submitInfos[0].waitSemaphoreInfoCount++];
+			uploadSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			uploadSemaphore.semaphore = uploads.getTimelineSemaphore();
+			uploadSemaphore.value = uploadWait;
+			uploadSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+		}
+
+		if (defragWait)
+		{
+			VkSemaphoreSubmitInfo& defragSemaphore = semaphoreSubmits[submitInfos[0].waitSemaphoreInfoCount++];
+			defragSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+			defragSemaphore.semaphore = defragmenter.getTimelineSemaphore();
+			defragSemaphore.value = defragWait;
+			defragSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
 		}
 
 		for (uint32_t i = 0; i < submitInfos[0].signalSemaphoreInfoCount; i++) // signal semaphore submit infos
@@ -115,7 +189,7 @@ namespace Shadow
 
 
 		// imgui rendering submission
-		Ref<VulkanImGuiLayer> imguiLayer = as<VulkanImGuiLayer>(ShEngine::get().getImGuiLayer());
+		VulkanImGuiLayer* imguiLayer = as<VulkanImGuiLayer>(ShEngine::get().getImGuiLayer());
 
 		VkCommandBufferSubmitInfo imguiCmdSubmit{};
 		imguiCmdSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
@@ -136,9 +210,11 @@ namespace Shadow
 		submitInfos[1].pCommandBufferInfos = &imguiCmdSubmit;
 		submitInfos[1].waitSemaphoreInfoCount = 1;
 		submitInfos[1].pWaitSemaphoreInfos = &waitSemaphoreInfo;
-		submitInfos[1].signalSemaphoreInfoCount = 1;
+		// nothing waits on the ui semaphore when there is no presentation
+		submitInfos[1].signalSemaphoreInfoCount = headless ? 0 : 1;
 		submitInfos[1].pSignalSemaphoreInfos = &signalSemaphoreInfo;
 
+		std::scoped_lock<std::mutex> queueLock(device->getQueueMutex());
 		vkQueueSubmit2(device->getGraphicsQueue(), 2, submitInfos, m_graphics.inFlightFences[m_currentFrame]);
 	}
 
@@ -153,60 +229,180 @@ namespace Shadow
 		viewport.height = height;
 		viewport.minDepth = 0.0f;
 		viewport.maxDepth = 1.0f;
-		vkCmdSetViewport(m_graphics.cmdBuffers[m_currentFrame], 0, 1, &viewport);
 
 		VkRect2D scissor{};
 		scissor.offset = { 0, 0 };
 		scissor.extent = device->getSwapchain()->getExtent();
-		vkCmdSetScissor(m_graphics.cmdBuffers[m_currentFrame], 0, 1, &scissor);
+
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		vkCmdSetViewport(cmdBuffer, 0, 1, &viewport);
+		vkCmdSetScissor(cmdBuffer, 0, 1, &scissor);
+
+		// dynamic states aren't inherited by secondary command buffers
+		if (cmdBuffer == m_graphics.cmdBuffers[m_currentFrame])
+		{
+			m_viewport = viewport;
+			m_scissor = scissor;
+		}
 	}
 
-	void VulkanCmdBuffer::beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	void VulkanCmdBuffer::beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents)
 	{
 		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
 		auto vkPipe = as<VulkanGraphicsPipeline>(pipe);
 
-		auto& descriptorSets = vkPipe->getDescriptorSets();
-		auto& pushConstants = vkPipe->getPushConstantRanges();
-		auto& pipeConfig = vkPipe->getConfiguration();
-
 		VkRenderPassBeginInfo beginInfo{};
 		vkPipe->getVkRenderpass()->initBeginInfo(beginInfo);
 
+		if (contents == SubpassContents::SecondaryCmdBuffers)
+		{
+			vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			return;
+		}
+
 		vkCmdBeginRenderPass(cmdBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
-		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getVkPipeline());
+		bindGraphicsPipeline(cmdBuffer, pipe, pPushConstants);
+	}
 
-		if (descriptorSets.size)
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+	void VulkanCmdBuffer::endRenderPass()
+	{
+		vkCmdEndRenderPass(m_graphics.cmdBuffers[m_currentFrame]);
+	}
 
-		char* pRange = (char*)pPushConstants;
-		for (size_t i = 0; i < pushConstants.size(); i++)
+	void VulkanCmdBuffer::nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents)
+	{
+		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+
+		if (contents == SubpassContents::SecondaryCmdBuffers)
 		{
-			SH_ASSERT(pRange, "pPushConstnats must be an array of valid pointers");
-			vkCmdPushConstants(cmdBuffer, vkPipe->getLayout(), pushConstants[i].stageFlags, pushConstants[i].offset, pushConstants[i].size, pRange);
+			vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+			return;
+		}
 
-			pRange += pushConstants[i].size;
+		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
+		bindGraphicsPipeline(cmdBuffer, pipe, pPushConstants);
+	}
+
+	void VulkanCmdBuffer::bindPipeline(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	{
+		bindGraphicsPipeline(getRecordingCmdBuffer(), pipe, pPushConstants);
+	}
+
+	void VulkanCmdBuffer::beginSecondary(const Ref<GraphicsPipeline>& pipe, uint32_t order, const void* pPushConstants)
+	{
+		SH_PROFILE_RENDERER_FUNCTION();
+
+		VulkanDevice* device = VulkanContext::getVulkanDevice();
+		SH_ASSERT((getRecorderIndex() < m_secondaryRecorders.size()), "too many threads are recording secondary command buffers :<");
+		SecondaryRecorder& recorder = m_secondaryRecorders[getRecorderIndex()];
+		SH_ASSERT(!recorder.recording, "secondary command buffer recording has already begun on this thread :<");
+
+		auto vkPipe = as<VulkanGraphicsPipeline>(pipe);
+		SH_ASSERT(vkPipe->getVkRenderpass(), "secondary command buffers are only supported inside render passes for now :<");
+
+		auto& cmdBuffers = recorder.cmdBuffers[m_currentFrame];
+		uint32_t& usedCount = recorder.usedCount[m_currentFrame];
+
+		if (usedCount == cmdBuffers.size())
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.commandPool = recorder.cmdPools[m_currentFrame];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+
+			VkCommandBuffer cmdBuffer;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device->getVkDevice(), &allocInfo, &cmdBuffer));
+			cmdBuffers.emplace_back(cmdBuffer);
 		}
+
+		recorder.recording = cmdBuffers[usedCount++];
+		recorder.order = order;
+
+		VkRenderPassBeginInfo renderpassInfo{};
+		vkPipe->getVkRenderpass()->initBeginInfo(renderpassInfo);
+
+		VkCommandBufferInheritanceInfo inheritance{};
+		inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritance.renderPass = renderpassInfo.renderPass;
+		inheritance.subpass = pipe->getConfiguration().subpass;
+		inheritance.framebuffer = renderpassInfo.framebuffer;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritance;
+		VK_CHECK_RESULT(vkBeginCommandBuffer(recorder.recording, &beginInfo));
+
+		vkCmdSetViewport(recorder.recording, 0, 1, &m_viewport);
+		vkCmdSetScissor(recorder.recording, 0, 1, &m_scissor);
+		bindGraphicsPipeline(recorder.recording, pipe, pPushConstants);
 	}
 
-	void VulkanCmdBuffer::endRenderPass()
+	void VulkanCmdBuffer::endSecondary()
 	{
-		vkCmdEndRenderPass(m_graphics.cmdBuffers[m_currentFrame]);
+		SecondaryRecorder& recorder = m_secondaryRecorders[getRecorderIndex()];
+		SH_ASSERT(recorder.recording, "endSecondary() called without beginSecondary() :<");
+
+		VK_CHECK_RESULT(vkEndCommandBuffer(recorder.recording));
+
+		{
+			std::scoped_lock<std::mutex> lock(m_secondaryMutex);
+			m_recordedSecondaries.emplace_back(recorder.order, recorder.recording);
+		}
+
+		recorder.recording = VK_NULL_HANDLE;
 	}
 
-	void VulkanCmdBuffer::nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants)
+	void VulkanCmdBuffer::executeSecondaries()
 	{
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		SH_PROFILE_RENDERER_FUNCTION();
+
+		std::scoped_lock<std::mutex> lock(m_secondaryMutex);
+		if (m_recordedSecondaries.empty())
+			return;
+
+		std::stable_sort(m_recordedSecondaries.begin(), m_recordedSecondaries.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+
+		FrameVector<VkCommandBuffer> cmdBuffers;
+		cmdBuffers.reserve(m_recordedSecondaries.size());
+		for (auto& [order, cmdBuffer] : m_recordedSecondaries)
+			cmdBuffers.emplace_back(cmdBuffer);
+
+		vkCmdExecuteCommands(m_graphics.cmdBuffers[m_currentFrame], static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
+		m_recordedSecondaries.clear();
+	}
+
+	VkCommandBuffer VulkanCmdBuffer::getRecordingCmdBuffer() const
+	{
+		const uint32_t recorderIndex = getRecorderIndex();
+		if (recorderIndex < m_secondaryRecorders.size() && m_secondaryRecorders[recorderIndex].recording)
+			return m_secondaryRecorders[recorderIndex].recording;
+
+		return m_graphics.cmdBuffers[m_currentFrame];
+	}
 
+	void VulkanCmdBuffer::bindGraphicsPipeline(VkCommandBuffer cmdBuffer, const Ref<GraphicsPipeline>& pipe, const void* pPushConstants) const
+	{
 		auto vkPipe = as<VulkanGraphicsPipeline>(pipe);
 		auto& descriptorSets = vkPipe->getDescriptorSets();
 		auto& pushConstants = vkPipe->getPushConstantRanges();
 
-		vkCmdNextSubpass(cmdBuffer, VK_SUBPASS_CONTENTS_INLINE);
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getVkPipeline());
 
 		if (descriptorSets.size)
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getLayout(), 0, 1, descriptorSets.data(), 0, nullptr);
+		{
+			uint32_t dynamicOffsets[VulkanShader::s_maxDynamicUniforms];
+			const uint32_t dynamicOffsetCount = vkPipe->getDynamicOffsets(0, dynamicOffsets);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getLayout(), 0, 1, descriptorSets.data(), dynamicOffsetCount, dynamicOffsets);
+		}
+
+		if (vkPipe->usesTextureHeap())
+		{
+			const VkDescriptorSet heapSet = VulkanContext::getVulkanDevice()->getTextureHeap().getDescriptorSet();
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, vkPipe->getLayout(), VulkanTextureHeap::s_set, 1, &heapSet, 0, nullptr);
+		}
 
 		char* pRange = (char*)pPushConstants;
 		for (size_t i = 0; i < pushConstants.size(); i++)
@@ -220,29 +416,37 @@ namespace Shadow
 
 	void VulkanCmdBuffer::drawMesh(const Mesh& mesh)
 	{
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
 		auto& meshIndexBuffer = mesh.getIndexBuffer();
 
-		VkBuffer vb = as<VulkanVertexBuffer>(mesh.getVertexBuffer())->getVkBuffer();
-		VkDeviceSize offset = 0;
+		useUploads(mesh.getVertexBuffer()->getUploadTicket(), meshIndexBuffer->getUploadTicket());
+		// the textures are sampled through the texture heap, nothing else makes the frame wait for them
+		for (const Ref<Texture2D>& texture : mesh.getTextures())
+			useUploads(texture->getUploadTicket());
+
+		auto vulkanVertexBuffer = as<VulkanVertexBuffer>(mesh.getVertexBuffer());
+		VkBuffer vb = vulkanVertexBuffer->getVkBuffer();
+		VkDeviceSize offset = vulkanVertexBuffer->getOffset();
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vb, &offset);
 
 		VkBuffer ib = as<VulkanIndexBuffer>(mesh.getIndexBuffer())->getVkBuffer();
-		vkCmdBindIndexBuffer(cmdBuffer, ib, offset, VK_INDEX_TYPE_UINT32);
+		vkCmdBindIndexBuffer(cmdBuffer, ib, 0, VK_INDEX_TYPE_UINT32);
 		vkCmdDrawIndexed(cmdBuffer, meshIndexBuffer->getCount(), 1, 0, 0, 0);
 	}
 
 	void VulkanCmdBuffer::draw(uint32_t verticesCount, uint32_t firstVertex)
 	{
-		vkCmdDraw(m_graphics.cmdBuffers[m_currentFrame], verticesCount, 1, firstVertex, 0);
+		vkCmdDraw(getRecordingCmdBuffer(), verticesCount, 1, firstVertex, 0);
 	}
 
 	void VulkanCmdBuffer::draw(const Ref<VertexBuffer>& vertexBuffer)
 	{
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(vertexBuffer->getUploadTicket());
 
-		VkBuffer buffer = as<VulkanVertexBuffer>(vertexBuffer)->getVkBuffer();
-		VkDeviceSize offset = 0;
+		auto vulkanVertexBuffer = as<VulkanVertexBuffer>(vertexBuffer);
+		VkBuffer buffer = vulkanVertexBuffer->getVkBuffer();
+		VkDeviceSize offset = vulkanVertexBuffer->getOffset();
 
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, &offset);
 		vkCmdDraw(cmdBuffer, vertexBuffer->getVertexCount(), 1, 0, 0);
@@ -250,7 +454,9 @@ namespace Shadow
 
 	void VulkanCmdBuffer::draw(const Ref<StorageBuffer>& vertexBuffer)
 	{
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(vertexBuffer->getUploadTicket());
+
 		VkBuffer buffer = as<VulkanStorageBuffer>(vertexBuffer)->getVkBuffer();
 		VkDeviceSize offset = 0;
 
@@ -261,12 +467,14 @@ namespace Shadow
 	void VulkanCmdBuffer::drawIndexed(const Ref<VertexBuffer>& vertexBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount)
 	{
 		uint32_t count = indexCount ? indexCount : indexBuffer->getCount();
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(vertexBuffer->getUploadTicket(), indexBuffer->getUploadTicket());
 
-		VkBuffer vkVertexBuffer = as<VulkanVertexBuffer>(vertexBuffer)->getVkBuffer();
+		auto vulkanVertexBuffer = as<VulkanVertexBuffer>(vertexBuffer);
+		VkBuffer vkVertexBuffer = vulkanVertexBuffer->getVkBuffer();
 		VkBuffer vkIndexBuffer = as<VulkanIndexBuffer>(indexBuffer)->getVkBuffer();
 
-		VkDeviceSize offset = 0;
+		VkDeviceSize offset = vulkanVertexBuffer->getOffset();
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &vkVertexBuffer, &offset);
 		vkCmdBindIndexBuffer(cmdBuffer, vkIndexBuffer, 0, VK_INDEX_TYPE_UINT32);
 		vkCmdDrawIndexed(cmdBuffer, count, 1, 0, 0, 0);
@@ -275,14 +483,14 @@ namespace Shadow
 	void VulkanCmdBuffer::drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, uint32_t instanceCount)
 	{
 		uint32_t count = instanceCount ? instanceCount : instanceBuffer->getVertexCount();
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(vertexBuffer->getUploadTicket(), instanceBuffer->getUploadTicket());
 
-		VkBuffer vertexBuffers[2] = {
-			as<VulkanVertexBuffer>(vertexBuffer)->getVkBuffer(),
-			as<VulkanVertexBuffer>(instanceBuffer)->getVkBuffer()
-		};
+		auto vulkanVertexBuffer = as<VulkanVertexBuffer>(vertexBuffer);
+		auto vulkanInstanceBuffer = as<VulkanVertexBuffer>(instanceBuffer);
 
-		VkDeviceSize offsets[2] = { 0,0 };
+		VkBuffer vertexBuffers[2] = { vulkanVertexBuffer->getVkBuffer(), vulkanInstanceBuffer->getVkBuffer() };
+		VkDeviceSize offsets[2] = { vulkanVertexBuffer->getOffset(), vulkanInstanceBuffer->getOffset() };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 2, vertexBuffers, offsets);
 		vkCmdDraw(cmdBuffer, vertexBuffer->getVertexCount(), count, 0, 0);
 	}
@@ -290,14 +498,14 @@ namespace Shadow
 	void VulkanCmdBuffer::drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t instanceCount)
 	{
 		uint32_t count = instanceCount ? instanceCount : instanceBuffer->getVertexCount();
-		VkCommandBuffer cmdBuffer = m_graphics.cmdBuffers[m_currentFrame];
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(vertexBuffer->getUploadTicket(), instanceBuffer->getUploadTicket(), indexBuffer->getUploadTicket());
 
-		VkBuffer vertexBuffers[2] = {
-			as<VulkanVertexBuffer>(vertexBuffer)->getVkBuffer(),
-			as<VulkanVertexBuffer>(instanceBuffer)->getVkBuffer()
-		};
+		auto vulkanVertexBuffer = as<VulkanVertexBuffer>(vertexBuffer);
+		auto vulkanInstanceBuffer = as<VulkanVertexBuffer>(instanceBuffer);
 
-		VkDeviceSize offsets[2] = { 0,0 };
+		VkBuffer vertexBuffers[2] = { vulkanVertexBuffer->getVkBuffer(), vulkanInstanceBuffer->getVkBuffer() };
+		VkDeviceSize offsets[2] = { vulkanVertexBuffer->getOffset(), vulkanInstanceBuffer->getOffset() };
 		vkCmdBindVertexBuffers(cmdBuffer, 0, 2, vertexBuffers, offsets);
 
 		VkBuffer ib = as<VulkanIndexBuffer>(indexBuffer)->getVkBuffer();
@@ -305,6 +513,67 @@ namespace Shadow
 		vkCmdDrawIndexed(cmdBuffer, indexBuffer->getCount(), count, 0, 0, 0);
 	}
 
+	void VulkanCmdBuffer::draw(const TransientBuffer& vertices, uint32_t vertexCount)
+	{
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+
+		VkBuffer buffer = m_ringBuffer->getVkBuffer();
+		VkDeviceSize offset = vertices.offset;
+
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, &offset);
+		vkCmdDraw(cmdBuffer, vertexCount, 1, 0, 0);
+	}
+
+	void VulkanCmdBuffer::drawIndexed(const TransientBuffer& vertices, const TransientBuffer& indices, uint32_t indexCount)
+	{
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+
+		VkBuffer buffer = m_ringBuffer->getVkBuffer();
+		VkDeviceSize offset = vertices.offset;
+
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, &offset);
+		vkCmdBindIndexBuffer(cmdBuffer, buffer, indices.offset, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(cmdBuffer, indexCount, 1, 0, 0, 0);
+	}
+
+	void VulkanCmdBuffer::drawIndexed(const TransientBuffer& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount)
+	{
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(indexBuffer->getUploadTicket());
+
+		VkBuffer buffer = m_ringBuffer->getVkBuffer();
+		VkDeviceSize offset = vertices.offset;
+
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, &offset);
+		vkCmdBindIndexBuffer(cmdBuffer, as<VulkanIndexBuffer>(indexBuffer)->getVkBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(cmdBuffer, indexCount, 1, 0, 0, 0);
+	}
+
+	void VulkanCmdBuffer::drawIndexed(const Ref<VertexArena>& arena, const ArenaSlice& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount, uint32_t firstIndex)
+	{
+		VkCommandBuffer cmdBuffer = getRecordingCmdBuffer();
+		useUploads(indexBuffer->getUploadTicket());
+
+		// the whole block is bound, the slice is selected by the vertex offset
+		VkBuffer buffer = as<VulkanVertexArena>(arena)->getVkBuffer(vertices);
+		VkDeviceSize offset = 0;
+
+		vkCmdBindVertexBuffers(cmdBuffer, 0, 1, &buffer, &offset);
+		vkCmdBindIndexBuffer(cmdBuffer, as<VulkanIndexBuffer>(indexBuffer)->getVkBuffer(), 0, VK_INDEX_TYPE_UINT32);
+		vkCmdDrawIndexed(cmdBuffer, indexCount, 1, firstIndex, static_cast<int32_t>(vertices.firstVertex), 0);
+	}
+
+	TransientBuffer VulkanCmdBuffer::allocateTransient(uint32_t size, BufferUsage usage)
+	{
+		VulkanRingBuffer::Allocation allocation = m_ringBuffer->allocate(size, usage);
+		return { allocation.pData, allocation.offset, allocation.pData ? size : 0 };
+	}
+
+	void VulkanCmdBuffer::useUploads(UploadTicket ticket) const
+	{
+		VulkanContext::getVulkanDevice()->getUploadManager().use(ticket);
+	}
+
 	void VulkanCmdBuffer::beginTransfer()
 	{
 
@@ -331,7 +600,18 @@ namespace Shadow
 		vkCmdBindPipeline(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipe->getVkPipeline());
 
 		if (descriptorSets.size)
-			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipe->getLayout(), descriptorSet, 1, descriptorSets.data() + descriptorSet, 0, nullptr);
+		{
+			uint32_t dynamicOffsets[VulkanShader::s_maxDynamicUniforms];
+			const uint32_t dynamicOffsetCount = computePipe->getDynamicOffsets(descriptorSet, dynamicOffsets);
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipe->getLayout(), descriptorSet, 1, descriptorSets.data() + descriptorSet,
+				dynamicOffsetCount, dynamicOffsets);
+		}
+
+		if (computePipe->usesTextureHeap())
+		{
+			const VkDescriptorSet heapSet = VulkanContext::getVulkanDevice()->getTextureHeap().getDescriptorSet();
+			vkCmdBindDescriptorSets(cmdBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipe->getLayout(), VulkanTextureHeap::s_set, 1, &heapSet, 0, nullptr);
+		}
 
 		char* pRange = (char*)pPushConstants;
 		for (size_t i = 0; i < pushConstants.size(); i++)
@@ -351,19 +631,32 @@ namespace Shadow
 		VkCommandBuffer cmdBuffer = m_compute.cmdBuffers[m_currentFrame];
 		vkEndCommandBuffer(cmdBuffer);
 
-		VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
-		VkSemaphore computeWaitSemaphore = m_compute.readySemaphores[m_currentFrame];
+		// compute can run ahead of the graphics frame, so it waits for the uploads it uses by itself
+		VulkanUploadManager& uploads = device->getUploadManager();
+		const UploadTicket uploadWait = uploads.getFrameWait();
+
+		VkPipelineStageFlags waitStages[2] = { VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT };
+		VkSemaphore computeWaitSemaphores[2] = { m_compute.readySemaphores[m_currentFrame], uploads.getTimelineSemaphore() };
+		uint64_t waitValues[2] = { 0, uploadWait };
 		VkSemaphore computeSignalSemaphore = m_compute.completeSemaphores[m_currentFrame];
 
+		VkTimelineSemaphoreSubmitInfo timelineInfo{};
+		timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		timelineInfo.waitSemaphoreValueCount = uploadWait ? 2 : 1;
+		timelineInfo.pWaitSemaphoreValues = waitValues;
+
 		VkSubmitInfo computeSubmit{};
 		computeSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		computeSubmit.pNext = &timelineInfo;
 		computeSubmit.commandBufferCount = 1;
 		computeSubmit.pCommandBuffers = &cmdBuffer;
-		computeSubmit.waitSemaphoreCount = 1;
-		computeSubmit.pWaitSemaphores = &computeWaitSemaphore;
-		computeSubmit.pWaitDstStageMask = &waitStage;
+		computeSubmit.waitSemaphoreCount = uploadWait ? 2 : 1;
+		computeSubmit.pWaitSemaphores = computeWaitSemaphores;
+		computeSubmit.pWaitDstStageMask = waitStages;
 		computeSubmit.signalSemaphoreCount = 1;
 		computeSubmit.pSignalSemaphores = &computeSignalSemaphore;
+
+		std::scoped_lock<std::mutex> queueLock(device->getQueueMutex());
 		vkQueueSubmit(device->getComputeQueue(), 1, &computeSubmit, VK_NULL_HANDLE);
 	}
 
@@ -372,6 +665,17 @@ namespace Shadow
 		vkCmdDispatch(m_compute.cmdBuffers[m_currentFrame], groupX, groupY, groupZ);
 	}
 
+	void VulkanCmdBuffer::computeBarrier()
+	{
+		VkMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+		vkCmdPipelineBarrier(m_compute.cmdBuffers[m_currentFrame], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+
 	void VulkanCmdBuffer::acquireFromGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess)
 	{
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
@@ -434,6 +738,14 @@ namespace Shadow
 		SH_PROFILE_FUNCTION();
 
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
+
+		// the offscreen ring is rotated by acquireNextImage, there is nothing to hand over
+		if (device->isHeadless())
+		{
+			m_currentFrame = (m_currentFrame + 1) % VulkanDevice::s_maxFramesInFlight;
+			return;
+		}
+
 		const VkSwapchainKHR vkSwapchain = device->getSwapchain()->getVkSwapchain();
 		uint32_t imageIndex = device->getSwapchain()->getCurrentImageIndex();
 		VkSemaphore waitSemaphore = as<VulkanImGuiLayer>(ShEngine::get().getImGuiLayer())->getRenderCompleteSemaphore(m_currentFrame);
@@ -445,6 +757,8 @@ namespace Shadow
 		present.pImageIndices = &imageIndex;
 		present.waitSemaphoreCount = 1;
 		present.pWaitSemaphores = &waitSemaphore;
+
+		std::scoped_lock<std::mutex> queueLock(device->getQueueMutex());
 		vkQueuePresentKHR(device->getPresentQueue(), &present);
 
 		m_currentFrame = (m_currentFrame + 1) % VulkanDevice::s_maxFramesInFlight;
@@ -540,8 +854,11 @@ namespace Shadow
 		submit.pCommandBuffers = &cmdBuffer;
 		submit.waitSemaphoreCount = 0;
 		submit.signalSemaphoreCount = 0;
-		vkQueueSubmit(submitQueue, 1, &submit, VK_NULL_HANDLE);
-		vkQueueWaitIdle(submitQueue);
+		{
+			std::scoped_lock<std::mutex> queueLock(device->getQueueMutex());
+			vkQueueSubmit(submitQueue, 1, &submit, VK_NULL_HANDLE);
+			vkQueueWaitIdle(submitQueue);
+		}
 
 		vkFreeCommandBuffers(device->getVkDevice(), cmdPool, 1, &cmdBuffer);
 	}
@@ -583,6 +900,23 @@ namespace Shadow
 		VK_CHECK_RESULT(vkCreateCommandPool(device->getVkDevice(), &cmdPoolInfo, nullptr, &m_compute.cmdPool));
 	}
 
+	void VulkanCmdBuffer::createSecondaryCmdPools()
+	{
+		VulkanDevice* device = VulkanContext::getVulkanDevice();
+
+		VkCommandPoolCreateInfo cmdPoolInfo{};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT; // reset as a whole in begin()
+		cmdPoolInfo.queueFamilyIndex = device->getGraphicsQueueIndex();
+
+		m_secondaryRecorders.resize(JobSystem::getWorkerCount() + s_externalRecordingThreads);
+		for (auto& recorder : m_secondaryRecorders)
+		{
+			for (uint32_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
+				VK_CHECK_RESULT(vkCreateCommandPool(device->getVkDevice(), &cmdPoolInfo, nullptr, &recorder.cmdPools[i]));
+		}
+	}
+
 	void VulkanCmdBuffer::createSyncObjects()
 	{
 		VulkanDevice* device = VulkanContext::getVulkanDevice();
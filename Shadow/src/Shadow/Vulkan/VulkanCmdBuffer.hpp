@@ -2,6 +2,9 @@
 
 #include "Shadow/Renderer/RenderCmdBuffer.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
+#include "Shadow/Vulkan/VulkanRingBuffer.hpp"
+
+#include <mutex>
 
 namespace Shadow
 {
@@ -16,9 +19,14 @@ namespace Shadow
 		virtual void submit() override;
 
 		virtual void setViewport(float x, float y, float width, float height) override;
-		virtual void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants) override;
+		virtual void beginRenderPass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents) override;
 		virtual void endRenderPass() override;
-		virtual void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants) override;
+		virtual void nextSubpass(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants, SubpassContents contents) override;
+		virtual void bindPipeline(const Ref<GraphicsPipeline>& pipe, const void* pPushConstants) override;
+
+		virtual void beginSecondary(const Ref<GraphicsPipeline>& pipe, uint32_t order, const void* pPushConstants) override;
+		virtual void endSecondary() override;
+		virtual void executeSecondaries() override;
 
 		virtual void drawMesh(const Mesh& mesh) override;
 		virtual void draw(uint32_t verticesCount, uint32_t firstVertex) override;
@@ -27,6 +35,12 @@ namespace Shadow
 		virtual void drawIndexed(const Ref<VertexBuffer>& vertexBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount = 0) override;
 		virtual void drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, uint32_t instanceCount) override;
 		virtual void drawInstanced(const Ref<VertexBuffer>& vertexBuffer, const Ref<VertexBuffer>& instanceBuffer, const Ref<IndexBuffer>& indexBuffer, uint32_t instanceCount) override;
+		virtual void draw(const TransientBuffer& vertices, uint32_t vertexCount) override;
+		virtual void drawIndexed(const TransientBuffer& vertices, const TransientBuffer& indices, uint32_t indexCount) override;
+		virtual void drawIndexed(const TransientBuffer& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount) override;
+		virtual void drawIndexed(const Ref<VertexArena>& arena, const ArenaSlice& vertices, const Ref<IndexBuffer>& indexBuffer, uint32_t indexCount, uint32_t firstIndex) override;
+
+		virtual TransientBuffer allocateTransient(uint32_t size, BufferUsage usage) override;
 
 		virtual void beginTransfer() override;
 		virtual void submitTransfer(PipelineStages graphicsWaitStage) override;
@@ -34,6 +48,7 @@ namespace Shadow
 		virtual void beginCompute(const Ref<ComputePipeline>& pipe, uint32_t descriptorSet, const void* pPushConstants) override;
 		virtual void submitCompute(PipelineStages graphicsWaitStage) override;
 		virtual void dispatch(uint32_t groupX, uint32_t groupY, uint32_t groupZ) override;
+		virtual void computeBarrier() override;
 
 		virtual void acquireFromGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages dstStage, AccessFlags dstAccess) override;
 		virtual void releaseToGraphicsQueue(const Ref<StorageBuffer>& buffer, PipelineStages srcStage, AccessFlags srcAccess) override;
@@ -51,10 +66,14 @@ namespace Shadow
 		VkCommandBuffer beginSingleTimeCmdBuffer(uint32_t submitQueueIndex);
 		void submitSingleTimeCmdBuffer(VkCommandBuffer cmdBuffer, uint32_t submitQueueIndex);
 
+		inline VulkanRingBuffer& getRingBuffer() const { return *m_ringBuffer; }
+
 		inline VkCommandPool getGraphicsCmdPool() const { return m_graphics.cmdPool; }
 		inline VkCommandPool getComputeCmdPool() const { return m_compute.cmdPool; }
 
 		inline VkCommandBuffer getGraphicsCmdBuffer() const { return m_graphics.cmdBuffers[m_currentFrame]; }
+		// secondary command buffer of the calling thread if it is recording one, primary graphics command buffer otherwise
+		VkCommandBuffer getRecordingCmdBuffer() const;
 		inline VkCommandBuffer getComputeCmdBuffer() const { return m_compute.cmdBuffers[m_currentFrame]; }
 		inline VkCommandBuffer getTransferCmdBuffer() const { return m_transfer.cmdBuffers[m_currentFrame]; }
 
@@ -66,9 +85,19 @@ namespace Shadow
 		void createCmdBuffers();
 		void createCmdBufferPools();
 		void createSyncObjects();
+		void createSecondaryCmdPools();
+
+		void bindGraphicsPipeline(VkCommandBuffer cmdBuffer, const Ref<GraphicsPipeline>& pipe, const void* pPushConstants) const;
+
+		// the next submitted frame waits (on the gpu) for the uploads of the resources it draws with
+		void useUploads(UploadTicket ticket) const;
+		template<typename... Tickets>
+		void useUploads(UploadTicket ticket, Tickets... tickets) const { useUploads(ticket); useUploads(tickets...); }
 	private:
 		uint32_t m_currentFrame = 0;
 
+		Scope<VulkanRingBuffer> m_ringBuffer;
+
 		struct Graphics
 		{
 			VkCommandPool cmdPool;
@@ -105,5 +134,22 @@ namespace Shadow
 			std::array<VkSemaphore, VulkanDevice::s_maxFramesInFlight> completeSemaphores;
 			std::array<VkFence, VulkanDevice::s_maxFramesInFlight> inFlightFences;
 		} m_compute;
+
+		// one per recording thread, see getRecorderIndex()
+		struct SecondaryRecorder
+		{
+			std::array<VkCommandPool, VulkanDevice::s_maxFramesInFlight> cmdPools;
+			std::array<std::vector<VkCommandBuffer>, VulkanDevice::s_maxFramesInFlight> cmdBuffers;
+			std::array<uint32_t, VulkanDevice::s_maxFramesInFlight> usedCount{};
+			VkCommandBuffer recording = VK_NULL_HANDLE;
+			uint32_t order = 0;
+		};
+		std::vector<SecondaryRecorder> m_secondaryRecorders;
+
+		std::mutex m_secondaryMutex;
+		std::vector<std::pair<uint32_t, VkCommandBuffer>> m_recordedSecondaries;
+
+		VkViewport m_viewport{};
+		VkRect2D m_scissor{};
 	};
 }
\ No newline at end of file
@@ -37,6 +37,11 @@ namespace Shadow
 	{
 	}
 
+	VulkanContext::VulkanContext(uint32_t headlessWidth, uint32_t headlessHeight)
+		: m_headlessExtent{ headlessWidth, headlessHeight }
+	{
+	}
+
 	VulkanContext::~VulkanContext()
 	{
 		delete m_vkDevice;
@@ -65,7 +70,10 @@ namespace Shadow
 		createInstance();
 
 		m_vkDevice = new VulkanDevice(m_vkInstance, m_windowHandle, s_layers);
-		m_vkDevice->init(m_windowHandle);
+		if (m_windowHandle)
+			m_vkDevice->init(m_windowHandle);
+		else
+			m_vkDevice->initHeadless(m_headlessExtent);
 
 		SH_TRACE("initialized Vulkan Context >*<");
 	}
@@ -155,9 +163,15 @@ namespace Shadow
 
 	std::vector<const char*> VulkanContext::getRequiredExtensions() const
 	{
-		uint32_t glfwExtensionCount = 0;
-		const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-		std::vector<const char*> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		std::vector<const char*> extensions;
+
+		// a headless context has no surface, so it doesn't need the window system extensions
+		if (m_windowHandle)
+		{
+			uint32_t glfwExtensionCount = 0;
+			const char** glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+			extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+		}
 
 		bool extsSupported = extensionsSupported(extensions);
 		SH_ASSERT(extsSupported, "extension is not present ;<");
@@ -19,6 +19,7 @@ namespace Shadow
 	{
 	public:
 		VulkanContext(GLFWwindow* windowHandle);
+		VulkanContext(uint32_t headlessWidth, uint32_t headlessHeight);
 		virtual ~VulkanContext();
 
 		virtual void init() override;
@@ -37,7 +38,8 @@ namespace Shadow
 	private:
 		inline static VulkanContext* s_vkCtx{ nullptr };
 
-		GLFWwindow* m_windowHandle;
+		GLFWwindow* m_windowHandle = nullptr;
+		VkExtent2D m_headlessExtent{};
 		VkInstance m_vkInstance;
 		VkDebugUtilsMessengerEXT m_debugMessenger;
 		bool m_validationEnabled;
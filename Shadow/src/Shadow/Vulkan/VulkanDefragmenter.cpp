@@ -0,0 +1,586 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
+#include "Shadow/Vulkan/VulkanDevice.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+
+namespace Shadow
+{
+	static void imageBarrier(VkCommandBuffer cmdBuffer, VkImage image, uint8_t mipLevels,
+		VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+		VkImageLayout oldLayout, VkImageLayout newLayout,
+		uint32_t srcQueueFamily = VK_QUEUE_FAMILY_IGNORED, uint32_t dstQueueFamily = VK_QUEUE_FAMILY_IGNORED)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.srcQueueFamilyIndex = srcQueueFamily;
+		barrier.dstQueueFamilyIndex = dstQueueFamily;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	VulkanDefragmenter::VulkanDefragmenter(VulkanDevice* device)
+		: m_device(device), m_dedicatedTransfer(device->hasDedicatedTransferQueue())
+	{
+		VkDevice vkDevice = device->getVkDevice();
+
+		VkCommandPoolCreateInfo cmdPoolInfo{};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		cmdPoolInfo.queueFamilyIndex = device->getGraphicsQueueIndex();
+		VK_CHECK_RESULT(vkCreateCommandPool(vkDevice, &cmdPoolInfo, nullptr, &m_graphicsCmdPool));
+
+		VkCommandBufferAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocInfo.commandBufferCount = 1;
+		allocInfo.commandPool = m_graphicsCmdPool;
+
+		if (m_dedicatedTransfer)
+		{
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(vkDevice, &allocInfo, &m_releaseCmdBuffer));
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(vkDevice, &allocInfo, &m_acquireCmdBuffer));
+
+			cmdPoolInfo.queueFamilyIndex = device->getTransferQueueIndex();
+			VK_CHECK_RESULT(vkCreateCommandPool(vkDevice, &cmdPoolInfo, nullptr, &m_transferCmdPool));
+			allocInfo.commandPool = m_transferCmdPool;
+		}
+
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(vkDevice, &allocInfo, &m_copyCmdBuffer));
+
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+		VK_CHECK_RESULT(vkCreateSemaphore(vkDevice, &semaphoreInfo, nullptr, &m_timeline));
+	}
+
+	VulkanDefragmenter::~VulkanDefragmenter()
+	{
+		// the device is idle by now
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+
+			if (m_passOpen)
+				endPass();
+			if (m_context != VK_NULL_HANDLE)
+				endRun();
+		}
+
+		VkDevice vkDevice = m_device->getVkDevice();
+
+		vkDestroySemaphore(vkDevice, m_timeline, nullptr);
+		vkDestroyCommandPool(vkDevice, m_graphicsCmdPool, nullptr);
+		if (m_dedicatedTransfer)
+			vkDestroyCommandPool(vkDevice, m_transferCmdPool, nullptr);
+	}
+
+	void VulkanDefragmenter::registerBuffer(VmaAllocation allocation, VkBuffer* pBuffer, VkDeviceSize size, VkBufferUsageFlags usage, const UploadTicket* pUploadTicket)
+	{
+		Resource resource;
+		resource.pBuffer = pBuffer;
+		resource.pUploadTicket = pUploadTicket;
+		resource.size = size;
+		resource.bufferUsage = usage;
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_resources[allocation] = resource;
+	}
+
+	void VulkanDefragmenter::registerImage(VulkanImage* pImage, VkFormat format, uint32_t width, uint32_t height, uint8_t mipLevels,
+		VkImageUsageFlags usage, const UploadTicket* pUploadTicket, uint32_t* pHeapIndex, VkSampler sampler)
+	{
+		Resource resource;
+		resource.pImage = pImage;
+		resource.pUploadTicket = pUploadTicket;
+		resource.format = format;
+		resource.width = width;
+		resource.height = height;
+		resource.mipLevels = mipLevels;
+		resource.imageUsage = usage;
+		resource.pHeapIndex = pHeapIndex;
+		resource.sampler = sampler;
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_resources[pImage->allocation] = resource;
+		m_relocatableViews.insert(pImage->imageView);
+	}
+
+	void VulkanDefragmenter::unregister(VmaAllocation allocation)
+	{
+		if (allocation == VK_NULL_HANDLE)
+			return;
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		auto it = m_resources.find(allocation);
+		if (it == m_resources.end())
+			return;
+
+		if (it->second.pImage)
+			m_relocatableViews.erase(it->second.pImage->imageView);
+		m_resources.erase(it);
+	}
+
+	VmaAllocation VulkanDefragmenter::release(VmaAllocation allocation)
+	{
+		if (allocation == VK_NULL_HANDLE)
+			return allocation;
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		if (!m_passOpen)
+			return allocation;
+
+		// VMA frees the allocation (and the place it was supposed to move to) when the pass ends
+		for (uint32_t i = 0; i < m_pass.moveCount; i++)
+		{
+			if (m_pass.pMoves[i].srcAllocation == allocation)
+			{
+				m_pass.pMoves[i].operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+				return VK_NULL_HANDLE;
+			}
+		}
+
+		return allocation;
+	}
+
+	void VulkanDefragmenter::trackImageDescriptor(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type, const VkDescriptorImageInfo& imageInfo)
+	{
+		const DescriptorKey key{ set, binding, arrayElement };
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		// a slot that gets overwritten with an image that never moves doesn't need to be known anymore
+		if (m_relocatableViews.count(imageInfo.imageView))
+			m_imageDescriptors[key] = { type, imageInfo };
+		else
+			m_imageDescriptors.erase(key);
+	}
+
+	void VulkanDefragmenter::untrackDescriptorSet(VkDescriptorSet set)
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		auto it = m_imageDescriptors.lower_bound(DescriptorKey{ set, 0, 0 });
+		while (it != m_imageDescriptors.end() && std::get<0>(it->first) == set)
+			it = m_imageDescriptors.erase(it);
+	}
+
+	void VulkanDefragmenter::request()
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_requested = true;
+	}
+
+	void VulkanDefragmenter::beginFrame(uint32_t frameIndex)
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		if (m_passOpen)
+		{
+			// the frame that waited for the copies has to be done before the old handles and the old memory go
+			if (frameIndex != m_passFrame || getFrameWait() != 0)
+				return;
+
+			endPass();
+		}
+
+		if (m_context == VK_NULL_HANDLE)
+		{
+			if (!m_requested)
+			{
+				if (--m_framesUntilCheck > 0)
+					return;
+				m_framesUntilCheck = s_checkInterval;
+
+				VkDeviceSize wastedBytes;
+				if (getFragmentation(&wastedBytes) < s_fragmentationThreshold || wastedBytes < s_minWastedBytes)
+					return;
+			}
+
+			m_requested = false;
+			beginRun();
+		}
+
+		beginPass(frameIndex);
+	}
+
+	uint64_t VulkanDefragmenter::getFrameWait()
+	{
+		if (m_passWait == 0)
+			return 0;
+
+		uint64_t value;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValue(m_device->getVkDevice(), m_timeline, &value));
+		return value >= m_passWait ? 0 : m_passWait;
+	}
+
+	GpuDefragmentationStats VulkanDefragmenter::getStats()
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		return m_stats;
+	}
+
+	void VulkanDefragmenter::beginRun()
+	{
+		VmaDefragmentationInfo info{};
+		info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+		info.maxBytesPerPass = s_bytesPerPass;
+		info.maxAllocationsPerPass = s_allocationsPerPass;
+		VK_CHECK_RESULT(vmaBeginDefragmentation(m_device->getVmaAllocator(), &info, &m_context));
+
+		m_stats.running = true;
+		m_stats.fragmentationBefore = getFragmentation(nullptr);
+		SH_TRACE("gpu memory defragmentation started, fragmentation %.1f%%", m_stats.fragmentationBefore * 100.0f);
+	}
+
+	void VulkanDefragmenter::endRun()
+	{
+		VmaDefragmentationStats stats{};
+		vmaEndDefragmentation(m_device->getVmaAllocator(), m_context, &stats);
+		m_context = VK_NULL_HANDLE;
+
+		m_stats.running = false;
+		m_stats.runs++;
+		m_stats.bytesMoved += stats.bytesMoved;
+		m_stats.bytesFreed += stats.bytesFreed;
+		m_stats.allocationsMoved += stats.allocationsMoved;
+		m_stats.fragmentationAfter = getFragmentation(nullptr);
+
+		SH_TRACE("gpu memory defragmentation finished: %u allocations (%llu MB) moved, %llu MB freed, fragmentation %.1f%% -> %.1f%%",
+			stats.allocationsMoved, static_cast<unsigned long long>(stats.bytesMoved >> 20), static_cast<unsigned long long>(stats.bytesFreed >> 20),
+			m_stats.fragmentationBefore * 100.0f, m_stats.fragmentationAfter * 100.0f);
+	}
+
+	void VulkanDefragmenter::beginPass(uint32_t frameIndex)
+	{
+		SH_PROFILE_FUNCTION();
+
+		VmaAllocator allocator = m_device->getVmaAllocator();
+
+		// VK_SUCCESS -> nothing left to move
+		if (vmaBeginDefragmentationPass(allocator, m_context, &m_pass) == VK_SUCCESS)
+		{
+			endRun();
+			return;
+		}
+
+		// unknown resources (ring buffers, staging, render targets...) stay where they are, so do the ones still being uploaded
+		// and the images shader sets point at
+		VulkanUploadManager& uploads = m_device->getUploadManager();
+		std::vector<std::pair<VmaDefragmentationMove*, Resource*>> moves;
+
+		for (uint32_t i = 0; i < m_pass.moveCount; i++)
+		{
+			VmaDefragmentationMove& move = m_pass.pMoves[i];
+			auto it = m_resources.find(move.srcAllocation);
+
+			if (it == m_resources.end() || !uploads.isComplete(*it->second.pUploadTicket) ||
+				(it->second.pImage && isInDescriptorSet(it->second.pImage->imageView)))
+				move.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			else
+				moves.emplace_back(&move, &it->second);
+		}
+
+		if (moves.empty())
+		{
+			vmaEndDefragmentationPass(allocator, m_context, &m_pass);
+			endRun();
+			return;
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		// the previous pass has been waited for
+		vkResetCommandBuffer(m_copyCmdBuffer, 0);
+		vkBeginCommandBuffer(m_copyCmdBuffer, &beginInfo);
+		if (m_dedicatedTransfer)
+		{
+			vkResetCommandBuffer(m_releaseCmdBuffer, 0);
+			vkResetCommandBuffer(m_acquireCmdBuffer, 0);
+			vkBeginCommandBuffer(m_releaseCmdBuffer, &beginInfo);
+			vkBeginCommandBuffer(m_acquireCmdBuffer, &beginInfo);
+		}
+
+		m_passMoves.clear();
+		m_passMoves.reserve(moves.size());
+
+		for (auto& [pMove, pResource] : moves)
+		{
+			PassMove& passMove = m_passMoves.emplace_back();
+
+			if (pResource->pBuffer)
+				moveBuffer(*pMove, *pResource, passMove);
+			else
+				moveImage(*pMove, *pResource, passMove);
+		}
+
+		submitPass();
+
+		m_passOpen = true;
+		m_passFrame = frameIndex;
+	}
+
+	void VulkanDefragmenter::endPass()
+	{
+		VkDevice vkDevice = m_device->getVkDevice();
+
+		for (PassMove& move : m_passMoves)
+		{
+			if (move.oldBuffer != VK_NULL_HANDLE)
+				vkDestroyBuffer(vkDevice, move.oldBuffer, nullptr);
+			if (move.oldImageView != VK_NULL_HANDLE)
+				vkDestroyImageView(vkDevice, move.oldImageView, nullptr);
+			if (move.oldImage != VK_NULL_HANDLE)
+				vkDestroyImage(vkDevice, move.oldImage, nullptr);
+		}
+		m_passMoves.clear();
+
+		// the moved allocations now point at their new place, the old one is freed
+		const VkResult result = vmaEndDefragmentationPass(m_device->getVmaAllocator(), m_context, &m_pass);
+		m_passOpen = false;
+
+		if (result == VK_SUCCESS)
+			endRun();
+	}
+
+	void VulkanDefragmenter::moveBuffer(const VmaDefragmentationMove& move, Resource& resource, PassMove& passMove)
+	{
+		VkBufferCreateInfo bufferCI{};
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.size = resource.size;
+		bufferCI.usage = resource.bufferUsage;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkBuffer newBuffer;
+		VK_CHECK_RESULT(vkCreateBuffer(m_device->getVkDevice(), &bufferCI, nullptr, &newBuffer));
+		VK_CHECK_RESULT(vmaBindBufferMemory(m_device->getVmaAllocator(), move.dstTmpAllocation, newBuffer));
+
+		const VkBuffer oldBuffer = *resource.pBuffer;
+
+		VkBufferCopy region{};
+		region.size = resource.size;
+
+		if (m_dedicatedTransfer)
+		{
+			const uint32_t graphicsFamily = m_device->getGraphicsQueueIndex();
+			const uint32_t transferFamily = m_device->getTransferQueueIndex();
+
+			m_device->bufferMemoryBarrier(m_releaseCmdBuffer, oldBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, graphicsFamily, transferFamily);
+			m_device->bufferMemoryBarrier(m_copyCmdBuffer, oldBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT, graphicsFamily, transferFamily);
+
+			vkCmdCopyBuffer(m_copyCmdBuffer, oldBuffer, newBuffer, 1, &region);
+
+			m_device->bufferMemoryBarrier(m_copyCmdBuffer, newBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferFamily, graphicsFamily);
+			m_device->bufferMemoryBarrier(m_acquireCmdBuffer, newBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, VK_ACCESS_MEMORY_READ_BIT, transferFamily, graphicsFamily);
+		}
+		else
+		{
+			m_device->bufferMemoryBarrier(m_copyCmdBuffer, oldBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT);
+
+			vkCmdCopyBuffer(m_copyCmdBuffer, oldBuffer, newBuffer, 1, &region);
+
+			m_device->bufferMemoryBarrier(m_copyCmdBuffer, newBuffer, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_MEMORY_READ_BIT);
+		}
+
+		// the frames recorded from now on use the new buffer, they wait for the copy
+		passMove.oldBuffer = oldBuffer;
+		*resource.pBuffer = newBuffer;
+	}
+
+	void VulkanDefragmenter::moveImage(const VmaDefragmentationMove& move, Resource& resource, PassMove& passMove)
+	{
+		VkImageCreateInfo imageInfo{};
+		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+		imageInfo.imageType = VK_IMAGE_TYPE_2D;
+		imageInfo.extent.width = resource.width;
+		imageInfo.extent.height = resource.height;
+		imageInfo.extent.depth = 1;
+		imageInfo.mipLevels = resource.mipLevels;
+		imageInfo.arrayLayers = 1;
+		imageInfo.format = resource.format;
+		imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+		imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		imageInfo.usage = resource.imageUsage;
+		imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+		imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VkImage newImage;
+		VK_CHECK_RESULT(vkCreateImage(m_device->getVkDevice(), &imageInfo, nullptr, &newImage));
+		VK_CHECK_RESULT(vmaBindImageMemory(m_device->getVmaAllocator(), move.dstTmpAllocation, newImage));
+		const VkImageView newImageView = m_device->createImageView(newImage, resource.format, VK_IMAGE_ASPECT_COLOR_BIT, resource.mipLevels);
+
+		const VkImage oldImage = resource.pImage->vkImage;
+		const VkImageView oldImageView = resource.pImage->imageView;
+		const uint8_t mips = resource.mipLevels;
+
+		std::vector<VkImageCopy> regions(mips);
+		for (uint32_t mip = 0; mip < mips; mip++)
+		{
+			VkImageCopy& region = regions[mip];
+			region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+			region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip, 0, 1 };
+			region.extent = { std::max(1u, resource.width >> mip), std::max(1u, resource.height >> mip), 1 };
+		}
+
+		if (m_dedicatedTransfer)
+		{
+			const uint32_t graphicsFamily = m_device->getGraphicsQueueIndex();
+			const uint32_t transferFamily = m_device->getTransferQueueIndex();
+
+			imageBarrier(m_releaseCmdBuffer, oldImage, mips, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, graphicsFamily, transferFamily);
+			imageBarrier(m_copyCmdBuffer, oldImage, mips, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, graphicsFamily, transferFamily);
+			imageBarrier(m_copyCmdBuffer, newImage, mips, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+			vkCmdCopyImage(m_copyCmdBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, regions.data());
+
+			imageBarrier(m_copyCmdBuffer, newImage, mips, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, 0,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transferFamily, graphicsFamily);
+			imageBarrier(m_acquireCmdBuffer, newImage, mips, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, transferFamily, graphicsFamily);
+		}
+		else
+		{
+			imageBarrier(m_copyCmdBuffer, oldImage, mips, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_READ_BIT,
+				VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+			imageBarrier(m_copyCmdBuffer, newImage, mips, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+				VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+
+			vkCmdCopyImage(m_copyCmdBuffer, oldImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, newImage, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mips, regions.data());
+
+			imageBarrier(m_copyCmdBuffer, newImage, mips, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+				VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		}
+
+		// the heap slot of the old view may be sampled by the frames in flight, the new view gets a slot of its own.
+		// the old slot is retired in this frame, like the old image once the pass ends
+		if (resource.pHeapIndex && *resource.pHeapIndex != VulkanTextureHeap::s_invalidIndex)
+			*resource.pHeapIndex = m_device->getTextureHeap().replace(*resource.pHeapIndex, newImageView, resource.sampler);
+
+		m_relocatableViews.erase(oldImageView);
+		m_relocatableViews.insert(newImageView);
+
+		passMove.oldImage = oldImage;
+		passMove.oldImageView = oldImageView;
+		resource.pImage->vkImage = newImage;
+		resource.pImage->imageView = newImageView;
+	}
+
+	void VulkanDefragmenter::submitPass()
+	{
+		SH_PROFILE_FUNCTION();
+
+		vkEndCommandBuffer(m_copyCmdBuffer);
+		if (m_dedicatedTransfer)
+		{
+			vkEndCommandBuffer(m_releaseCmdBuffer);
+			vkEndCommandBuffer(m_acquireCmdBuffer);
+		}
+
+		// one timeline value per submission, each one waits for the one before
+		auto submit = [this](VkQueue queue, VkCommandBuffer cmdBuffer, bool waitForPrevious)
+			{
+				VkSemaphoreSubmitInfo waitInfo{};
+				waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+				waitInfo.semaphore = m_timeline;
+				waitInfo.value = m_timelineValue;
+				waitInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+				VkSemaphoreSubmitInfo signalInfo{};
+				signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+				signalInfo.semaphore = m_timeline;
+				signalInfo.value = ++m_timelineValue;
+				signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+				VkCommandBufferSubmitInfo cmdSubmit{};
+				cmdSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+				cmdSubmit.commandBuffer = cmdBuffer;
+
+				VkSubmitInfo2 submitInfo{};
+				submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+				submitInfo.commandBufferInfoCount = 1;
+				submitInfo.pCommandBufferInfos = &cmdSubmit;
+				submitInfo.waitSemaphoreInfoCount = waitForPrevious ? 1 : 0;
+				submitInfo.pWaitSemaphoreInfos = &waitInfo;
+				submitInfo.signalSemaphoreInfoCount = 1;
+				submitInfo.pSignalSemaphoreInfos = &signalInfo;
+				VK_CHECK_RESULT(vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			};
+
+		{
+			std::scoped_lock<std::mutex> queueLock(m_device->getQueueMutex());
+
+			if (m_dedicatedTransfer)
+			{
+				submit(m_device->getGraphicsQueue(), m_releaseCmdBuffer, false);
+				submit(m_device->getTransferQueue(), m_copyCmdBuffer, true);
+				submit(m_device->getGraphicsQueue(), m_acquireCmdBuffer, true);
+			}
+			else
+				submit(m_device->getGraphicsQueue(), m_copyCmdBuffer, false);
+		}
+
+		m_passWait = m_timelineValue;
+	}
+
+	bool VulkanDefragmenter::isInDescriptorSet(VkImageView imageView) const
+	{
+		for (const auto& [key, descriptor] : m_imageDescriptors)
+		{
+			if (descriptor.second.imageView == imageView)
+				return true;
+		}
+
+		return false;
+	}
+
+	float VulkanDefragmenter::getFragmentation(VkDeviceSize* pWastedBytes) const
+	{
+		const VkPhysicalDeviceMemoryProperties* pMemoryProperties;
+		vmaGetMemoryProperties(m_device->getVmaAllocator(), &pMemoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(m_device->getVmaAllocator(), budgets);
+
+		VkDeviceSize blockBytes = 0, allocationBytes = 0;
+		for (uint32_t i = 0; i < pMemoryProperties->memoryHeapCount; i++)
+		{
+			if (pMemoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT)
+			{
+				blockBytes += budgets[i].statistics.blockBytes;
+				allocationBytes += budgets[i].statistics.allocationBytes;
+			}
+		}
+
+		if (pWastedBytes)
+			*pWastedBytes = blockBytes - allocationBytes;
+
+		return blockBytes ? 1.0f - static_cast<float>(allocationBytes) / blockBytes : 0.0f;
+	}
+}
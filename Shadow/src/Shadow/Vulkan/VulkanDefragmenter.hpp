@@ -0,0 +1,134 @@
+#pragma once
+
+#include "Shadow/Renderer/Buffer.hpp"
+#include "Shadow/Renderer/GpuMemoryStats.hpp"
+#include "Shadow/Vulkan/VulkanImage.hpp"
+
+#include <vma/vk_mem_alloc.h>
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Shadow
+{
+	class VulkanDevice;
+
+	// incremental defragmentation of the VMA pools. a run is started by hand (Renderer::defragmentMemory) or once the device local
+	// heaps have fragmented, it then moves at most s_bytesPerPass per frame. only resources that registered themselves are moved,
+	// the copies run on the transfer queue (if there is a dedicated one) and the frame waits for them on the gpu.
+	// the handles of a moved resource are swapped for the new ones right away and a moved texture gets a new texture heap index,
+	// the frames in flight keep using the old handles and the old heap slot. those go once the frame that waited for the copies
+	// has finished. descriptors can't be rewritten while pending frames use them, so images that shader sets point at aren't moved
+	class VulkanDefragmenter
+	{
+	public:
+		VulkanDefragmenter(VulkanDevice* device);
+		~VulkanDefragmenter();
+		VulkanDefragmenter(const VulkanDefragmenter& other) = delete;
+		VulkanDefragmenter& operator=(const VulkanDefragmenter& other) = delete;
+
+		// the resource can be moved once its upload has completed. the pointers have to stay valid until the resource is retired.
+		// *pHeapIndex (texture heap, with sampler) is replaced when the image moves
+		void registerBuffer(VmaAllocation allocation, VkBuffer* pBuffer, VkDeviceSize size, VkBufferUsageFlags usage, const UploadTicket* pUploadTicket);
+		void registerImage(VulkanImage* pImage, VkFormat format, uint32_t width, uint32_t height, uint8_t mipLevels,
+			VkImageUsageFlags usage, const UploadTicket* pUploadTicket, uint32_t* pHeapIndex, VkSampler sampler);
+		// the owner is going away (VulkanDevice::retire*)
+		void unregister(VmaAllocation allocation);
+		// the allocation is about to be freed. VK_NULL_HANDLE -> it is part of the running pass (moved or not), VMA frees it with the pass
+		VmaAllocation release(VmaAllocation allocation);
+
+		// shader descriptor sets that point at an image, the image stays where it is while any of them does
+		void trackImageDescriptor(VkDescriptorSet set, uint32_t binding, uint32_t arrayElement, VkDescriptorType type, const VkDescriptorImageInfo& imageInfo);
+		void untrackDescriptorSet(VkDescriptorSet set);
+
+		// starts a run unless one is running already
+		void request();
+
+		// frame thread, after the retired resources of frameIndex have been destroyed. the render thread is idle
+		void beginFrame(uint32_t frameIndex);
+		// frame thread. value of the timeline semaphore the next frame has to wait for, 0 if nothing
+		uint64_t getFrameWait();
+		inline VkSemaphore getTimelineSemaphore() const { return m_timeline; }
+
+		GpuDefragmentationStats getStats();
+	public:
+		static constexpr VkDeviceSize s_bytesPerPass = 16ull << 20;
+		static constexpr uint32_t s_allocationsPerPass = 64;
+		static constexpr uint32_t s_checkInterval = 600;              // frames between the fragmentation checks
+		static constexpr float s_fragmentationThreshold = 0.3f;       // share of the device local blocks that isn't handed out
+		static constexpr VkDeviceSize s_minWastedBytes = 64ull << 20; // below this a run isn't worth it
+	private:
+		struct Resource
+		{
+			VkBuffer* pBuffer = nullptr;
+			VulkanImage* pImage = nullptr;
+			const UploadTicket* pUploadTicket = nullptr;
+
+			VkDeviceSize size = 0;
+			VkBufferUsageFlags bufferUsage = 0;
+
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0, height = 0;
+			uint8_t mipLevels = 1;
+			VkImageUsageFlags imageUsage = 0;
+			uint32_t* pHeapIndex = nullptr;
+			VkSampler sampler = VK_NULL_HANDLE;
+		};
+
+		// everything the pass has to clean up once the copies have been waited for
+		struct PassMove
+		{
+			VkBuffer oldBuffer = VK_NULL_HANDLE;
+			VkImage oldImage = VK_NULL_HANDLE;
+			VkImageView oldImageView = VK_NULL_HANDLE;
+		};
+
+		// m_mutex has to be held by the callers of these
+		void beginRun();
+		void endRun();
+		void beginPass(uint32_t frameIndex);
+		void endPass();
+		void moveBuffer(const VmaDefragmentationMove& move, Resource& resource, PassMove& passMove);
+		void moveImage(const VmaDefragmentationMove& move, Resource& resource, PassMove& passMove);
+		void submitPass();
+		bool isInDescriptorSet(VkImageView imageView) const;
+		float getFragmentation(VkDeviceSize* pWastedBytes) const;
+	private:
+		VulkanDevice* m_device;
+		bool m_dedicatedTransfer;
+
+		std::unordered_map<VmaAllocation, Resource> m_resources;
+		std::unordered_set<VkImageView> m_relocatableViews;
+
+		using DescriptorKey = std::tuple<VkDescriptorSet, uint32_t, uint32_t>; // set, binding, array element
+		std::map<DescriptorKey, std::pair<VkDescriptorType, VkDescriptorImageInfo>> m_imageDescriptors;
+
+		VmaDefragmentationContext m_context = VK_NULL_HANDLE;
+		bool m_requested = false;
+		uint32_t m_framesUntilCheck = s_checkInterval;
+
+		// the running pass
+		VmaDefragmentationPassMoveInfo m_pass{};
+		bool m_passOpen = false;
+		uint32_t m_passFrame = 0;
+		std::vector<PassMove> m_passMoves;
+
+		// release on the graphics queue, copy on the transfer queue, acquire on the graphics queue (only the middle one without a transfer queue)
+		VkCommandPool m_graphicsCmdPool = VK_NULL_HANDLE;
+		VkCommandPool m_transferCmdPool = VK_NULL_HANDLE;
+		VkCommandBuffer m_releaseCmdBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer m_copyCmdBuffer = VK_NULL_HANDLE;
+		VkCommandBuffer m_acquireCmdBuffer = VK_NULL_HANDLE;
+
+		VkSemaphore m_timeline = VK_NULL_HANDLE;
+		uint64_t m_timelineValue = 0; // last value signaled by a pass
+		uint64_t m_passWait = 0;
+
+		GpuDefragmentationStats m_stats;
+
+		std::mutex m_mutex;
+	};
+}
@@ -3,12 +3,15 @@
 
 #include "Shadow/Renderer/Renderer.hpp"
 #include "Shadow/Vulkan/VulkanDevice.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
 #include "Shadow/Vulkan/VulkanRenderpass.hpp"
 #include "Shadow/Vulkan/ShadowToVulkanTypes.hpp"
 #include "Shadow/Vulkan/VulkanBuffer.hpp"
 #include "Shadow/Vulkan/VkTexture.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
 
 #include <GLFW/glfw3.h>
 
@@ -23,6 +26,9 @@ namespace Shadow
 
 	static std::mutex s_deviceMutex;
 
+	// staging memory for resource uploads that are in flight at the same time
+	static constexpr VkDeviceSize s_uploadStagingSize = 64 * 1024 * 1024;
+
 
 	static bool hasStencilComponent(VkFormat format)
 	{
@@ -30,6 +36,31 @@ namespace Shadow
 			format == VK_FORMAT_D24_UNORM_S8_UINT;
 	}
 
+	static bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extension)
+	{
+		uint32_t extCount = 0;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extCount, nullptr);
+		std::vector<VkExtensionProperties> availableExts(extCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extCount, availableExts.data());
+
+		return std::find_if(availableExts.cbegin(), availableExts.cend(),
+			[extension](const VkExtensionProperties& ext) { return !strcmp(extension, ext.extensionName); }) != availableExts.cend();
+	}
+
+	static GpuMemoryCategory getBufferCategory(VkBufferUsageFlags usage)
+	{
+		if (usage & VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT)
+			return GpuMemoryCategory::Uniforms;
+		if (usage & VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)
+			return GpuMemoryCategory::Storage;
+		if (usage & (VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT))
+			return GpuMemoryCategory::Geometry;
+		if (usage & VK_BUFFER_USAGE_TRANSFER_SRC_BIT)
+			return GpuMemoryCategory::Staging;
+
+		return GpuMemoryCategory::Geometry;
+	}
+
 	static bool isDepthFormat(VkFormat format)
 	{
 		return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT|| format == VK_FORMAT_D32_SFLOAT;
@@ -42,21 +73,35 @@ namespace Shadow
 	{
 		SH_PROFILE_RENDERER_FUNCTION();
 
-		createSurface(windowHandle);
+		if (windowHandle)
+			createSurface(windowHandle);
 		pickPhysicalDevice();
 		createLogicalDevice(validationLayers);
 		createVmaAllocator();
+
+		// the upload manager frees its staging through the defragmenter
+		m_defragmenter = createScope<VulkanDefragmenter>(this);
+		m_textureHeap = createScope<VulkanTextureHeap>(this);
+		m_uploadManager = createScope<VulkanUploadManager>(this, s_uploadStagingSize);
 	}
 
 	VulkanDevice::~VulkanDevice()
 	{
 		vkDeviceWaitIdle(m_vkDevice);
 
+		m_uploadManager.reset();
 		delete m_swapchain;
 
+		for (uint32_t i = 0; i < s_maxFramesInFlight; i++)
+			destroyRetired(i);
+		m_textureHeap.reset();
+		m_defragmenter.reset();
+
 		vmaDestroyAllocator(m_vmaAllocator);
 		vkDestroyDevice(m_vkDevice, nullptr);
-		vkDestroySurfaceKHR(m_vulkanInstance, m_surface, nullptr);
+
+		if (m_surface != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(m_vulkanInstance, m_surface, nullptr);
 	}
 
 	void VulkanDevice::init(GLFWwindow* windowHandle)
@@ -64,7 +109,12 @@ namespace Shadow
 		m_swapchain = new Swapchain(windowHandle, m_surface);
 	}
 
-	void VulkanDevice::allocateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer* buffer, VmaAllocation* allocation) const
+	void VulkanDevice::initHeadless(VkExtent2D extent)
+	{
+		m_swapchain = new Swapchain(extent);
+	}
+
+	void VulkanDevice::allocateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer* buffer, VmaAllocation* allocation)
 	{
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -76,6 +126,7 @@ namespace Shadow
 		allocInfo.usage = memoryUsage;
 
 		VK_CHECK_RESULT(vmaCreateBuffer(m_vmaAllocator, &bufferInfo, &allocInfo, buffer, allocation, VK_NULL_HANDLE));
+		trackAllocation(*allocation, getBufferCategory(usage));
 	}
 
 	void VulkanDevice::allocateImage(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling tiling,
@@ -103,11 +154,211 @@ namespace Shadow
 		vmaallocInfo.requiredFlags = VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
 		VK_CHECK_RESULT(vmaCreateImage(m_vmaAllocator, &imageInfo, &vmaallocInfo, &outImage.vkImage, &outImage.allocation, &outImage.allocationInfo));
+		trackAllocation(outImage.allocation, (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) ?
+			GpuMemoryCategory::RenderTargets : GpuMemoryCategory::Textures);
 
 		outImage.imageView = createImageView(outImage.vkImage, imageFormat,
 			isDepthFormat(imageFormat) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
 	}
 
+	void VulkanDevice::trackAllocation(VmaAllocation allocation, GpuMemoryCategory category)
+	{
+		// the category rides along in the allocation's user data (+1, so untagged allocations stay recognizable)
+		vmaSetAllocationUserData(m_vmaAllocator, allocation, reinterpret_cast<void*>(static_cast<uintptr_t>(category) + 1));
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(m_vmaAllocator, allocation, &info);
+
+		const size_t index = static_cast<size_t>(category);
+		m_memory.categoryBytes[index].fetch_add(info.size, std::memory_order_relaxed);
+		m_memory.categoryAllocations[index].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	void VulkanDevice::untrackAllocation(VmaAllocation allocation)
+	{
+		if (allocation == VK_NULL_HANDLE)
+			return;
+
+		VmaAllocationInfo info;
+		vmaGetAllocationInfo(m_vmaAllocator, allocation, &info);
+
+		const uintptr_t tag = reinterpret_cast<uintptr_t>(info.pUserData);
+		if (tag == 0)
+			return;
+
+		m_memory.categoryBytes[tag - 1].fetch_sub(info.size, std::memory_order_relaxed);
+		m_memory.categoryAllocations[tag - 1].fetch_sub(1, std::memory_order_relaxed);
+	}
+
+	void VulkanDevice::destroyBuffer(VkBuffer buffer, VmaAllocation allocation)
+	{
+		untrackAllocation(allocation);
+		vmaDestroyBuffer(m_vmaAllocator, buffer, m_defragmenter->release(allocation));
+	}
+
+	void VulkanDevice::trackReclaimed(ReclaimedMemory reclaimed, uint64_t bytes)
+	{
+		m_memory.reclaimedBytes[static_cast<size_t>(reclaimed)].fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	GpuMemoryStats VulkanDevice::getMemoryStats() const
+	{
+		GpuMemoryStats stats;
+		stats.budgetQueried = m_memory.budgetExtension;
+
+		for (size_t i = 0; i < stats.categoryBytes.size(); i++)
+		{
+			stats.categoryBytes[i] = m_memory.categoryBytes[i].load(std::memory_order_relaxed);
+			stats.categoryAllocations[i] = m_memory.categoryAllocations[i].load(std::memory_order_relaxed);
+		}
+
+		for (size_t i = 0; i < stats.reclaimedBytes.size(); i++)
+			stats.reclaimedBytes[i] = m_memory.reclaimedBytes[i].load(std::memory_order_relaxed);
+
+		stats.defragmentation = m_defragmenter->getStats();
+
+		const VkPhysicalDeviceMemoryProperties* pMemoryProperties;
+		vmaGetMemoryProperties(m_vmaAllocator, &pMemoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(m_vmaAllocator, budgets);
+
+		stats.heapCount = pMemoryProperties->memoryHeapCount;
+		for (uint32_t i = 0; i < stats.heapCount; i++)
+		{
+			GpuHeapStats& heap = stats.heaps[i];
+			heap.usage = budgets[i].usage;
+			heap.budget = budgets[i].budget;
+			heap.blockBytes = budgets[i].statistics.blockBytes;
+			heap.allocationBytes = budgets[i].statistics.allocationBytes;
+			heap.deviceLocal = (pMemoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		}
+
+		return stats;
+	}
+
+	void VulkanDevice::checkMemoryBudget()
+	{
+		const VkPhysicalDeviceMemoryProperties* pMemoryProperties;
+		vmaGetMemoryProperties(m_vmaAllocator, &pMemoryProperties);
+
+		VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+		vmaGetHeapBudgets(m_vmaAllocator, budgets);
+
+		for (uint32_t i = 0; i < pMemoryProperties->memoryHeapCount; i++)
+		{
+			if (budgets[i].budget == 0)
+				continue;
+
+			const double usage = static_cast<double>(budgets[i].usage) / budgets[i].budget;
+			uint8_t& warnLevel = m_memory.heapWarnLevels[i];
+
+			// warned once per crossing, the level only drops again with some headroom so it doesn't flicker
+			if (usage >= 1.0 && warnLevel < 2)
+			{
+				SH_ERROR("memory heap %u is over its budget: %llu MB of %llu MB :(", i,
+					static_cast<unsigned long long>(budgets[i].usage >> 20), static_cast<unsigned long long>(budgets[i].budget >> 20));
+				warnLevel = 2;
+			}
+			else if (usage >= 0.9 && warnLevel < 1)
+			{
+				SH_WARN("memory heap %u is close to its budget: %llu MB of %llu MB :<", i,
+					static_cast<unsigned long long>(budgets[i].usage >> 20), static_cast<unsigned long long>(budgets[i].budget >> 20));
+				warnLevel = 1;
+			}
+			else if (usage < 0.85)
+			{
+				warnLevel = 0;
+			}
+		}
+	}
+
+	void VulkanDevice::retireBuffer(VkBuffer buffer, VmaAllocation allocation)
+	{
+		if (buffer == VK_NULL_HANDLE)
+			return;
+
+		m_defragmenter->unregister(allocation);
+
+		std::scoped_lock<std::mutex> lock(m_retireMutex);
+		m_retired[m_currentFrame].buffers.emplace_back(buffer, allocation);
+	}
+
+	void VulkanDevice::retireImage(VkImage image, VkImageView imageView, VmaAllocation allocation)
+	{
+		if (image == VK_NULL_HANDLE && imageView == VK_NULL_HANDLE)
+			return;
+
+		m_defragmenter->unregister(allocation);
+
+		std::scoped_lock<std::mutex> lock(m_retireMutex);
+		m_retired[m_currentFrame].images.push_back({ image, imageView, allocation });
+	}
+
+	void VulkanDevice::retireSampler(VkSampler sampler)
+	{
+		if (sampler == VK_NULL_HANDLE)
+			return;
+
+		std::scoped_lock<std::mutex> lock(m_retireMutex);
+		m_retired[m_currentFrame].samplers.push_back(sampler);
+	}
+
+	void VulkanDevice::retireDescriptorPool(VkDescriptorPool descriptorPool)
+	{
+		if (descriptorPool == VK_NULL_HANDLE)
+			return;
+
+		std::scoped_lock<std::mutex> lock(m_retireMutex);
+		m_retired[m_currentFrame].descriptorPools.push_back(descriptorPool);
+	}
+
+	void VulkanDevice::beginFrame(uint32_t frameIndex)
+	{
+		{
+			std::scoped_lock<std::mutex> lock(m_retireMutex);
+
+			// the frame that used frameIndex before has finished, so did every frame before it
+			destroyRetired(frameIndex);
+			m_currentFrame = frameIndex;
+
+			// lets VMA refresh the budget it got from VK_EXT_memory_budget
+			vmaSetCurrentFrameIndex(m_vmaAllocator, ++m_frameNumber);
+			checkMemoryBudget();
+		}
+
+		m_textureHeap->beginFrame(frameIndex);
+		m_defragmenter->beginFrame(frameIndex);
+	}
+
+	void VulkanDevice::destroyRetired(uint32_t frameIndex)
+	{
+		RetiredResources& retired = m_retired[frameIndex];
+
+		for (auto& [buffer, allocation] : retired.buffers)
+			destroyBuffer(buffer, allocation);
+
+		for (RetiredImage& image : retired.images)
+		{
+			if (image.imageView != VK_NULL_HANDLE)
+				vkDestroyImageView(m_vkDevice, image.imageView, nullptr);
+
+			untrackAllocation(image.allocation);
+			vmaDestroyImage(m_vmaAllocator, image.image, m_defragmenter->release(image.allocation));
+		}
+
+		for (VkSampler sampler : retired.samplers)
+			vkDestroySampler(m_vkDevice, sampler, nullptr);
+
+		for (VkDescriptorPool descriptorPool : retired.descriptorPools)
+			vkDestroyDescriptorPool(m_vkDevice, descriptorPool, nullptr);
+
+		retired.buffers.clear();
+		retired.images.clear();
+		retired.samplers.clear();
+		retired.descriptorPools.clear();
+	}
+
 	VkImageView VulkanDevice::createImageView(VkImage image, VkFormat format, VkImageAspectFlagBits aspectFlags, uint8_t mipLevels) const
 	{
 		VkImageViewCreateInfo createInfo{};
@@ -253,12 +504,12 @@ namespace Shadow
 		}
 	}
 
-	void VulkanDevice::copyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height)
+	void VulkanDevice::copyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height, VkDeviceSize srcOffset)
 	{
 		SH_PROFILE_FUNCTION();
 
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = srcOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 		region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -387,6 +638,10 @@ namespace Shadow
 		descriptorFeatures.descriptorBindingUniformBufferUpdateAfterBind = VK_TRUE;
 		descriptorFeatures.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
 		descriptorFeatures.descriptorBindingStorageImageUpdateAfterBind = VK_TRUE;
+		// the texture heap (VulkanTextureHeap)
+		descriptorFeatures.runtimeDescriptorArray = VK_TRUE;
+		descriptorFeatures.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+		descriptorFeatures.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
 		descriptorFeatures.pNext = &timelineSemaphoreFeatures;
 
 		VkPhysicalDeviceFeatures deviceFeatures{};
@@ -397,8 +652,14 @@ namespace Shadow
 		createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
 		createInfo.pQueueCreateInfos = queueCreateInfos.data();
 		createInfo.pEnabledFeatures = &deviceFeatures;
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(s_deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = s_deviceExtensions.data();
+		// VK_EXT_memory_budget is optional, VMA estimates the budget without it
+		std::vector<const char*> extensions = s_deviceExtensions;
+		m_memory.budgetExtension = isDeviceExtensionSupported(m_physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+		if (m_memory.budgetExtension)
+			extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+		createInfo.ppEnabledExtensionNames = extensions.data();
 		createInfo.pNext = &descriptorFeatures;
 
 #ifdef SH_DEBUG 
@@ -434,7 +695,7 @@ namespace Shadow
 	void VulkanDevice::createVmaAllocator()
 	{
 		VmaAllocatorCreateInfo allocatorCreateInfo{};
-		allocatorCreateInfo.flags = VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+		allocatorCreateInfo.flags = m_memory.budgetExtension ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0;
 		allocatorCreateInfo.vulkanApiVersion = VK_API_VERSION_1_2;
 		allocatorCreateInfo.instance = VulkanContext::getVkInstance();
 		allocatorCreateInfo.physicalDevice = m_physicalDevice;
@@ -480,7 +741,11 @@ namespace Shadow
 			{
 				m_graphics.graphicsQueue.index = i;
 
-				vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupported);
+				// without a surface nothing is presented, the graphics queue stands in for the present queue
+				if (m_surface != VK_NULL_HANDLE)
+					vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupported);
+				else
+					presentSupported = VK_TRUE;
 
 				if (presentSupported)
 					m_graphics.presentQueue.index = i;
@@ -3,14 +3,22 @@
 #include "Shadow/Vulkan/Swapchain.hpp"
 #include "Shadow/Vulkan/VulkanImage.hpp"
 #include "Shadow/Renderer/Pipeline.hpp"
+#include "Shadow/Renderer/GpuMemoryStats.hpp"
 
 #include <vma/vk_mem_alloc.h>
 
+#include <array>
+#include <atomic>
+#include <mutex>
+
 struct GLFWwindow;
 
 namespace Shadow
 {
 	enum class ImageFormat;
+	class VulkanUploadManager;
+	class VulkanDefragmenter;
+	class VulkanTextureHeap;
 
 	class VulkanDevice
 	{
@@ -19,6 +27,7 @@ namespace Shadow
 		~VulkanDevice();
 
 		void init(GLFWwindow* windowHandle);
+		void initHeadless(VkExtent2D extent);
 
 		inline void waitIdle() const { vkDeviceWaitIdle(m_vkDevice); }
 
@@ -35,16 +44,44 @@ namespace Shadow
 		void generateMipmaps(VkCommandBuffer cmdBuffer, VkImage image, VkFormat format, int width, int height, uint8_t mipLevels);
 		VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlagBits aspectFlags, uint8_t mipLevels) const;
 
-		void copyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height);
+		void copyBufferToImage(VkCommandBuffer cmdBuffer, VkBuffer srcBuffer, VkImage dstImage, uint32_t width, uint32_t height, VkDeviceSize srcOffset = 0);
 		void copyBufferToBuffer(VkCommandBuffer cmdBuffer,VkBuffer src, VkBuffer dst, VkDeviceSize size, uint32_t srcOffset, uint32_t dstOffset);
 
 		uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
 		VkFormat findSupportedFormat(const std::set<VkFormat>& candidates, VkImageTiling tiling,
 			VkFormatFeatureFlags features) const;
 
-		void allocateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer* buffer, VmaAllocation* allocation) const;
+		// the memory category of buffers and images is derived from their usage flags
+		void allocateBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VkBuffer* buffer, VmaAllocation* allocation);
 		void allocateImage(uint32_t width, uint32_t height, VkFormat imageFormat, VkImageTiling tiling,
 			VkImageUsageFlags usage, uint8_t mipLevels, VulkanImage& outImage);
+		// allocations that don't come from allocateBuffer/allocateImage have to be tagged by hand to show up in the memory stats
+		void trackAllocation(VmaAllocation allocation, GpuMemoryCategory category);
+		// frees right away, the gpu must not use the buffer anymore (single time uploads that have been waited for)
+		void destroyBuffer(VkBuffer buffer, VmaAllocation allocation);
+
+		// adds to the reclaimed totals of the memory stats
+		void trackReclaimed(ReclaimedMemory reclaimed, uint64_t bytes);
+		GpuMemoryStats getMemoryStats() const;
+
+		// the frames in flight may still read a resource that gets destroyed mid-frame. it is retired with the frame
+		// that is recorded at the moment and freed once the fence of that frame has signaled, the caller never waits on the gpu
+		void retireBuffer(VkBuffer buffer, VmaAllocation allocation);
+		void retireImage(VkImage image, VkImageView imageView, VmaAllocation allocation);
+		void retireSampler(VkSampler sampler);
+		void retireDescriptorPool(VkDescriptorPool descriptorPool);
+
+		// frame thread, right after the fence of frameIndex has signaled
+		void beginFrame(uint32_t frameIndex);
+
+		// staged resource uploads, see VulkanUploadManager
+		inline VulkanUploadManager& getUploadManager() const { return *m_uploadManager; }
+		// moves registered resources to defragment the memory, see VulkanDefragmenter
+		inline VulkanDefragmenter& getDefragmenter() const { return *m_defragmenter; }
+		// bindless descriptors of every sampled texture, see VulkanTextureHeap
+		inline VulkanTextureHeap& getTextureHeap() const { return *m_textureHeap; }
+		// queues are externally synchronized, uploads are submitted from any thread
+		inline std::mutex& getQueueMutex() { return m_queueMutex; }
 
 		inline bool hasDedicatedComputeQueue() const { return m_graphics.graphicsQueue.index != m_compute.queue.index; }
 		inline bool hasDedicatedTransferQueue() const { return m_graphics.graphicsQueue.index != m_transfer.queue.index; }
@@ -53,6 +90,7 @@ namespace Shadow
 		inline VmaAllocator getVmaAllocator() const { return m_vmaAllocator; }
 		inline VkPhysicalDevice getPhysicalDevice() const { return m_physicalDevice; }
 		inline Swapchain* getSwapchain() const { return m_swapchain; }
+		inline bool isHeadless() const { return m_surface == VK_NULL_HANDLE; }
 
 		inline uint32_t getGraphicsQueueIndex() const { return m_graphics.graphicsQueue.index; }
 		inline uint32_t getPresentQueueIndex() const { return m_graphics.presentQueue.index; }
@@ -77,16 +115,54 @@ namespace Shadow
 
 		void findQueueFamilies(VkPhysicalDevice device);
 		bool queueFamilyIndicesComplete() const;
+
+		void destroyRetired(uint32_t frameIndex);
+		void untrackAllocation(VmaAllocation allocation);
+		void checkMemoryBudget();
 	private:
 		uint32_t m_currentFrame = 0;
+		uint32_t m_frameNumber = 0;
+
+		struct RetiredImage
+		{
+			VkImage image;
+			VkImageView imageView;
+			VmaAllocation allocation;
+		};
+
+		// cleared, never shrunk, so retiring doesn't allocate once the frames have settled
+		struct RetiredResources
+		{
+			std::vector<std::pair<VkBuffer, VmaAllocation>> buffers;
+			std::vector<RetiredImage> images;
+			std::vector<VkSampler> samplers;
+			std::vector<VkDescriptorPool> descriptorPools;
+		};
+
+		std::array<RetiredResources, s_maxFramesInFlight> m_retired;
+		std::mutex m_retireMutex; // resources are destroyed on the frame thread, the render thread and in jobs
+
+		Scope<VulkanUploadManager> m_uploadManager;
+		Scope<VulkanDefragmenter> m_defragmenter;
+		Scope<VulkanTextureHeap> m_textureHeap;
+		std::mutex m_queueMutex;
+
+		struct MemoryTracking
+		{
+			std::array<std::atomic<uint64_t>, static_cast<size_t>(GpuMemoryCategory::Count)> categoryBytes{};
+			std::array<std::atomic<uint32_t>, static_cast<size_t>(GpuMemoryCategory::Count)> categoryAllocations{};
+			std::array<std::atomic<uint64_t>, static_cast<size_t>(ReclaimedMemory::Count)> reclaimedBytes{};
+			std::array<uint8_t, GpuMemoryStats::s_maxHeaps> heapWarnLevels{}; // 0 fine, 1 close to the budget, 2 over it
+			bool budgetExtension = false;
+		} m_memory;
 
 		const VkInstance m_vulkanInstance;
 		VkPhysicalDevice m_physicalDevice = VK_NULL_HANDLE;
 		VkDevice m_vkDevice;
 		VmaAllocator m_vmaAllocator;
 
-		VkSurfaceKHR m_surface;
-		Swapchain* m_swapchain;
+		VkSurfaceKHR m_surface = VK_NULL_HANDLE;
+		Swapchain* m_swapchain = nullptr;
 
 		struct VulkanQueue
 		{
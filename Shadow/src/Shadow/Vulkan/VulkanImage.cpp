@@ -6,19 +6,15 @@ namespace Shadow
 {
 	VulkanImage::~VulkanImage()
 	{
-		if (imageView != VK_NULL_HANDLE)
-			vkDestroyImageView(VulkanContext::getVulkanDevice()->getVkDevice(), imageView, nullptr);
-
-		vmaDestroyImage(VulkanContext::getVulkanDevice()->getVmaAllocator(), vkImage, allocation);
+		deallocate();
 	}
 
 	void VulkanImage::deallocate()
 	{
-		vkDeviceWaitIdle(VulkanContext::getVulkanDevice()->getVkDevice());
-
-		if (imageView != VK_NULL_HANDLE)
-			vkDestroyImageView(VulkanContext::getVulkanDevice()->getVkDevice(), imageView, nullptr);
+		VulkanContext::getVulkanDevice()->retireImage(vkImage, imageView, allocation);
 
-		vmaDestroyImage(VulkanContext::getVulkanDevice()->getVmaAllocator(), vkImage, allocation);
+		vkImage = VK_NULL_HANDLE;
+		imageView = VK_NULL_HANDLE;
+		allocation = VK_NULL_HANDLE;
 	}
-}
\ No newline at end of file
+}
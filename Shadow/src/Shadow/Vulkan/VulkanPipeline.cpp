@@ -16,7 +16,7 @@
 namespace Shadow
 {
 	VulkanGraphicsPipeline::VulkanGraphicsPipeline(const GraphicsPipeConfiguration& config, VkPipelineRenderingCreateInfo* pInfo)
-		: m_config(config), m_renderpass(as<VulkanRenderpass>(config.renderpass))
+		: m_config(config), m_renderpass(config.renderpass)
 	{
 		SH_ASSERT(!(!config.useDynamicRendering && !config.renderpass), "");
 		SH_ASSERT(config.shader, "graphics pipeline creation has been failed: shader that had been passed to create a graphics pipeline was nullptr :(");
@@ -42,7 +42,7 @@ namespace Shadow
 		VkPipelineViewportStateCreateInfo viewportState{};
 		initViewportState(&viewportState);
 
-		std::vector<VkDynamicState> dynamicStates =
+		std::array<VkDynamicState, 2> dynamicStates =
 		{VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
 
 		VkPipelineDynamicStateCreateInfo dynamicState{};
@@ -53,8 +53,8 @@ namespace Shadow
 		dynamicState.flags = 0;
 
 		uint16_t location = 0;
-		std::vector<VkVertexInputBindingDescription> bindingDescriptions;
-		std::vector<VkVertexInputAttributeDescription> vertAttribDescriptions;
+		FrameVector<VkVertexInputBindingDescription> bindingDescriptions;
+		FrameVector<VkVertexInputAttributeDescription> vertAttribDescriptions;
 
 		processVertexDescription(config.vertexInput, 0, location,
 			bindingDescriptions, vertAttribDescriptions, VK_VERTEX_INPUT_RATE_VERTEX);
@@ -81,7 +81,7 @@ namespace Shadow
 		VkPipelineDepthStencilStateCreateInfo depthStencil{};
 		depthStencil.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
 		depthStencil.depthTestEnable = VK_TRUE;
-		depthStencil.depthWriteEnable = VK_TRUE;
+		depthStencil.depthWriteEnable = config.states.depthWriteEnable ? VK_TRUE : VK_FALSE;
 		depthStencil.depthCompareOp = VK_COMPARE_OP_LESS;
 		depthStencil.depthBoundsTestEnable = VK_FALSE;
 		depthStencil.stencilTestEnable = VK_FALSE;
@@ -123,6 +123,15 @@ namespace Shadow
 		vkDestroyPipeline(pVkDevice->getVkDevice(), m_pipeline, nullptr);
 	}
 
+	uint32_t VulkanGraphicsPipeline::getPushConstantsSize() const
+	{
+		uint32_t size = 0;
+		for (auto& range : m_pushConstantRanges)
+			size += range.size;
+
+		return size;
+	}
+
 	void VulkanGraphicsPipeline::setSubpassInput(const std::string& uniformName, uint32_t inputAttachment)
 	{
 		SH_PROFILE_FUNCTION();
@@ -147,7 +156,8 @@ namespace Shadow
 
 	void VulkanGraphicsPipeline::setRenderpassInput(const std::string& shaderName, uint32_t imageIndex, const Ref<Renderpass>& src)
 	{
-		auto texture = as<VulkanTexture2D>(src->getOutput(imageIndex));
+		Ref<Texture2D> output = src->getOutput(imageIndex);
+		VulkanTexture2D* texture = as<VulkanTexture2D>(output);
 		auto& samplerRes = m_config.shader->getResource(shaderName);
 
 		VkDescriptorImageInfo imageInfo{};
@@ -165,10 +175,15 @@ namespace Shadow
 		writer.pImageInfo = &imageInfo;
 		vkUpdateDescriptorSets(VulkanContext::getVulkanDevice()->getVkDevice(), 1, &writer, 0, nullptr);
 
-		m_renderpassInputs[shaderName] = texture;
+		m_renderpassInputs[shaderName] = std::move(output);
+	}
+
+	uint32_t VulkanGraphicsPipeline::getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const
+	{
+		return as<VulkanShader>(m_config.shader)->getDynamicOffsets(set, pOffsets);
 	}
 
-	void VulkanGraphicsPipeline::createPipelineLayout(Ref<VulkanShader> shader)
+	void VulkanGraphicsPipeline::createPipelineLayout(VulkanShader* shader)
 	{
 		if (shader)
 		{
@@ -178,6 +193,7 @@ namespace Shadow
 			m_pushConstantRanges = shader->getPushConstantRanges();
 			m_descriptorSets.array = shader->getDescriptorSets();
 			m_descriptorSets.size = usedSets.size();
+			m_usesTextureHeap = shader->usesTextureHeap();
 
 			VkPipelineLayoutCreateInfo pipeLayoutInfo{};
 			pipeLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -262,8 +278,8 @@ namespace Shadow
 
 	void VulkanGraphicsPipeline::processVertexDescription(const VertexInput* const description,
 		uint16_t binding, uint16_t& offsetLocation,
-		std::vector<VkVertexInputBindingDescription>& bindingDescriptions,
-		std::vector<VkVertexInputAttributeDescription>& vertAttribDescriptions,
+		FrameVector<VkVertexInputBindingDescription>& bindingDescriptions,
+		FrameVector<VkVertexInputAttributeDescription>& vertAttribDescriptions,
 		VkVertexInputRate inputRate)
 	{
 		if (description)
@@ -302,6 +318,7 @@ namespace Shadow
 	}
 
 	VulkanComputePipeline::VulkanComputePipeline(const Ref<Shader>& computeShader)
+		: m_shader(computeShader)
 	{
 		SH_ASSERT((computeShader->getStages() & ShaderStage::Compute), "failed to create a compute pipeline with a non-compute shader D:");
 
@@ -330,6 +347,20 @@ namespace Shadow
 		vkDestroyPipeline(device, m_pipeline, nullptr);
 	}
 
+	uint32_t VulkanComputePipeline::getPushConstantsSize() const
+	{
+		uint32_t size = 0;
+		for (auto& range : m_pushConstantRanges)
+			size += range.size;
+
+		return size;
+	}
+
+	uint32_t VulkanComputePipeline::getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const
+	{
+		return as<VulkanShader>(m_shader)->getDynamicOffsets(set, pOffsets);
+	}
+
 	void VulkanComputePipeline::createPipelineLayout(const Ref<Shader>& shader)
 	{
 		if (shader)
@@ -341,6 +372,7 @@ namespace Shadow
 			m_descriptorSets.array = vkShader->getDescriptorSets();
 			m_descriptorSets.size = usedSets.size();
 			m_pushConstantRanges = vkShader->getPushConstantRanges();
+			m_usesTextureHeap = vkShader->usesTextureHeap();
 
 			VkPipelineLayoutCreateInfo pipeLayoutCI{};
 			pipeLayoutCI.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Shadow/Renderer/Pipeline.hpp"
+#include "Shadow/Core/FrameAllocator.hpp"
 
 #include<vulkan/vulkan.h>
 #include<array>
@@ -21,16 +22,21 @@ namespace Shadow
 		virtual void setRenderpassInput(const std::string& shaderName, uint32_t imageIndex, const Ref<Renderpass>& src) override;
 
 		virtual const GraphicsPipeConfiguration& getConfiguration() const { return m_config; }
+		virtual uint32_t getPushConstantsSize() const override;
 
 		inline const Ref<VulkanRenderpass>& getVkRenderpass() const { return m_renderpass; }
 		inline const VkPipeline getVkPipeline() const { return m_pipeline; }
 		inline const Array<VkDescriptorSet, 4>& getDescriptorSets() const { return m_descriptorSets; }
 		inline const VkPipelineLayout getLayout() const { return m_pipeLayout; }
 		inline const std::vector<VkPushConstantRange>& getPushConstantRanges() const { return m_pushConstantRanges; }
+		inline bool usesTextureHeap() const { return m_usesTextureHeap; }
+
+		// executing thread, see VulkanShader::getDynamicOffsets()
+		uint32_t getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const;
 	private:
 		bool onWindowResized(const WindowResizedEvent& e);
 
-		void createPipelineLayout(Ref<VulkanShader> shader);
+		void createPipelineLayout(VulkanShader* shader);
 
 		void initViewportState(VkPipelineViewportStateCreateInfo* outViewportState) const;
 		void initColorBlendAttachmentState(const GraphicsPipeConfiguration& config, VkPipelineColorBlendAttachmentState* outAttachment) const;
@@ -45,8 +51,8 @@ namespace Shadow
 
 		void processVertexDescription(const VertexInput* const description,
 			uint16_t binding, uint16_t& offsetLocation,
-			std::vector<VkVertexInputBindingDescription>& bindingDescriptions, 
-			std::vector<VkVertexInputAttributeDescription>& vertAttribDescriptions,
+			FrameVector<VkVertexInputBindingDescription>& bindingDescriptions, 
+			FrameVector<VkVertexInputAttributeDescription>& vertAttribDescriptions,
 			VkVertexInputRate inputRate);
 	private:
 		GraphicsPipeConfiguration m_config;
@@ -57,6 +63,7 @@ namespace Shadow
 
 		Array<VkDescriptorSet, 4> m_descriptorSets;
 		std::vector<VkPushConstantRange> m_pushConstantRanges;
+		bool m_usesTextureHeap = false;
 
 		Array<InputAttachment, 5> m_inputAttachments;
 		std::unordered_map<std::string, Ref<Texture2D>> m_renderpassInputs;
@@ -68,17 +75,26 @@ namespace Shadow
 		VulkanComputePipeline(const Ref<Shader>& computeShader);
 		virtual ~VulkanComputePipeline();
 
+		virtual uint32_t getPushConstantsSize() const override;
+
 		inline VkPipeline getVkPipeline() const { return m_pipeline; }
 		inline VkPipelineLayout getLayout() const { return m_layout; }
 		inline const Array<VkDescriptorSet, 4>& getDescriptorSets() const { return m_descriptorSets; }
 		inline const std::vector<VkPushConstantRange>& getPushConstantRanges() const { return m_pushConstantRanges; }
+		inline bool usesTextureHeap() const { return m_usesTextureHeap; }
+
+		// executing thread, see VulkanShader::getDynamicOffsets()
+		uint32_t getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const;
 	private:
 		void createPipelineLayout(const Ref<Shader>& shader);
 	private:
+		Ref<Shader> m_shader;
+
 		VkPipeline m_pipeline;
 		VkPipelineLayout m_layout;
 
 		Array<VkDescriptorSet, 4> m_descriptorSets;
 		std::vector<VkPushConstantRange> m_pushConstantRanges;
+		bool m_usesTextureHeap = false;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+
+#include "Shadow/Vulkan/VulkanRingBuffer.hpp"
+#include "Shadow/Vulkan/VulkanDevice.hpp"
+
+namespace Shadow
+{
+	static_assert(VulkanRingBuffer::s_regionCount == VulkanDevice::s_maxFramesInFlight + 1, "the ring needs one region more than frames in flight :<");
+
+	// the cpu writes straight into the ring and the gpu reads it once, so no staging copy is involved. the best memory for that is
+	// device local and host visible (resizable BAR, the 256MB BAR window, or any memory of an integrated gpu), plain host visible
+	// memory is the fallback the gpu reads over PCIe. integrated gpus share the cpu caches, so cached memory is free there
+	static VkMemoryPropertyFlags getPreferredMemoryFlags(VkPhysicalDevice physicalDevice, const VkPhysicalDeviceProperties& properties, VkDeviceSize size)
+	{
+		VkPhysicalDeviceMemoryProperties memProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+		constexpr VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		VkMemoryPropertyFlags preferred = 0;
+
+		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
+		{
+			const VkMemoryType& type = memProperties.memoryTypes[i];
+
+			// don't crowd out everything else living in a small BAR heap
+			if ((type.propertyFlags & mappable) == mappable && memProperties.memoryHeaps[type.heapIndex].size >= size * 4)
+				preferred |= VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+		}
+
+		if (properties.deviceType == VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU)
+			preferred |= VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+		return preferred;
+	}
+
+	VulkanRingBuffer::VulkanRingBuffer(VulkanDevice* device, uint32_t regionSize)
+		: m_device(device), m_regionSize(regionSize)
+	{
+		VkPhysicalDeviceProperties properties;
+		vkGetPhysicalDeviceProperties(device->getPhysicalDevice(), &properties);
+		m_uniformAlignment = static_cast<uint32_t>(std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16));
+		m_storageAlignment = static_cast<uint32_t>(std::max<VkDeviceSize>(properties.limits.minStorageBufferOffsetAlignment, 16));
+
+		VkBufferCreateInfo bufferCI{};
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.size = static_cast<VkDeviceSize>(regionSize) * s_regionCount;
+		bufferCI.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+			VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		// coherent memory, the writes never have to be flushed
+		VmaAllocationCreateInfo allocCI{};
+		allocCI.usage = VMA_MEMORY_USAGE_UNKNOWN;
+		allocCI.requiredFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+		allocCI.preferredFlags = getPreferredMemoryFlags(device->getPhysicalDevice(), properties, bufferCI.size);
+		allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocInfo;
+		VK_CHECK_RESULT(vmaCreateBuffer(device->getVmaAllocator(), &bufferCI, &allocCI, &m_buffer, &m_allocation, &allocInfo));
+		device->trackAllocation(m_allocation, GpuMemoryCategory::Transient);
+
+		m_pMapped = static_cast<uint8_t*>(allocInfo.pMappedData);
+
+		VkMemoryPropertyFlags memoryFlags;
+		vmaGetMemoryTypeProperties(device->getVmaAllocator(), allocInfo.memoryType, &memoryFlags);
+		m_deviceLocal = memoryFlags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+
+		SH_TRACE("frame ring buffer: %u x %u bytes in memory type %u (%s%s)", s_regionCount, regionSize, allocInfo.memoryType,
+			m_deviceLocal ? "device local, host visible" : "host visible", memoryFlags & VK_MEMORY_PROPERTY_HOST_CACHED_BIT ? ", cached" : "");
+	}
+
+	VulkanRingBuffer::~VulkanRingBuffer()
+	{
+		m_device->retireBuffer(m_buffer, m_allocation);
+	}
+
+	VulkanRingBuffer::Allocation VulkanRingBuffer::allocate(uint32_t size, BufferUsage usage)
+	{
+		uint32_t alignment = 16;
+		if (usage & BufferUsage::UniformBuffer)
+			alignment = std::max(alignment, m_uniformAlignment);
+		if (usage & BufferUsage::StorageBuffer)
+			alignment = std::max(alignment, m_storageAlignment);
+
+		uint32_t head = m_head.load(std::memory_order_relaxed);
+		uint32_t offset;
+		do
+		{
+			offset = (head + alignment - 1) & ~(alignment - 1);
+			if (offset + size > m_regionSize)
+			{
+				SH_ERROR("the frame ring buffer is out of memory (%u bytes per frame) :(", m_regionSize);
+				SH_ASSERT(false, "ring buffer overflow");
+				return {};
+			}
+		} while (!m_head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+
+		Allocation allocation;
+		allocation.frame = m_frame.load(std::memory_order_relaxed);
+		allocation.buffer = m_buffer;
+		allocation.offset = static_cast<uint32_t>(allocation.frame % s_regionCount) * m_regionSize + offset;
+		allocation.pData = m_pMapped + allocation.offset;
+		return allocation;
+	}
+
+	void VulkanRingBuffer::beginFrame()
+	{
+		// the region of the new frame was last written s_regionCount frames ago, its fence has signaled by now
+		m_frame.fetch_add(1, std::memory_order_release);
+		m_head.store(0, std::memory_order_relaxed);
+	}
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include "Shadow/Renderer/Buffer.hpp"
+
+#include <vma/vk_mem_alloc.h>
+#include <atomic>
+
+namespace Shadow
+{
+	class VulkanDevice;
+
+	// one persistently mapped buffer split into s_regionCount regions. every frame bumps through its own region, which is
+	// recycled once the gpu is guaranteed to be done with it. there is one region more than frames in flight, because with
+	// the render thread the data of a frame is written while the previous frame's region is still the current one
+	class VulkanRingBuffer
+	{
+	public:
+		struct Allocation
+		{
+			VkBuffer buffer = VK_NULL_HANDLE;
+			uint32_t offset = 0;
+			void* pData = nullptr;
+			uint64_t frame = 0; // see getFrame()
+		};
+	public:
+		VulkanRingBuffer(VulkanDevice* device, uint32_t regionSize);
+		~VulkanRingBuffer();
+		VulkanRingBuffer(const VulkanRingBuffer& other) = delete;
+		VulkanRingBuffer& operator=(const VulkanRingBuffer& other) = delete;
+
+		// any thread. the alignment is derived from the usage (dynamic uniform/storage offsets have device limits)
+		Allocation allocate(uint32_t size, BufferUsage usage);
+
+		// frame thread, right after the fence wait of the new frame
+		void beginFrame();
+
+		// an allocation made at frame 'frame' can still be read by the gpu frame that is recorded at getFrame() if
+		// getFrame() - frame <= 1, older allocations may have been overwritten already
+		inline uint64_t getFrame() const { return m_frame.load(std::memory_order_acquire); }
+
+		inline VkBuffer getVkBuffer() const { return m_buffer; }
+		inline uint32_t getRegionSize() const { return m_regionSize; }
+		// false -> the gpu reads the ring over PCIe
+		inline bool isDeviceLocal() const { return m_deviceLocal; }
+	public:
+		static constexpr uint32_t s_regionCount = 3; // VulkanDevice::s_maxFramesInFlight + 1
+	private:
+		VulkanDevice* m_device;
+
+		VkBuffer m_buffer = VK_NULL_HANDLE;
+		VmaAllocation m_allocation = VK_NULL_HANDLE;
+		uint8_t* m_pMapped = nullptr;
+		bool m_deviceLocal = false;
+
+		uint32_t m_regionSize;
+		uint32_t m_uniformAlignment;
+		uint32_t m_storageAlignment;
+
+		std::atomic<uint64_t> m_frame{ 0 };
+		std::atomic<uint32_t> m_head{ 0 }; // inside the region of m_frame
+	};
+}
@@ -1,13 +1,15 @@
 #include "shpch.hpp"
 #include "Shadow/Core/Core.hpp"
 
-#include "Shadow/Renderer/Mesh.hpp"
 #include "Shadow/Renderer/Renderer.hpp"
 
 #include "Shadow/Vulkan/VulkanShader.hpp"
 #include "Shadow/Vulkan/VulkanContext.hpp"
 #include "Shadow/Vulkan/VulkanUniformBuffer.hpp"
 #include "Shadow/Vulkan/VulkanCmdBuffer.hpp"
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDefragmenter.hpp"
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
 
 #include <spirv_cross.hpp>
 #include <spirv_reflect.hpp>
@@ -36,6 +38,7 @@ namespace Shadow
 
 		retrieveShaderResources();
 		createDescriptorSetAllocator();
+		releaseShaderCode();
 	}
 
 	VulkanShader::VulkanShader(const std::string& name, const std::string computeSpv)
@@ -53,6 +56,7 @@ namespace Shadow
 
 		retrieveShaderResources();
 		createDescriptorSetAllocator();
+		releaseShaderCode();
 	}
 
 	VulkanShader::VulkanShader(const std::string& name, const std::string vertPath, const std::string& fragPath, const std::string computeSpv)
@@ -82,12 +86,16 @@ namespace Shadow
 
 		retrieveShaderResources();
 		createDescriptorSetAllocator();
+		releaseShaderCode();
 	}
 
 	VulkanShader::~VulkanShader()
 	{
 		VkDevice device = VulkanContext::getVulkanDevice()->getVkDevice();
 
+		for (uint32_t set : m_usedDescriptorSets)
+			VulkanContext::getVulkanDevice()->getDefragmenter().untrackDescriptorSet(m_descriptorSets[set]);
+
 		for (uint32_t i = 0; i < m_resources->descriptorSetLayouts.size(); i++)
 			vkDestroyDescriptorSetLayout(device, m_resources->descriptorSetLayouts[i].layout, nullptr);
 
@@ -102,27 +110,42 @@ namespace Shadow
 	void VulkanShader::writeDescriptorSet(const std::string& shaderName, const Ref<UniformBuffer>& buffer)
 	{
 		VkDevice device = VulkanContext::getVulkanDevice()->getVkDevice();
-		auto vkBuffer = as<VulkanUniformBuffer>(buffer);
 		const Resource& resource = m_resources->resources[shaderName];
 
-		VkWriteDescriptorSet writers[VulkanDevice::s_maxFramesInFlight]{};
-		VkDescriptorBufferInfo bufferInfos[VulkanDevice::s_maxFramesInFlight]{};
+		// the descriptor points at the ring buffer, the slice that holds the data of a frame is selected by the dynamic offset at bind time
+		VkDescriptorBufferInfo bufferInfo{};
+		bufferInfo.buffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer())->getRingBuffer().getVkBuffer();
+		bufferInfo.offset = 0;
+		bufferInfo.range = buffer->getSize();
 
-		for (uint32_t i = 0; i < VulkanDevice::s_maxFramesInFlight; i++)
+		VkWriteDescriptorSet writer{};
+		writer.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writer.dstSet = m_descriptorSets[resource.set];
+		writer.dstBinding = resource.binding;
+		writer.dstArrayElement = 0;
+		writer.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+		writer.descriptorCount = 1;
+		writer.pBufferInfo = &bufferInfo;
+		vkUpdateDescriptorSets(device, 1, &writer, 0, nullptr);
+
+		for (DynamicUniform& uniform : m_dynamicUniforms[resource.set])
 		{
-			bufferInfos[i].buffer = vkBuffer->getVkBuffer(i);
-			bufferInfos[i].offset = 0;
-			bufferInfos[i].range = vkBuffer->getSize();
-
-			writers[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-			writers[i].dstSet = m_descriptorSets[resource.set];
-			writers[i].dstBinding = resource.binding;
-			writers[i].dstArrayElement = 0;
-			writers[i].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-			writers[i].descriptorCount = 1;
-			writers[i].pBufferInfo = &bufferInfos[i];
+			if (uniform.binding == resource.binding)
+			{
+				uniform.buffer = buffer;
+				break;
+			}
 		}
-		vkUpdateDescriptorSets(device, VulkanDevice::s_maxFramesInFlight, writers, 0, nullptr);
+	}
+
+	uint32_t VulkanShader::getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const
+	{
+		const auto& uniforms = m_dynamicUniforms[set];
+
+		for (size_t i = 0; i < uniforms.size(); i++)
+			pOffsets[i] = uniforms[i].buffer ? as<VulkanUniformBuffer>(uniforms[i].buffer)->getDynamicOffset() : 0;
+
+		return static_cast<uint32_t>(uniforms.size());
 	}
 
 	void VulkanShader::writeDescriptorSet(const std::string& shaderName, const Ref<StorageBuffer>& buffer, bool acquireFromGraphicsQueue)
@@ -145,11 +168,15 @@ namespace Shadow
 		writer.descriptorCount = 1;
 		writer.pBufferInfo = &bufferInfo;
 		vkUpdateDescriptorSets(vulkanDevice->getVkDevice(), 1, &writer, 0, nullptr);
+		vulkanDevice->getUploadManager().use(vkBuffer->getUploadTicket());
 
 		// TEMP (acquire the buffer from the graphics queue)
 		if (acquireFromGraphicsQueue && vulkanDevice->hasDedicatedComputeQueue() && m_stages & ShaderStage::Compute)
 		{
-			Ref<VulkanCmdBuffer> renderCmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
+			// the graphics queue has to own the buffer before it can be handed over
+			vulkanDevice->getUploadManager().wait(vkBuffer->getUploadTicket());
+
+			VulkanCmdBuffer* renderCmdBuffer = as<VulkanCmdBuffer>(Renderer::getCmdBuffer());
 			VkCommandBuffer vkCmdBuffer;
 
 			VkCommandBufferAllocateInfo allocInfo{};
@@ -182,8 +209,11 @@ namespace Shadow
 			submit.pCommandBuffers = &vkCmdBuffer;
 			submit.waitSemaphoreCount = 0;
 			submit.signalSemaphoreCount = 0;
-			vkQueueSubmit(vulkanDevice->getComputeQueue(), 1, &submit, VK_NULL_HANDLE);
-			vkQueueWaitIdle(vulkanDevice->getComputeQueue());
+			{
+				std::scoped_lock<std::mutex> queueLock(vulkanDevice->getQueueMutex());
+				vkQueueSubmit(vulkanDevice->getComputeQueue(), 1, &submit, VK_NULL_HANDLE);
+				vkQueueWaitIdle(vulkanDevice->getComputeQueue());
+			}
 
 			vkFreeCommandBuffers(vulkanDevice->getVkDevice(), renderCmdBuffer->getComputeCmdPool(), 1, &vkCmdBuffer);
 		}
@@ -201,6 +231,7 @@ namespace Shadow
 		imageInfo.sampler = vkTexture->getSampler();
 
 		auto& samplerRes = m_resources->resources[name];
+		SH_ASSERT((samplerRes.set != VulkanTextureHeap::s_set), "%s is the texture heap, textures are in it from their creation :<", name.c_str());
 		VkWriteDescriptorSet descriptorWriter{};
 		descriptorWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWriter.dstSet = m_descriptorSets[samplerRes.set];
@@ -209,6 +240,9 @@ namespace Shadow
 		descriptorWriter.descriptorCount = 1;
 		descriptorWriter.pImageInfo = &imageInfo;
 		vkUpdateDescriptorSets(VulkanContext::getVulkanDevice()->getVkDevice(), 1, &descriptorWriter, 0, nullptr);
+		VulkanContext::getVulkanDevice()->getUploadManager().use(vkTexture->getUploadTicket());
+		VulkanContext::getVulkanDevice()->getDefragmenter().trackImageDescriptor(descriptorWriter.dstSet, descriptorWriter.dstBinding, 0,
+			descriptorWriter.descriptorType, imageInfo);
 	}
 
 	void VulkanShader::writeDescriptorSet(const std::string& name, const Texture2D& texture)
@@ -223,6 +257,7 @@ namespace Shadow
 		imageInfo.sampler = vkTexture.getSampler();
 		
 		auto& samplerRes = m_resources->resources[name];
+		SH_ASSERT((samplerRes.set != VulkanTextureHeap::s_set), "%s is the texture heap, textures are in it from their creation :<", name.c_str());
 		VkWriteDescriptorSet descriptorWriter{};
 		descriptorWriter.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWriter.dstSet = m_descriptorSets[samplerRes.set];
@@ -232,6 +267,9 @@ namespace Shadow
 		descriptorWriter.pImageInfo = &imageInfo;
 
 		vkUpdateDescriptorSets(VulkanContext::getVulkanDevice()->getVkDevice(), 1, &descriptorWriter, 0, nullptr);
+		VulkanContext::getVulkanDevice()->getUploadManager().use(vkTexture.getUploadTicket());
+		VulkanContext::getVulkanDevice()->getDefragmenter().trackImageDescriptor(descriptorWriter.dstSet, descriptorWriter.dstBinding, 0,
+			descriptorWriter.descriptorType, imageInfo);
 		vkDeviceWaitIdle(VulkanContext::getVulkanDevice()->getVkDevice());
 	}
 
@@ -240,7 +278,10 @@ namespace Shadow
 		SH_PROFILE_FUNCTION();
 
 		auto& samplerRes = m_resources->resources[name];
-		VkDescriptorImageInfo imageInfos[32]{};
+		SH_ASSERT((samplerRes.set != VulkanTextureHeap::s_set), "%s is the texture heap, textures are in it from their creation :<", name.c_str());
+		// the slot count of a sampler array comes from the shader and the device limits
+		std::vector<VkDescriptorImageInfo> imageInfos(count);
+		VulkanUploadManager& uploads = VulkanContext::getVulkanDevice()->getUploadManager();
 
 		for (uint32_t i = 0; i < count; i++)
 		{
@@ -248,6 +289,7 @@ namespace Shadow
 			imageInfos[i].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
 			imageInfos[i].imageView = vkTexture->getImage().imageView;
 			imageInfos[i].sampler = vkTexture->getSampler();
+			uploads.use(vkTexture->getUploadTicket());
 		}
 
 		VkWriteDescriptorSet descriptorWriter{};
@@ -257,18 +299,28 @@ namespace Shadow
 		descriptorWriter.dstArrayElement = dstArrIndex;
 		descriptorWriter.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
 		descriptorWriter.descriptorCount = count;
-		descriptorWriter.pImageInfo = imageInfos;
+		descriptorWriter.pImageInfo = imageInfos.data();
 
 		{
 			SH_PROFILE_SCOPE("vkUpdateDescriptorSets - VulkanShader::setInput(const std::string& name, uint32_t count, const Ref<Texture2D>* pTextures, uint32_t dstArrIndex)");
 			vkUpdateDescriptorSets(VulkanContext::getVulkanDevice()->getVkDevice(), 1, &descriptorWriter, 0, nullptr);
 		}
+
+		VulkanDefragmenter& defragmenter = VulkanContext::getVulkanDevice()->getDefragmenter();
+		for (uint32_t i = 0; i < count; i++)
+			defragmenter.trackImageDescriptor(descriptorWriter.dstSet, descriptorWriter.dstBinding, dstArrIndex + i, descriptorWriter.descriptorType, imageInfos[i]);
 	}
 
-	void VulkanShader::writeDescriptorSet(const std::string& name, const Mesh& mesh)
+	void VulkanShader::releaseShaderCode()
 	{
-		auto& textures = mesh.getTextures();
-		writeDescriptorSet(name, textures.size(), textures.data());
+		// the modules and the reflected resources are all that's needed after creation
+		const uint64_t codeBytes = (m_vertexShaderCode.capacity() + m_fragmentShaderCode.capacity() + m_computeShaderCode.capacity()) * sizeof(uint32_t);
+
+		std::vector<uint32_t>().swap(m_vertexShaderCode);
+		std::vector<uint32_t>().swap(m_fragmentShaderCode);
+		std::vector<uint32_t>().swap(m_computeShaderCode);
+
+		VulkanContext::getVulkanDevice()->trackReclaimed(ReclaimedMemory::ShaderCode, codeBytes);
 	}
 
 	void VulkanShader::retrieveShaderResources()
@@ -312,9 +364,24 @@ namespace Shadow
 			const auto& setBinding = m_resources->descriptorSetLayouts[i_layout].bindings;
 			VkDescriptorBindingFlags* bindingFlags = new VkDescriptorBindingFlags[setBinding.size()];
 
+			// dynamic uniform buffers can't live in update-after-bind layouts, the offsets are bound in binding order
+			auto& dynamicUniforms = m_dynamicUniforms[i_layout];
+			for (const VkDescriptorSetLayoutBinding& binding : setBinding)
+			{
+				const bool known = std::any_of(dynamicUniforms.begin(), dynamicUniforms.end(),
+					[&](const DynamicUniform& uniform) { return uniform.binding == binding.binding; });
+
+				if (binding.descriptorType == VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC && !known)
+					dynamicUniforms.insert(dynamicUniforms.end(), binding.descriptorCount, { binding.binding, nullptr });
+			}
+			std::stable_sort(dynamicUniforms.begin(), dynamicUniforms.end(),
+				[](const DynamicUniform& a, const DynamicUniform& b) { return a.binding < b.binding; });
+			SH_ASSERT((dynamicUniforms.size() <= s_maxDynamicUniforms), "too many uniform buffers in one descriptor set :<");
+
+			const bool updateAfterBind = dynamicUniforms.empty();
 			for (size_t i_binding = 0; i_binding < setBinding.size(); i_binding++)
 			{
-				bindingFlags[i_binding] = setBinding[i_binding].descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ?
+				bindingFlags[i_binding] = !updateAfterBind || setBinding[i_binding].descriptorType == VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT ?
 					0 : VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT;
 			}
 
@@ -327,7 +394,7 @@ namespace Shadow
 			layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
 			layoutInfo.bindingCount = static_cast<uint32_t>(setBinding.size());
 			layoutInfo.pBindings = setBinding.data();
-			layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+			layoutInfo.flags = updateAfterBind ? VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT : 0;
 			layoutInfo.pNext = &bindingFlagsCI;
 
 			VK_CHECK_RESULT(vkCreateDescriptorSetLayout(VulkanContext::getVulkanDevice()->getVkDevice(), 
@@ -361,6 +428,17 @@ namespace Shadow
 
 		m_descriptorSetAllocator = createScope<DescriptorSetAllocator>(m_resources->descriptorSetLayouts);
 		m_descriptorSetAllocator->allocateDescriptorSets(m_descriptorSets, m_setLayouts);
+
+		// the pipeline layout gets the heap's layout, the (empty) set the shader got for it is never bound
+		if (m_usesTextureHeap)
+		{
+			const VulkanTextureHeap& heap = VulkanContext::getVulkanDevice()->getTextureHeap();
+			SH_ASSERT(m_resources->descriptorSetLayouts[VulkanTextureHeap::s_set].bindings.empty(),
+				"%s: set %u belongs to the texture heap :<", m_name.c_str(), VulkanTextureHeap::s_set);
+
+			m_setLayouts[VulkanTextureHeap::s_set] = heap.getLayout();
+			m_descriptorSets[VulkanTextureHeap::s_set] = heap.getDescriptorSet();
+		}
 	}
 
 	void VulkanShader::reflect(const spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& reflResources,
@@ -388,7 +466,7 @@ namespace Shadow
 
 			VkDescriptorSetLayoutBinding uboBinding{};
 			uboBinding.binding = uboRes.binding;
-			uboBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+			uboBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
 			uboBinding.descriptorCount = uboRes.arraySize;
 			uboBinding.stageFlags |= shaderType;
 			uboBinding.pImmutableSamplers = nullptr;
@@ -412,6 +490,17 @@ namespace Shadow
 			const std::string& samplerName = compiler.get_name(sampler.id);
 			m_resources->resources[samplerName] = samplerRes;
 
+			// the set is the engine's texture heap, the shader only says it indexes it
+			if (samplerRes.set == VulkanTextureHeap::s_set)
+			{
+				SH_ASSERT((samplerRes.binding == 0 && !type.array.empty() && type.array[0] == 0),
+					"%s: the texture heap is a runtime sampler array at set %u, binding 0 :<", samplerName.c_str(), VulkanTextureHeap::s_set);
+				m_usesTextureHeap = true;
+
+				SH_TRACE("type: texture heap\n\t  name: %s\n\t  set: %u", samplerName.c_str(), samplerRes.set);
+				continue;
+			}
+
 			VkDescriptorSetLayoutBinding samplerBinding{};
 			samplerBinding.binding = compiler.get_decoration(sampler.id, spv::DecorationBinding);
 			samplerBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
@@ -51,7 +51,6 @@ namespace Shadow
 		virtual void writeDescriptorSet(const std::string& name, const Texture2D& texture) override;
 		virtual void writeDescriptorSet(const std::string& name, const Ref<Texture2D>& texture) override;
 		virtual void writeDescriptorSet(const std::string& name, uint32_t count, const Ref<Texture2D>* pTextures, uint32_t dstArrIndex = 0) override;
-		virtual void writeDescriptorSet(const std::string& name, const Mesh& mesh) override;
 
 		virtual bool isComputeShader() const override { return m_stages & ShaderStage::Compute; }
 
@@ -66,10 +65,18 @@ namespace Shadow
 		inline const std::array<VkDescriptorSet, 4>& getDescriptorSets() const { return m_descriptorSets; }
 		inline const std::array<VkDescriptorSetLayout, 4>& getDescriptorSetLayouts() const { return m_setLayouts; }
 		inline const std::vector<VkPushConstantRange>& getPushConstantRanges() const { return m_pushConstantRanges; }
+		// the shader samples the texture heap, its set is bound with the pipeline
+		inline bool usesTextureHeap() const { return m_usesTextureHeap; }
+
+		// executing thread. offsets of the uniform buffers of 'set' in the ring buffer, in the order vkCmdBindDescriptorSets expects them
+		uint32_t getDynamicOffsets(uint32_t set, uint32_t* pOffsets) const;
+	public:
+		static constexpr uint32_t s_maxDynamicUniforms = 8; // guaranteed minimum of maxDescriptorSetUniformBuffersDynamic
 	private:
 		VkShaderModule createShaderModule(const std::vector<uint32_t>& shaderCode);
 		void retrieveShaderResources();
 		void createDescriptorSetAllocator();
+		void releaseShaderCode();
 		void reflect(const spirv_cross::Compiler& compiler, spirv_cross::ShaderResources& reflResources, VkShaderStageFlagBits shaderType);
 	private:
 		std::string m_name;
@@ -79,6 +86,7 @@ namespace Shadow
 		VkShaderModule m_fragmentShaderModule = VK_NULL_HANDLE;
 		VkShaderModule m_computeShaderModule = VK_NULL_HANDLE;
 
+		// empty once the shader has been created
 		std::vector<uint32_t> m_vertexShaderCode;
 		std::vector<uint32_t> m_fragmentShaderCode;
 		std::vector<uint32_t> m_computeShaderCode;
@@ -89,7 +97,16 @@ namespace Shadow
 		std::array<VkDescriptorSet, 4> m_descriptorSets;
 		std::array<VkDescriptorSetLayout, 4> m_setLayouts;
 		std::vector<uint32_t> m_usedDescriptorSets;
+		bool m_usesTextureHeap = false;
 
 		std::vector<VkPushConstantRange> m_pushConstantRanges;
+
+		// one entry per uniform buffer descriptor (array elements included), sorted by binding
+		struct DynamicUniform
+		{
+			uint32_t binding;
+			Ref<UniformBuffer> buffer;
+		};
+		std::array<std::vector<DynamicUniform>, 4> m_dynamicUniforms;
 	};
 }
\ No newline at end of file
@@ -0,0 +1,153 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+
+#include "Shadow/Vulkan/VulkanTextureHeap.hpp"
+
+namespace Shadow
+{
+	VulkanTextureHeap::VulkanTextureHeap(VulkanDevice* device)
+		: m_device(device)
+	{
+		VkDevice vkDevice = device->getVkDevice();
+
+		VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+		indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+
+		VkPhysicalDeviceProperties2 properties{};
+		properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+		properties.pNext = &indexingProperties;
+		vkGetPhysicalDeviceProperties2(device->getPhysicalDevice(), &properties);
+
+		// a combined image sampler counts as a sampled image and as a sampler
+		m_capacity = std::min({ s_maxTextures,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+			indexingProperties.maxDescriptorSetUpdateAfterBindSamplers,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages,
+			indexingProperties.maxPerStageDescriptorUpdateAfterBindSamplers });
+
+		VkDescriptorSetLayoutBinding binding{};
+		binding.binding = 0;
+		binding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		binding.descriptorCount = m_capacity;
+		binding.stageFlags = VK_SHADER_STAGE_ALL;
+		binding.pImmutableSamplers = nullptr;
+
+		// the frames in flight never sample the slots that get written, new textures have no draws yet and removed ones wait
+		const VkDescriptorBindingFlags bindingFlags = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+			VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{};
+		bindingFlagsCI.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+		bindingFlagsCI.bindingCount = 1;
+		bindingFlagsCI.pBindingFlags = &bindingFlags;
+
+		VkDescriptorSetLayoutCreateInfo layoutInfo{};
+		layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+		layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+		layoutInfo.bindingCount = 1;
+		layoutInfo.pBindings = &binding;
+		layoutInfo.pNext = &bindingFlagsCI;
+		VK_CHECK_RESULT(vkCreateDescriptorSetLayout(vkDevice, &layoutInfo, nullptr, &m_layout));
+
+		VkDescriptorPoolSize poolSize{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, m_capacity };
+
+		VkDescriptorPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+		poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+		poolInfo.maxSets = 1;
+		poolInfo.poolSizeCount = 1;
+		poolInfo.pPoolSizes = &poolSize;
+		VK_CHECK_RESULT(vkCreateDescriptorPool(vkDevice, &poolInfo, nullptr, &m_pool));
+
+		VkDescriptorSetAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+		allocInfo.descriptorPool = m_pool;
+		allocInfo.descriptorSetCount = 1;
+		allocInfo.pSetLayouts = &m_layout;
+		VK_CHECK_RESULT(vkAllocateDescriptorSets(vkDevice, &allocInfo, &m_set));
+
+		m_freeIndices.reserve(m_capacity);
+
+		SH_TRACE("texture heap: %u textures", m_capacity);
+	}
+
+	VulkanTextureHeap::~VulkanTextureHeap()
+	{
+		// the device is idle by now
+		VkDevice vkDevice = m_device->getVkDevice();
+
+		vkDestroyDescriptorPool(vkDevice, m_pool, nullptr);
+		vkDestroyDescriptorSetLayout(vkDevice, m_layout, nullptr);
+	}
+
+	uint32_t VulkanTextureHeap::add(VkImageView imageView, VkSampler sampler)
+	{
+		uint32_t index;
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+
+			if (!m_freeIndices.empty())
+			{
+				index = m_freeIndices.back();
+				m_freeIndices.pop_back();
+			}
+			else
+			{
+				SH_ASSERT((m_nextIndex < m_capacity), "the texture heap is full (%u textures) :<", m_capacity);
+				index = m_nextIndex++;
+			}
+		}
+
+		write(index, imageView, sampler);
+		return index;
+	}
+
+	uint32_t VulkanTextureHeap::replace(uint32_t index, VkImageView imageView, VkSampler sampler)
+	{
+		const uint32_t newIndex = add(imageView, sampler);
+		remove(index);
+
+		return newIndex;
+	}
+
+	void VulkanTextureHeap::remove(uint32_t index)
+	{
+		if (index == s_invalidIndex)
+			return;
+
+		// the slot keeps pointing at the retired image, partially bound slots may do that as long as nothing samples them
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_removed[m_currentFrame].push_back(index);
+	}
+
+	void VulkanTextureHeap::beginFrame(uint32_t frameIndex)
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		// the frame that used frameIndex before has finished, nothing samples its removed slots anymore
+		m_freeIndices.insert(m_freeIndices.end(), m_removed[frameIndex].begin(), m_removed[frameIndex].end());
+		m_removed[frameIndex].clear();
+		m_currentFrame = frameIndex;
+	}
+
+	void VulkanTextureHeap::write(uint32_t index, VkImageView imageView, VkSampler sampler)
+	{
+		VkDescriptorImageInfo imageInfo{};
+		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		imageInfo.imageView = imageView;
+		imageInfo.sampler = sampler;
+
+		VkWriteDescriptorSet writer{};
+		writer.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		writer.dstSet = m_set;
+		writer.dstBinding = 0;
+		writer.dstArrayElement = index;
+		writer.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		writer.descriptorCount = 1;
+		writer.pImageInfo = &imageInfo;
+
+		// textures are created in jobs and the defragmenter replaces the slots of the images it moves, the writes to the set are serialized
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		vkUpdateDescriptorSets(m_device->getVkDevice(), 1, &writer, 0, nullptr);
+	}
+}
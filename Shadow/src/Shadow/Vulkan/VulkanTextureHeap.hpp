@@ -0,0 +1,60 @@
+#pragma once
+
+#include "Shadow/Vulkan/VulkanDevice.hpp"
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <mutex>
+#include <vector>
+
+namespace Shadow
+{
+	// one descriptor set that holds every sampled texture of the engine (descriptor indexing). a slot is written once, when its index
+	// is handed out, and never again while frames may sample it: a texture that changes its image gets a new index (replace()).
+	// shaders declare the heap as a runtime sampler array at
+	// set s_set, binding 0 and index it with what their vertex data carries. the binding is update-after-bind and partially bound:
+	// textures come and go while the set is bound and the slots nobody uses don't have to hold anything valid
+	class VulkanTextureHeap
+	{
+	public:
+		VulkanTextureHeap(VulkanDevice* device);
+		~VulkanTextureHeap();
+		VulkanTextureHeap(const VulkanTextureHeap& other) = delete;
+		VulkanTextureHeap& operator=(const VulkanTextureHeap& other) = delete;
+
+		// any thread. the index stays valid until remove()
+		uint32_t add(VkImageView imageView, VkSampler sampler);
+		// the texture has a new image (resize). returns the index of the new image, the old index is retired like remove() does:
+		// the frames in flight keep sampling the old image through it
+		uint32_t replace(uint32_t index, VkImageView imageView, VkSampler sampler);
+		// the index is handed out again once the frames that may still sample it have finished
+		void remove(uint32_t index);
+
+		// frame thread, right after the fence of frameIndex has signaled
+		void beginFrame(uint32_t frameIndex);
+
+		inline VkDescriptorSetLayout getLayout() const { return m_layout; }
+		inline VkDescriptorSet getDescriptorSet() const { return m_set; }
+		inline uint32_t getCapacity() const { return m_capacity; }
+	public:
+		static constexpr uint32_t s_set = 3; // the lower sets stay with the shaders
+		static constexpr uint32_t s_maxTextures = 16 * 1024;
+		static constexpr uint32_t s_invalidIndex = UINT32_MAX;
+	private:
+		void write(uint32_t index, VkImageView imageView, VkSampler sampler);
+	private:
+		VulkanDevice* m_device;
+		uint32_t m_capacity;
+
+		VkDescriptorPool m_pool = VK_NULL_HANDLE;
+		VkDescriptorSetLayout m_layout = VK_NULL_HANDLE;
+		VkDescriptorSet m_set = VK_NULL_HANDLE;
+
+		uint32_t m_nextIndex = 0;
+		std::vector<uint32_t> m_freeIndices;
+		std::array<std::vector<uint32_t>, VulkanDevice::s_maxFramesInFlight> m_removed;
+		uint32_t m_currentFrame = 0;
+
+		std::mutex m_mutex;
+	};
+}
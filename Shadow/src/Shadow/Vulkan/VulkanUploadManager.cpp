@@ -0,0 +1,463 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+
+#include "Shadow/Vulkan/VulkanUploadManager.hpp"
+#include "Shadow/Vulkan/VulkanDevice.hpp"
+
+namespace Shadow
+{
+	// buffer to image copies need offsets that are multiples of the texel size and of 4
+	static constexpr VkDeviceSize s_stagingAlignment = 16;
+
+	static VkSemaphore createTimelineSemaphore(VkDevice device)
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		VkSemaphore semaphore;
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &semaphore));
+		return semaphore;
+	}
+
+	// release (on the transfer queue) and acquire (on the graphics queue) of an image, both sides have to match
+	static void imageOwnershipBarrier(VkCommandBuffer cmdBuffer, VkImage image, uint8_t mipLevels,
+		VkPipelineStageFlags srcStage, VkPipelineStageFlags dstStage, VkAccessFlags srcAccessMask, VkAccessFlags dstAccessMask,
+		uint32_t srcQueueFamily, uint32_t dstQueueFamily)
+	{
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.srcAccessMask = srcAccessMask;
+		barrier.dstAccessMask = dstAccessMask;
+		barrier.srcQueueFamilyIndex = srcQueueFamily;
+		barrier.dstQueueFamilyIndex = dstQueueFamily;
+		barrier.image = image;
+		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		barrier.subresourceRange.baseMipLevel = 0;
+		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseArrayLayer = 0;
+		barrier.subresourceRange.layerCount = 1;
+		vkCmdPipelineBarrier(cmdBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+	}
+
+	VulkanUploadManager::VulkanUploadManager(VulkanDevice* device, VkDeviceSize stagingSize)
+		: m_device(device), m_dedicatedTransfer(device->hasDedicatedTransferQueue()), m_stagingSize(stagingSize)
+	{
+		VkBufferCreateInfo bufferCI{};
+		bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+		bufferCI.size = stagingSize;
+		bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+		bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+		VmaAllocationCreateInfo allocCI{};
+		allocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+		allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+		VmaAllocationInfo allocInfo;
+		VK_CHECK_RESULT(vmaCreateBuffer(device->getVmaAllocator(), &bufferCI, &allocCI, &m_stagingBuffer, &m_stagingAllocation, &allocInfo));
+		device->trackAllocation(m_stagingAllocation, GpuMemoryCategory::Staging);
+		m_pStaging = static_cast<uint8_t*>(allocInfo.pMappedData);
+
+		VkCommandPoolCreateInfo cmdPoolInfo{};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		cmdPoolInfo.queueFamilyIndex = device->getGraphicsQueueIndex();
+		VK_CHECK_RESULT(vkCreateCommandPool(device->getVkDevice(), &cmdPoolInfo, nullptr, &m_graphicsCmdPool));
+
+		if (m_dedicatedTransfer)
+		{
+			cmdPoolInfo.queueFamilyIndex = device->getTransferQueueIndex();
+			VK_CHECK_RESULT(vkCreateCommandPool(device->getVkDevice(), &cmdPoolInfo, nullptr, &m_transferCmdPool));
+			m_transferTimeline = createTimelineSemaphore(device->getVkDevice());
+		}
+
+		m_timeline = createTimelineSemaphore(device->getVkDevice());
+	}
+
+	VulkanUploadManager::~VulkanUploadManager()
+	{
+		// the device is idle by now
+		VkDevice device = m_device->getVkDevice();
+
+		for (Batch& batch : m_inFlight)
+		{
+			for (auto& [buffer, allocation] : batch.dedicatedStaging)
+				m_device->destroyBuffer(buffer, allocation);
+		}
+
+		for (auto& [buffer, allocation] : m_openBatch.dedicatedStaging)
+			m_device->destroyBuffer(buffer, allocation);
+
+		m_device->destroyBuffer(m_stagingBuffer, m_stagingAllocation);
+
+		vkDestroySemaphore(device, m_timeline, nullptr);
+		vkDestroyCommandPool(device, m_graphicsCmdPool, nullptr);
+
+		if (m_dedicatedTransfer)
+		{
+			vkDestroySemaphore(device, m_transferTimeline, nullptr);
+			vkDestroyCommandPool(device, m_transferCmdPool, nullptr);
+		}
+	}
+
+	UploadTicket VulkanUploadManager::uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset)
+	{
+		SH_PROFILE_FUNCTION();
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		Staging staging = allocateStaging(size);
+		memcpy(staging.pData, data, static_cast<size_t>(size));
+
+		Batch& batch = getOpenBatch();
+		batch.stagingBytes += size;
+
+		VkBufferCopy region{};
+		region.srcOffset = staging.offset;
+		region.dstOffset = dstOffset;
+		region.size = size;
+
+		if (m_dedicatedTransfer)
+		{
+			const uint32_t transferFamily = m_device->getTransferQueueIndex();
+			const uint32_t graphicsFamily = m_device->getGraphicsQueueIndex();
+
+			vkCmdCopyBuffer(batch.transferCmdBuffer, staging.buffer, dst, 1, &region);
+
+			m_device->bufferMemoryBarrier(batch.transferCmdBuffer, dst, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferFamily, graphicsFamily);
+			m_device->bufferMemoryBarrier(batch.graphicsCmdBuffer, dst, VK_WHOLE_SIZE,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0, VK_ACCESS_MEMORY_READ_BIT, transferFamily, graphicsFamily);
+		}
+		else
+			vkCmdCopyBuffer(batch.graphicsCmdBuffer, staging.buffer, dst, 1, &region);
+
+		return batch.ticket;
+	}
+
+	UploadTicket VulkanUploadManager::uploadImage(VkImage dst, VkFormat format, const void* pixels, VkDeviceSize size, uint32_t width, uint32_t height, uint8_t mipLevels)
+	{
+		SH_PROFILE_FUNCTION();
+
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		Staging staging = allocateStaging(size);
+		memcpy(staging.pData, pixels, static_cast<size_t>(size));
+
+		Batch& batch = getOpenBatch();
+		batch.stagingBytes += size;
+		VkCommandBuffer copyCmdBuffer = m_dedicatedTransfer ? batch.transferCmdBuffer : batch.graphicsCmdBuffer;
+
+		m_device->transitionImageLayout(copyCmdBuffer, dst, format,
+			VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+			VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			0, VK_ACCESS_TRANSFER_WRITE_BIT, mipLevels);
+
+		m_device->copyBufferToImage(copyCmdBuffer, staging.buffer, dst, width, height, staging.offset);
+
+		// blits need the graphics queue, the mips are generated after the acquire
+		if (m_dedicatedTransfer)
+		{
+			const uint32_t transferFamily = m_device->getTransferQueueIndex();
+			const uint32_t graphicsFamily = m_device->getGraphicsQueueIndex();
+
+			imageOwnershipBarrier(batch.transferCmdBuffer, dst, mipLevels,
+				VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+				VK_ACCESS_TRANSFER_WRITE_BIT, 0, transferFamily, graphicsFamily);
+			imageOwnershipBarrier(batch.graphicsCmdBuffer, dst, mipLevels,
+				VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+				0, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT, transferFamily, graphicsFamily);
+		}
+
+		// transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
+		m_device->generateMipmaps(batch.graphicsCmdBuffer, dst, format, width, height, mipLevels);
+
+		return batch.ticket;
+	}
+
+	void VulkanUploadManager::flush()
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+
+		retireCompleted();
+		if (m_recording && m_batchScopes == 0)
+			submitOpenBatch();
+	}
+
+	void VulkanUploadManager::beginBatch()
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		m_batchScopes++;
+	}
+
+	UploadTicket VulkanUploadManager::endBatch()
+	{
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		SH_ASSERT(m_batchScopes, "endBatch() called without beginBatch() :<");
+
+		if (--m_batchScopes == 0 && m_recording)
+			submitOpenBatch();
+
+		// tickets complete in order
+		return m_recording ? m_openBatch.ticket : m_nextTicket - 1;
+	}
+
+	void VulkanUploadManager::use(UploadTicket ticket)
+	{
+		if (ticket <= m_completed.load(std::memory_order_relaxed))
+			return;
+
+		uint64_t frameWait = m_frameWait.load(std::memory_order_relaxed);
+		while (frameWait < ticket && !m_frameWait.compare_exchange_weak(frameWait, ticket, std::memory_order_relaxed));
+	}
+
+	UploadTicket VulkanUploadManager::getFrameWait()
+	{
+		const UploadTicket frameWait = m_frameWait.load(std::memory_order_relaxed);
+		if (isComplete(frameWait))
+			return 0;
+
+		// a frame must never wait on a value that hasn't been submitted
+		std::scoped_lock<std::mutex> lock(m_mutex);
+		if (m_recording && frameWait >= m_openBatch.ticket)
+			submitOpenBatch();
+
+		return frameWait;
+	}
+
+	bool VulkanUploadManager::isComplete(UploadTicket ticket)
+	{
+		return ticket <= m_completed.load(std::memory_order_relaxed) || ticket <= getCompletedValue();
+	}
+
+	void VulkanUploadManager::wait(UploadTicket ticket)
+	{
+		if (isComplete(ticket))
+			return;
+
+		SH_PROFILE_FUNCTION();
+
+		{
+			std::scoped_lock<std::mutex> lock(m_mutex);
+			if (m_recording && ticket >= m_openBatch.ticket)
+				submitOpenBatch();
+		}
+
+		VkSemaphoreWaitInfo waitInfo{};
+		waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &m_timeline;
+		waitInfo.pValues = &ticket;
+		VK_CHECK_RESULT(vkWaitSemaphores(m_device->getVkDevice(), &waitInfo, UINT64_MAX));
+	}
+
+	VulkanUploadManager::Staging VulkanUploadManager::allocateStaging(VkDeviceSize size)
+	{
+		// a big upload would drain the ring for everyone else, it gets a staging buffer of its own
+		if (size > m_stagingSize / 2)
+		{
+			VkBufferCreateInfo bufferCI{};
+			bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCI.size = size;
+			bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+			bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+			VmaAllocationCreateInfo allocCI{};
+			allocCI.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+			allocCI.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+			Staging staging{};
+			VmaAllocation allocation;
+			VmaAllocationInfo allocInfo;
+			VK_CHECK_RESULT(vmaCreateBuffer(m_device->getVmaAllocator(), &bufferCI, &allocCI, &staging.buffer, &allocation, &allocInfo));
+			m_device->trackAllocation(allocation, GpuMemoryCategory::Staging);
+
+			getOpenBatch().dedicatedStaging.emplace_back(staging.buffer, allocation);
+			staging.pData = allocInfo.pMappedData;
+			return staging;
+		}
+
+		for (;;)
+		{
+			retireCompleted();
+
+			uint64_t position = (m_stagingHead + s_stagingAlignment - 1) & ~(s_stagingAlignment - 1);
+			// an allocation never wraps around the end of the ring
+			if (position % m_stagingSize + size > m_stagingSize)
+				position = (position / m_stagingSize + 1) * m_stagingSize;
+
+			if (position + size - m_stagingTail <= m_stagingSize)
+			{
+				m_stagingHead = position + size;
+
+				const VkDeviceSize offset = position % m_stagingSize;
+				return { m_stagingBuffer, offset, m_pStaging + offset };
+			}
+
+			// the ring is full. the open batch holds its newest part, the oldest batch on the gpu gives back the oldest part
+			if (m_recording)
+				submitOpenBatch();
+
+			SH_WARN("the upload staging ring (%llu bytes) is full, waiting for the gpu :(", static_cast<unsigned long long>(m_stagingSize));
+
+			UploadTicket oldest = m_inFlight.front().ticket;
+			VkSemaphoreWaitInfo waitInfo{};
+			waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+			waitInfo.semaphoreCount = 1;
+			waitInfo.pSemaphores = &m_timeline;
+			waitInfo.pValues = &oldest;
+			VK_CHECK_RESULT(vkWaitSemaphores(m_device->getVkDevice(), &waitInfo, UINT64_MAX));
+		}
+	}
+
+	VulkanUploadManager::Batch& VulkanUploadManager::getOpenBatch()
+	{
+		if (m_recording)
+			return m_openBatch;
+
+		VkDevice device = m_device->getVkDevice();
+
+		if (!m_freeBatches.empty())
+		{
+			m_openBatch = std::move(m_freeBatches.back());
+			m_freeBatches.pop_back();
+
+			vkResetCommandBuffer(m_openBatch.graphicsCmdBuffer, 0);
+			if (m_dedicatedTransfer)
+				vkResetCommandBuffer(m_openBatch.transferCmdBuffer, 0);
+		}
+		else
+		{
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandBufferCount = 1;
+
+			allocInfo.commandPool = m_graphicsCmdPool;
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &m_openBatch.graphicsCmdBuffer));
+
+			if (m_dedicatedTransfer)
+			{
+				allocInfo.commandPool = m_transferCmdPool;
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocInfo, &m_openBatch.transferCmdBuffer));
+			}
+		}
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(m_openBatch.graphicsCmdBuffer, &beginInfo);
+		if (m_dedicatedTransfer)
+			vkBeginCommandBuffer(m_openBatch.transferCmdBuffer, &beginInfo);
+
+		m_openBatch.ticket = m_nextTicket;
+		m_recording = true;
+
+		return m_openBatch;
+	}
+
+	void VulkanUploadManager::submitOpenBatch()
+	{
+		SH_PROFILE_FUNCTION();
+
+		Batch& batch = m_openBatch;
+		batch.stagingEnd = m_stagingHead;
+
+		vkEndCommandBuffer(batch.graphicsCmdBuffer);
+		if (m_dedicatedTransfer)
+			vkEndCommandBuffer(batch.transferCmdBuffer);
+
+		VkSemaphoreSubmitInfo transferSemaphore{};
+		transferSemaphore.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		transferSemaphore.semaphore = m_transferTimeline;
+		transferSemaphore.value = batch.ticket;
+		transferSemaphore.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		VkSemaphoreSubmitInfo graphicsSignal{};
+		graphicsSignal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+		graphicsSignal.semaphore = m_timeline;
+		graphicsSignal.value = batch.ticket;
+		graphicsSignal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+
+		VkCommandBufferSubmitInfo transferCmdSubmit{};
+		transferCmdSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		transferCmdSubmit.commandBuffer = batch.transferCmdBuffer;
+
+		VkCommandBufferSubmitInfo graphicsCmdSubmit{};
+		graphicsCmdSubmit.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+		graphicsCmdSubmit.commandBuffer = batch.graphicsCmdBuffer;
+
+		{
+			std::scoped_lock<std::mutex> queueLock(m_device->getQueueMutex());
+
+			if (m_dedicatedTransfer)
+			{
+				VkSubmitInfo2 transferSubmit{};
+				transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+				transferSubmit.commandBufferInfoCount = 1;
+				transferSubmit.pCommandBufferInfos = &transferCmdSubmit;
+				transferSubmit.signalSemaphoreInfoCount = 1;
+				transferSubmit.pSignalSemaphoreInfos = &transferSemaphore;
+				VK_CHECK_RESULT(vkQueueSubmit2(m_device->getTransferQueue(), 1, &transferSubmit, VK_NULL_HANDLE));
+			}
+
+			VkSubmitInfo2 graphicsSubmit{};
+			graphicsSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+			graphicsSubmit.commandBufferInfoCount = 1;
+			graphicsSubmit.pCommandBufferInfos = &graphicsCmdSubmit;
+			graphicsSubmit.waitSemaphoreInfoCount = m_dedicatedTransfer ? 1 : 0;
+			graphicsSubmit.pWaitSemaphoreInfos = &transferSemaphore;
+			graphicsSubmit.signalSemaphoreInfoCount = 1;
+			graphicsSubmit.pSignalSemaphoreInfos = &graphicsSignal;
+			VK_CHECK_RESULT(vkQueueSubmit2(m_device->getGraphicsQueue(), 1, &graphicsSubmit, VK_NULL_HANDLE));
+		}
+
+		m_inFlight.emplace_back(std::move(batch));
+		m_openBatch = Batch();
+		m_recording = false;
+		m_nextTicket++;
+	}
+
+	void VulkanUploadManager::retireCompleted()
+	{
+		const uint64_t completed = getCompletedValue();
+
+		while (!m_inFlight.empty() && m_inFlight.front().ticket <= completed)
+		{
+			Batch& batch = m_inFlight.front();
+			m_stagingTail = batch.stagingEnd;
+
+			for (auto& [buffer, allocation] : batch.dedicatedStaging)
+				m_device->destroyBuffer(buffer, allocation);
+			batch.dedicatedStaging.clear();
+
+			m_device->trackReclaimed(ReclaimedMemory::Staging, batch.stagingBytes);
+			batch.stagingBytes = 0;
+
+			m_freeBatches.emplace_back(std::move(batch));
+			m_inFlight.pop_front();
+		}
+	}
+
+	uint64_t VulkanUploadManager::getCompletedValue()
+	{
+		uint64_t value;
+		VK_CHECK_RESULT(vkGetSemaphoreCounterValue(m_device->getVkDevice(), m_timeline, &value));
+
+		// the counter only goes up, racing stores of older values are harmless
+		uint64_t completed = m_completed.load(std::memory_order_relaxed);
+		while (completed < value && !m_completed.compare_exchange_weak(completed, value, std::memory_order_relaxed));
+
+		return value;
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Shadow/Renderer/Buffer.hpp"
+
+#include <vma/vk_mem_alloc.h>
+#include <atomic>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace Shadow
+{
+	class VulkanDevice;
+
+	// copies resource data into a persistently mapped staging ring and records the copies into the open batch. the batch goes to the
+	// gpu as one submission per frame (or earlier when the ring runs full) and signals a timeline semaphore with its ticket.
+	// nothing waits on the cpu: a frame that uses a resource waits on the gpu for the resource's ticket (see use()).
+	// with a dedicated transfer queue the copies run there and the graphics queue acquires the resources (and generates the mips)
+	class VulkanUploadManager
+	{
+	public:
+		VulkanUploadManager(VulkanDevice* device, VkDeviceSize stagingSize);
+		~VulkanUploadManager();
+		VulkanUploadManager(const VulkanUploadManager& other) = delete;
+		VulkanUploadManager& operator=(const VulkanUploadManager& other) = delete;
+
+		// any thread. the data is copied before the call returns, dst is written once the returned ticket has completed
+		UploadTicket uploadBuffer(VkBuffer dst, const void* data, VkDeviceSize size, VkDeviceSize dstOffset = 0);
+		// uploads mip 0 and generates the rest, the image ends up in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+		UploadTicket uploadImage(VkImage dst, VkFormat format, const void* pixels, VkDeviceSize size, uint32_t width, uint32_t height, uint8_t mipLevels);
+
+		// submits the open batch, the frame thread calls it right before the frame gets submitted. does nothing inside a batch scope
+		void flush();
+
+		// any thread, scopes nest. the uploads until the matching endBatch() are kept in one batch, even across frames, and go
+		// to the gpu as one submission (unless the staging ring runs full or a frame uses one of them before)
+		void beginBatch();
+		// ticket that covers every upload of the scope
+		UploadTicket endBatch();
+
+		// the next frame submitted waits (on the gpu) until ticket has completed
+		void use(UploadTicket ticket);
+		// ticket the next frame has to wait for, 0 if everything it uses is already on the gpu
+		UploadTicket getFrameWait();
+
+		bool isComplete(UploadTicket ticket);
+		// cpu wait, submits the open batch first if the ticket belongs to it
+		void wait(UploadTicket ticket);
+
+		inline VkSemaphore getTimelineSemaphore() const { return m_timeline; }
+	private:
+		struct Batch
+		{
+			VkCommandBuffer transferCmdBuffer = VK_NULL_HANDLE; // VK_NULL_HANDLE without a dedicated transfer queue
+			VkCommandBuffer graphicsCmdBuffer = VK_NULL_HANDLE;
+			UploadTicket ticket = 0;
+			uint64_t stagingEnd = 0; // staging head when the batch was submitted
+			VkDeviceSize stagingBytes = 0; // given back (and reported as reclaimed) once the batch has completed
+			std::vector<std::pair<VkBuffer, VmaAllocation>> dedicatedStaging; // uploads that didn't fit the ring
+		};
+
+		struct Staging
+		{
+			VkBuffer buffer;
+			VkDeviceSize offset;
+			void* pData;
+		};
+
+		// m_mutex has to be held by the callers of these
+		Staging allocateStaging(VkDeviceSize size);
+		Batch& getOpenBatch();
+		void submitOpenBatch();
+		void retireCompleted();
+		uint64_t getCompletedValue();
+	private:
+		VulkanDevice* m_device;
+		bool m_dedicatedTransfer;
+
+		VkBuffer m_stagingBuffer = VK_NULL_HANDLE;
+		VmaAllocation m_stagingAllocation = VK_NULL_HANDLE;
+		uint8_t* m_pStaging = nullptr;
+		VkDeviceSize m_stagingSize;
+		// monotonic byte positions, the ring offset is position % m_stagingSize
+		uint64_t m_stagingHead = 0;
+		uint64_t m_stagingTail = 0;
+
+		VkCommandPool m_transferCmdPool = VK_NULL_HANDLE;
+		VkCommandPool m_graphicsCmdPool = VK_NULL_HANDLE;
+
+		VkSemaphore m_timeline = VK_NULL_HANDLE;         // signaled by the graphics queue once a batch is usable
+		VkSemaphore m_transferTimeline = VK_NULL_HANDLE; // signaled by the transfer queue once a batch's copies are done
+
+		Batch m_openBatch;
+		bool m_recording = false;
+		std::deque<Batch> m_inFlight;
+		std::vector<Batch> m_freeBatches;
+
+		UploadTicket m_nextTicket = 1;
+		uint32_t m_batchScopes = 0;
+		std::atomic<uint64_t> m_completed{ 0 };
+		std::atomic<uint64_t> m_frameWait{ 0 };
+
+		std::mutex m_mutex;
+	};
+}
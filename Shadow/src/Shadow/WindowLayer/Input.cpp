@@ -8,16 +8,72 @@ namespace Shadow
 {
 	std::unique_ptr<Input> Input::s_instance = std::unique_ptr<Input>(new Input());
 
+	void Input::setKeyState(int keycode, bool pressed)
+	{
+		if (s_instance->m_replaying.load(std::memory_order_relaxed))
+			return;
+
+		if (keycode >= 0 && keycode < static_cast<int>(s_instance->m_keys.size()))
+			s_instance->m_keys[keycode].store(pressed, std::memory_order_relaxed);
+	}
+
+	void Input::setMouseButtonState(int button, bool pressed)
+	{
+		if (s_instance->m_replaying.load(std::memory_order_relaxed))
+			return;
+
+		if (button >= 0 && button < static_cast<int>(s_instance->m_mouseButtons.size()))
+			s_instance->m_mouseButtons[button].store(pressed, std::memory_order_relaxed);
+	}
+
+	InputState Input::getState()
+	{
+		InputState state;
+		for (uint32_t i = 0; i < s_inputKeyCount; i++)
+			state.keys[i] = s_instance->m_keys[i].load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < s_inputMouseButtonCount; i++)
+			state.mouseButtons[i] = s_instance->m_mouseButtons[i].load(std::memory_order_relaxed);
+
+		return state;
+	}
+
+	void Input::setReplaying(bool replaying)
+	{
+		s_instance->m_replaying.store(replaying, std::memory_order_relaxed);
+	}
+
+	void Input::replayState(const InputState& state)
+	{
+		for (uint32_t i = 0; i < s_inputKeyCount; i++)
+			s_instance->m_keys[i].store(state.keys[i], std::memory_order_relaxed);
+		for (uint32_t i = 0; i < s_inputMouseButtonCount; i++)
+			s_instance->m_mouseButtons[i].store(state.mouseButtons[i], std::memory_order_relaxed);
+	}
+
 	bool Input::isKeyPressedImpl(int keycode) const
 	{
-		GLFWwindow* window = static_cast<GLFWwindow*>(ShEngine::get().getWindow().getWindowHandle());
+		const Window& engineWindow = ShEngine::get().getWindow();
+		if (engineWindow.hasInputThread() || m_replaying.load(std::memory_order_relaxed))
+			return keycode >= 0 && keycode < static_cast<int>(m_keys.size()) && m_keys[keycode].load(std::memory_order_relaxed);
+
+		GLFWwindow* window = static_cast<GLFWwindow*>(engineWindow.getWindowHandle());
+		if (!window)
+			return false;
+
 		int state = glfwGetKey(window, keycode);
 		return state == GLFW_PRESS || state == GLFW_REPEAT;
 	}
 
 	bool Input::isMouseButtonPressedImpl(int button) const
 	{
-		GLFWwindow* window = static_cast<GLFWwindow*>(ShEngine::get().getWindow().getWindowHandle());
+		const Window& engineWindow = ShEngine::get().getWindow();
+		if (engineWindow.hasInputThread() || m_replaying.load(std::memory_order_relaxed))
+			return button >= 0 && button < static_cast<int>(m_mouseButtons.size()) && m_mouseButtons[button].load(std::memory_order_relaxed);
+
+		GLFWwindow* window = static_cast<GLFWwindow*>(engineWindow.getWindowHandle());
+		if (!window)
+			return false;
+
 		int state = glfwGetMouseButton(window, button);
 		return state == GLFW_PRESS;
 	}
@@ -1,16 +1,46 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <bitset>
+
 namespace Shadow
 {
+	static constexpr uint32_t s_inputKeyCount = 349;        // GLFW_KEY_LAST + 1
+	static constexpr uint32_t s_inputMouseButtonCount = 8;  // GLFW_MOUSE_BUTTON_LAST + 1
+
+	// snapshot of the cached key and mouse button state
+	struct InputState
+	{
+		std::bitset<s_inputKeyCount> keys;
+		std::bitset<s_inputMouseButtonCount> mouseButtons;
+
+		inline bool operator==(const InputState& other) const { return keys == other.keys && mouseButtons == other.mouseButtons; }
+		inline bool operator!=(const InputState& other) const { return !(*this == other); }
+	};
+
 	class Input
 	{
 	public:
 		inline static bool isKeyPressed(int keycode) { return s_instance->isKeyPressedImpl(keycode); }
 		inline static bool isMouseButtonPressed(int button) { return s_instance->isMouseButtonPressedImpl(button); }
+
+		// called by the window callbacks. with an input thread GLFW can't be queried from the frame thread, the cached state is read instead
+		static void setKeyState(int keycode, bool pressed);
+		static void setMouseButtonState(int button, bool pressed);
+
+		static InputState getState();
+		// while replaying, the live state reported by the window is ignored and isKeyPressed/isMouseButtonPressed return the replayed one
+		static void setReplaying(bool replaying);
+		static void replayState(const InputState& state);
 	private:
 		bool isKeyPressedImpl(int keycode) const;
 		bool isMouseButtonPressedImpl(int button) const;
 	private:
 		static std::unique_ptr<Input> s_instance;
+
+		std::array<std::atomic<bool>, s_inputKeyCount> m_keys{};
+		std::array<std::atomic<bool>, s_inputMouseButtonCount> m_mouseButtons{};
+		std::atomic<bool> m_replaying{ false };
 	};
 }
\ No newline at end of file
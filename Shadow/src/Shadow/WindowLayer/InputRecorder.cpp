@@ -0,0 +1,410 @@
+#include "shpch.hpp"
+#include "Shadow/Core/Core.hpp"
+#include "Shadow/WindowLayer/InputRecorder.hpp"
+#include "Shadow/WindowLayer/Input.hpp"
+#include "Shadow/Events/EventDispatcher.hpp"
+
+#include <fstream>
+#include <cstring>
+#include <cstddef>
+
+// file layout (native endianness):
+//   RecordingHeader
+//   per frame: uint32 eventCount, uint8 stateChanged, [packed key bits, packed mouse button bits], eventCount events
+//   per event: uint8 index of the type in EngineEvents, int64 nanoseconds since the recording started, payload
+
+namespace Shadow
+{
+	static constexpr uint32_t s_recordingMagic = 0x52494853; // "SHIR"
+	static constexpr uint32_t s_recordingVersion = 1;
+	static constexpr uint32_t s_keyStateBytes = (s_inputKeyCount + 7) / 8;
+	static constexpr uint32_t s_mouseButtonStateBytes = (s_inputMouseButtonCount + 7) / 8;
+
+	struct RecordingHeader
+	{
+		uint32_t magic = s_recordingMagic;
+		uint32_t version = s_recordingVersion;
+		uint32_t keyCount = s_inputKeyCount;
+		uint32_t mouseButtonCount = s_inputMouseButtonCount;
+		uint32_t frameCount = 0; // patched when the recording is stopped
+	};
+
+	struct ByteReader
+	{
+		const std::vector<uint8_t>& data;
+		size_t offset = 0;
+
+		template<typename T>
+		bool read(T& outValue)
+		{
+			if (offset + sizeof(T) > data.size())
+				return false;
+
+			memcpy(&outValue, data.data() + offset, sizeof(T));
+			offset += sizeof(T);
+			return true;
+		}
+
+		inline bool isAtEnd() const { return offset >= data.size(); }
+	};
+
+	struct InputRecorderData
+	{
+		enum class Mode
+		{
+			Idle,
+			Recording,
+			Replaying
+		} mode = Mode::Idle;
+
+		std::chrono::steady_clock::time_point start;
+		uint32_t frameCount = 0;
+
+		// recording. every event type has its own buffer, so the dispatch jobs never share one
+		std::ofstream file;
+		std::array<std::vector<uint8_t>, EngineEvents::size> eventBuffers;
+		std::array<uint32_t, EngineEvents::size> eventCounts{};
+		std::vector<uint8_t> frameBuffer;
+		InputState frameState;
+		InputState writtenState;
+
+		// replay
+		std::vector<uint8_t> replayData;
+		size_t replayOffset = 0;
+	};
+
+	static InputRecorderData* s_data = nullptr;
+
+	template<typename T>
+	static void write(std::vector<uint8_t>& buffer, const T& value)
+	{
+		const uint8_t* pBytes = reinterpret_cast<const uint8_t*>(&value);
+		buffer.insert(buffer.end(), pBytes, pBytes + sizeof(T));
+	}
+
+	static void writePayload(std::vector<uint8_t>& buffer, const KeyEvent& event)
+	{
+		write<int32_t>(buffer, event.keycode);
+		write<uint8_t>(buffer, event.pressed);
+	}
+
+	static void writePayload(std::vector<uint8_t>& buffer, const MouseButtonEvent& event)
+	{
+		write<int32_t>(buffer, event.button);
+		write<uint8_t>(buffer, event.pressed);
+	}
+
+	static void writePayload(std::vector<uint8_t>& buffer, const MouseMovedEvent& event)
+	{
+		write(buffer, event.x);
+		write(buffer, event.y);
+	}
+
+	static void writePayload(std::vector<uint8_t>& buffer, const MouseScrolledEvent& event)
+	{
+		write(buffer, event.xOffset);
+		write(buffer, event.yOffset);
+	}
+
+	template<typename EventType>
+	static void inject(EventType event, EventTimestamp timestamp)
+	{
+		event.timestamp = timestamp;
+		EventDispatcher::get().injectEvent(std::move(event));
+	}
+
+	static bool replayPayload(ByteReader& reader, EventTimestamp timestamp, TypeTag<KeyEvent>)
+	{
+		int32_t keycode = 0;
+		uint8_t pressed = 0;
+		if (!reader.read(keycode) || !reader.read(pressed))
+			return false;
+
+		inject(KeyEvent(keycode, pressed != 0), timestamp);
+		return true;
+	}
+
+	static bool replayPayload(ByteReader& reader, EventTimestamp timestamp, TypeTag<MouseButtonEvent>)
+	{
+		int32_t button = 0;
+		uint8_t pressed = 0;
+		if (!reader.read(button) || !reader.read(pressed))
+			return false;
+
+		inject(MouseButtonEvent(button, pressed != 0), timestamp);
+		return true;
+	}
+
+	static bool replayPayload(ByteReader& reader, EventTimestamp timestamp, TypeTag<MouseMovedEvent>)
+	{
+		float x = 0.0f, y = 0.0f;
+		if (!reader.read(x) || !reader.read(y))
+			return false;
+
+		inject(MouseMovedEvent(x, y), timestamp);
+		return true;
+	}
+
+	static bool replayPayload(ByteReader& reader, EventTimestamp timestamp, TypeTag<MouseScrolledEvent>)
+	{
+		float xOffset = 0.0f, yOffset = 0.0f;
+		if (!reader.read(xOffset) || !reader.read(yOffset))
+			return false;
+
+		inject(MouseScrolledEvent(xOffset, yOffset), timestamp);
+		return true;
+	}
+
+	static void writeState(std::vector<uint8_t>& buffer, const InputState& state)
+	{
+		uint8_t bytes[s_keyStateBytes + s_mouseButtonStateBytes] = {};
+
+		for (uint32_t i = 0; i < s_inputKeyCount; i++)
+			bytes[i / 8] |= static_cast<uint8_t>(state.keys[i]) << (i % 8);
+		for (uint32_t i = 0; i < s_inputMouseButtonCount; i++)
+			bytes[s_keyStateBytes + i / 8] |= static_cast<uint8_t>(state.mouseButtons[i]) << (i % 8);
+
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(bytes));
+	}
+
+	static bool readState(ByteReader& reader, InputState& outState)
+	{
+		uint8_t bytes[s_keyStateBytes + s_mouseButtonStateBytes];
+		if (!reader.read(bytes))
+			return false;
+
+		for (uint32_t i = 0; i < s_inputKeyCount; i++)
+			outState.keys[i] = (bytes[i / 8] >> (i % 8)) & 1;
+		for (uint32_t i = 0; i < s_inputMouseButtonCount; i++)
+			outState.mouseButtons[i] = (bytes[s_keyStateBytes + i / 8] >> (i % 8)) & 1;
+
+		return true;
+	}
+
+	// runs in the dispatch job of EventType
+	template<typename EventType>
+	static bool recordEvents(const EventSpan<EventType>& events)
+	{
+		constexpr uint32_t typeIndex = TypeIndex<EventType, EngineEvents>::value;
+		std::vector<uint8_t>& buffer = s_data->eventBuffers[typeIndex];
+
+		for (const EventType& event : events)
+		{
+			write<uint8_t>(buffer, static_cast<uint8_t>(typeIndex));
+			write<int64_t>(buffer, std::chrono::duration_cast<std::chrono::nanoseconds>(event.timestamp - s_data->start).count());
+			writePayload(buffer, event);
+		}
+		s_data->eventCounts[typeIndex] += static_cast<uint32_t>(events.size());
+
+		return false;
+	}
+
+	// injects one event of the type at typeIndex into the EventDispatcher
+	static bool replayEvent(ByteReader& reader, uint8_t typeIndex, EventTimestamp timestamp)
+	{
+		bool replayed = false;
+		uint32_t index = 0;
+
+		EventDispatcher::get().forEachEventType([&](auto tag)
+		{
+			using EventType = typename decltype(tag)::Type;
+			if constexpr (EventTraits<EventType>::recorded)
+			{
+				if (index == typeIndex)
+					replayed = replayPayload(reader, timestamp, tag);
+			}
+			index++;
+		});
+
+		return replayed;
+	}
+
+	bool InputRecorder::startRecording(const std::string& filepath)
+	{
+		SH_ASSERT(!s_data, "input recorder is already running o^o");
+
+		std::ofstream file(filepath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			SH_ERROR("failed to open %s for recording :(", filepath.c_str());
+			return false;
+		}
+
+		s_data = new InputRecorderData();
+		s_data->mode = InputRecorderData::Mode::Recording;
+		s_data->start = std::chrono::steady_clock::now();
+		s_data->file = std::move(file);
+
+		const RecordingHeader header{};
+		s_data->file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+		EventDispatcher& dispatcher = EventDispatcher::get();
+		dispatcher.forEachEventType([&dispatcher](auto tag)
+		{
+			using EventType = typename decltype(tag)::Type;
+			if constexpr (EventTraits<EventType>::recorded)
+				dispatcher.setRecorder<EventType>([](const EventSpan<EventType>& events) { return recordEvents(events); });
+		});
+
+		SH_TRACE("recording input to %s", filepath.c_str());
+		return true;
+	}
+
+	bool InputRecorder::startReplay(const std::string& filepath)
+	{
+		SH_ASSERT(!s_data, "input recorder is already running o^o");
+
+		std::ifstream file(filepath, std::ios::ate | std::ios::binary);
+		if (!file.is_open())
+		{
+			SH_ERROR("failed to open the input recording %s :(", filepath.c_str());
+			return false;
+		}
+
+		std::vector<uint8_t> data(static_cast<size_t>(file.tellg()));
+		file.seekg(0);
+		file.read(reinterpret_cast<char*>(data.data()), data.size());
+
+		RecordingHeader header;
+		ByteReader reader{ data };
+		if (!reader.read(header) || header.magic != s_recordingMagic || header.version != s_recordingVersion
+			|| header.keyCount != s_inputKeyCount || header.mouseButtonCount != s_inputMouseButtonCount)
+		{
+			SH_ERROR("%s isn't an input recording of this engine version :(", filepath.c_str());
+			return false;
+		}
+
+		s_data = new InputRecorderData();
+		s_data->mode = InputRecorderData::Mode::Replaying;
+		s_data->start = std::chrono::steady_clock::now();
+		s_data->frameCount = header.frameCount;
+		s_data->replayData = std::move(data);
+		s_data->replayOffset = reader.offset;
+
+		EventDispatcher::get().setReplaying(true);
+		Input::setReplaying(true);
+		Input::replayState(InputState());
+
+		SH_TRACE("replaying %u frames of input from %s", header.frameCount, filepath.c_str());
+		return true;
+	}
+
+	void InputRecorder::stop()
+	{
+		if (!s_data)
+			return;
+
+		EventDispatcher& dispatcher = EventDispatcher::get();
+		if (s_data->mode == InputRecorderData::Mode::Recording)
+		{
+			dispatcher.forEachEventType([&dispatcher](auto tag)
+			{
+				using EventType = typename decltype(tag)::Type;
+				if constexpr (EventTraits<EventType>::recorded)
+					dispatcher.setRecorder<EventType>(EventBatchReciever<EventType>());
+			});
+
+			s_data->file.seekp(offsetof(RecordingHeader, frameCount));
+			s_data->file.write(reinterpret_cast<const char*>(&s_data->frameCount), sizeof(uint32_t));
+			s_data->file.close();
+		}
+		else
+		{
+			dispatcher.setReplaying(false);
+			Input::setReplaying(false);
+		}
+
+		delete s_data;
+		s_data = nullptr;
+	}
+
+	bool InputRecorder::beginFrame()
+	{
+		if (!s_data)
+			return true;
+
+		SH_PROFILE_FUNCTION();
+
+		if (s_data->mode == InputRecorderData::Mode::Recording)
+		{
+			// what isKeyPressed reports while the layers update this frame
+			s_data->frameState = Input::getState();
+			return true;
+		}
+
+		ByteReader reader{ s_data->replayData, s_data->replayOffset };
+		if (reader.isAtEnd())
+			return false;
+
+		uint32_t eventCount = 0;
+		uint8_t stateChanged = 0;
+		bool valid = reader.read(eventCount) && reader.read(stateChanged);
+
+		if (valid && stateChanged)
+		{
+			InputState state;
+			valid = readState(reader, state);
+			if (valid)
+				Input::replayState(state);
+		}
+
+		for (uint32_t i = 0; valid && i < eventCount; i++)
+		{
+			uint8_t typeIndex = 0;
+			int64_t timeNs = 0;
+			valid = reader.read(typeIndex) && reader.read(timeNs)
+				&& replayEvent(reader, typeIndex, s_data->start + std::chrono::nanoseconds(timeNs));
+		}
+
+		if (!valid)
+		{
+			SH_WARN("the input recording is truncated or corrupt, stopping the replay :<");
+			s_data->replayOffset = s_data->replayData.size();
+			return false;
+		}
+
+		s_data->replayOffset = reader.offset;
+		return true;
+	}
+
+	void InputRecorder::endFrame()
+	{
+		if (!s_data || s_data->mode != InputRecorderData::Mode::Recording)
+			return;
+
+		SH_PROFILE_FUNCTION();
+
+		std::vector<uint8_t>& frame = s_data->frameBuffer;
+		frame.clear();
+
+		uint32_t eventCount = 0;
+		for (uint32_t count : s_data->eventCounts)
+			eventCount += count;
+
+		const bool stateChanged = s_data->frameState != s_data->writtenState;
+		write(frame, eventCount);
+		write<uint8_t>(frame, stateChanged);
+		if (stateChanged)
+		{
+			writeState(frame, s_data->frameState);
+			s_data->writtenState = s_data->frameState;
+		}
+
+		// the event types are replayed into independent queues, only the order within a type matters
+		for (uint32_t i = 0; i < EngineEvents::size; i++)
+		{
+			frame.insert(frame.end(), s_data->eventBuffers[i].begin(), s_data->eventBuffers[i].end());
+			s_data->eventBuffers[i].clear();
+			s_data->eventCounts[i] = 0;
+		}
+
+		s_data->file.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+		s_data->frameCount++;
+	}
+
+	bool InputRecorder::isRecording() { return s_data && s_data->mode == InputRecorderData::Mode::Recording; }
+
+	bool InputRecorder::isReplaying() { return s_data && s_data->mode == InputRecorderData::Mode::Replaying; }
+
+	uint32_t InputRecorder::getFrameCount() { return s_data ? s_data->frameCount : 0; }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+
+namespace Shadow
+{
+	// writes the recorded input events (EventTraits::recorded) each frame dispatched, together with the Input key/button state,
+	// to a compact binary file and feeds them back frame by frame. a replay advances the simulation by EngineProperties::fixedTimestep
+	// per frame, so two builds see exactly the same input at the same simulation time
+	class InputRecorder
+	{
+	public:
+		static bool startRecording(const std::string& filepath);
+		// the whole recording is loaded up front, a replay doesn't touch the disk while the frames run
+		static bool startReplay(const std::string& filepath);
+		// finishes the recording file or ends the replay
+		static void stop();
+
+		// frame thread, before the events of the frame are dispatched. returns false once the replay ran out of frames
+		static bool beginFrame();
+		// frame thread, after the event dispatch jobs of the frame have finished
+		static void endFrame();
+
+		static bool isRecording();
+		static bool isReplaying();
+		// frames recorded so far, or the frame count of the loaded replay (0 if the recording wasn't finished properly)
+		static uint32_t getFrameCount();
+	};
+}
@@ -4,14 +4,24 @@
 #include "Shadow/Events/EventDispatcher.hpp"
 #include "Shadow/Renderer/GraphicsContext.hpp"
 #include "Shadow/Core/ShEngine.hpp"
+#include "Shadow/WindowLayer/Input.hpp"
 		 
 #include <GLFW/glfw3.h>
 
 namespace Shadow
 {
-	Window::Window(uint32_t width, uint32_t height, const char* title)
+	Window::Window(uint32_t width, uint32_t height, const char* title, bool headless)
 		: m_windowProperties{ width, height, static_cast<float>(width) / static_cast<float>(height), title }
 	{
+		if (headless)
+		{
+			GraphicsContext::createHeadless(width, height);
+			GraphicsContext::getCtx().init();
+
+			SH_TRACE("running headless (%ux%u) -_-", width, height);
+			return;
+		}
+
 		int status = glfwInit();
 		SH_ASSERT(status, "Failed to initialize GLFW :<");
 
@@ -22,7 +32,22 @@ namespace Shadow
 		m_window = glfwCreateWindow(width, height, title, nullptr, nullptr);
 		SH_ASSERT(m_window, "Failed to create GLFW window :(");
 
-		glfwSetWindowUserPointer(m_window, (void*)&m_windowProperties);
+		glfwSetWindowUserPointer(m_window, this);
+
+		// still on the main thread, the callbacks keep the state up to date from here on
+		int windowWidth = 0, windowHeight = 0, framebufferWidth = 0, framebufferHeight = 0;
+		double cursorX = 0.0, cursorY = 0.0;
+		glfwGetWindowSize(m_window, &windowWidth, &windowHeight);
+		glfwGetFramebufferSize(m_window, &framebufferWidth, &framebufferHeight);
+		glfwGetCursorPos(m_window, &cursorX, &cursorY);
+
+		m_state.width = windowWidth;
+		m_state.height = windowHeight;
+		m_state.framebufferWidth = framebufferWidth;
+		m_state.framebufferHeight = framebufferHeight;
+		m_state.cursorX = static_cast<float>(cursorX);
+		m_state.cursorY = static_cast<float>(cursorY);
+		m_state.focused = glfwGetWindowAttrib(m_window, GLFW_FOCUSED) != 0;
 
 		GraphicsContext::create(m_window);
 		GraphicsContext::getCtx().init();
@@ -33,36 +58,138 @@ namespace Shadow
 
 	Window::~Window()
 	{
-		glfwDestroyWindow(m_window);
-		glfwTerminate();
+		if (m_window)
+		{
+			glfwDestroyWindow(m_window);
+			glfwTerminate();
+		}
 		GraphicsContext::destroy();
 	}
 
 	void Window::getFramebufferSize(uint32_t& outWidth, uint32_t& outHeight) const
 	{
+		if (!m_window)
+		{
+			outWidth = m_windowProperties.width;
+			outHeight = m_windowProperties.height;
+			return;
+		}
+
+		// GLFW may only be queried on the main thread, the frame thread reads what the callbacks cached
+		if (m_inputThread)
+		{
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			outWidth = m_state.framebufferWidth;
+			outHeight = m_state.framebufferHeight;
+			return;
+		}
+
 		glfwGetFramebufferSize(m_window, 
 			reinterpret_cast<int*>(&outWidth), reinterpret_cast<int*>(&outHeight));
 	}
 
-	void Window::present()
+	int Window::getWidth() const
 	{
-		SH_PROFILE_FUNCTION();
+		if (m_inputThread)
+		{
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			return m_state.width;
+		}
 
+		return m_windowProperties.width;
+	}
+
+	int Window::getHeight() const
+	{
+		if (m_inputThread)
 		{
-			SH_PROFILE_SCOPE("glfwPollEvents - Window::present");
-			glfwPollEvents();
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			return m_state.height;
+		}
+
+		return m_windowProperties.height;
+	}
+
+	float Window::getAspectRatio() const
+	{
+		if (m_inputThread)
+		{
+			std::scoped_lock<std::mutex> lock(m_stateMutex);
+			return static_cast<float>(m_state.width) / static_cast<float>(m_state.height);
 		}
+
+		return m_windowProperties.aspectRatio;
+	}
+
+	WindowState Window::getState() const
+	{
+		if (!m_window)
+		{
+			WindowState state;
+			state.width = state.framebufferWidth = m_windowProperties.width;
+			state.height = state.framebufferHeight = m_windowProperties.height;
+			return state;
+		}
+
+		std::scoped_lock<std::mutex> lock(m_stateMutex);
+		return m_state;
+	}
+
+	void Window::pollEvents()
+	{
+		SH_PROFILE_SCOPE("glfwPollEvents - Window::pollEvents");
+
+		if (m_window && !m_inputThread)
+			glfwPollEvents();
+	}
+
+	void Window::present()
+	{
+		SH_PROFILE_FUNCTION();
+
+		pollEvents();
 		GraphicsContext::getCtx().presentImage();
 	}
 
 	void Window::setCursorMode(CursorMode cursorMode) const
 	{
+		if (!m_window)
+			return;
+
+		if (m_inputThread)
+		{
+			m_pendingCursorMode.store(static_cast<int>(cursorMode), std::memory_order_release);
+			wakeEventLoop();
+			return;
+		}
+
 		glfwSetInputMode(m_window, GLFW_CURSOR, static_cast<int>(cursorMode));
 	}
 
-	Scope<Window> Window::create(uint32_t width, uint32_t height, const char* title)
+	void Window::enableInputThread()
 	{
-		return createScope<Window>(width, height, title);
+		m_inputThread = m_window != nullptr;
+	}
+
+	void Window::waitEvents()
+	{
+		SH_PROFILE_FUNCTION();
+
+		glfwWaitEvents();
+
+		int cursorMode = m_pendingCursorMode.exchange(-1, std::memory_order_acq_rel);
+		if (cursorMode != -1)
+			glfwSetInputMode(m_window, GLFW_CURSOR, cursorMode);
+	}
+
+	void Window::wakeEventLoop() const
+	{
+		glfwPostEmptyEvent();
+	}
+
+	Scope<Window> Window::create(uint32_t width, uint32_t height, const char* title, bool headless)
+	{
+		return createScope<Window>(width, height, title, headless);
 	}
 
 	void Window::setCallbacks()
@@ -74,26 +201,62 @@ namespace Shadow
 
 		glfwSetWindowSizeCallback(m_window, [](GLFWwindow* window, int width, int height)
 			{
-				WindowProperties& data = *(WindowProperties*)glfwGetWindowUserPointer(window);
-				data.width = width;
-				data.height = height;
-				data.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+				Window& self = *static_cast<Window*>(glfwGetWindowUserPointer(window));
+				{
+					std::scoped_lock<std::mutex> lock(self.m_stateMutex);
+					self.m_state.width = width;
+					self.m_state.height = height;
+				}
+
+				// the frame thread reads m_state then, the properties are only kept for the single-threaded getters
+				if (!self.m_inputThread)
+				{
+					WindowProperties& data = self.m_windowProperties;
+					data.width = width;
+					data.height = height;
+					data.aspectRatio = static_cast<float>(width) / static_cast<float>(height);
+				}
 
 				EventDispatcher::get().addEvent(WindowResizedEvent{ width, height });
 		});
 
+		// read by the swapchain when it is recreated and while the window is minimized
+		glfwSetFramebufferSizeCallback(m_window, [](GLFWwindow* window, int width, int height)
+		{
+			Window& self = *static_cast<Window*>(glfwGetWindowUserPointer(window));
+			std::scoped_lock<std::mutex> lock(self.m_stateMutex);
+			self.m_state.framebufferWidth = width;
+			self.m_state.framebufferHeight = height;
+		});
+
+		glfwSetWindowFocusCallback(m_window, [](GLFWwindow* window, int focused)
+		{
+			Window& self = *static_cast<Window*>(glfwGetWindowUserPointer(window));
+			std::scoped_lock<std::mutex> lock(self.m_stateMutex);
+			self.m_state.focused = focused != 0;
+		});
+
 		glfwSetKeyCallback(m_window, [](GLFWwindow* window, int key, int scancode, int action, int mods)
 		{
+			Input::setKeyState(key, action != GLFW_RELEASE);
 			EventDispatcher::get().addEvent(KeyEvent{ key, action == GLFW_RELEASE ? false : true });
 		});
 
 		glfwSetMouseButtonCallback(m_window, [](GLFWwindow* window, int button, int action, int mods)
 		{
+			Input::setMouseButtonState(button, action != GLFW_RELEASE);
 			EventDispatcher::get().addEvent(MouseButtonEvent{ button, action == GLFW_RELEASE ? false : true });
 		});
 
 		glfwSetCursorPosCallback(m_window, [](GLFWwindow* window, double xpos, double ypos)
 		{
+			Window& self = *static_cast<Window*>(glfwGetWindowUserPointer(window));
+			{
+				std::scoped_lock<std::mutex> lock(self.m_stateMutex);
+				self.m_state.cursorX = static_cast<float>(xpos);
+				self.m_state.cursorY = static_cast<float>(ypos);
+			}
+
 			EventDispatcher::get().addEvent(MouseMovedEvent{(float)xpos, (float)ypos});
 		});
 
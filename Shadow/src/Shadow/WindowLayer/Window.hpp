@@ -1,5 +1,8 @@
 #pragma once
 
+#include <atomic>
+#include <mutex>
+
 struct GLFWwindow;
 
 namespace Shadow
@@ -10,23 +13,44 @@ namespace Shadow
 		Hidden =  212995
 	};
 
+	// what the GLFW callbacks last reported. with an input thread GLFW can't be queried from the frame thread, this is read instead
+	struct WindowState
+	{
+		uint32_t width = 0, height = 0;
+		uint32_t framebufferWidth = 0, framebufferHeight = 0;
+		float cursorX = 0.0f, cursorY = 0.0f;
+		bool focused = true;
+	};
+
 	class Window
 	{
 	public:
-		Window(uint32_t width, uint32_t height, const char* title = "Shadow");
+		// a headless window has no GLFW window and no surface, the graphics context renders into an offscreen image ring
+		Window(uint32_t width, uint32_t height, const char* title = "Shadow", bool headless = false);
 		~Window();
 
 		inline void* getWindowHandle() const { return m_window; }
 		void getFramebufferSize(uint32_t& outWidth, uint32_t& outHeight) const;
+		WindowState getState() const;
 		
-		inline int getWidth() const { return m_windowProperties.width; }
-		inline int getHeight() const { return m_windowProperties.height; }
-		inline float getAspectRatio() const { return m_windowProperties.aspectRatio; }
+		// served from the cached state with an input thread, its size callback runs concurrently with the frame thread
+		int getWidth() const;
+		int getHeight() const;
+		float getAspectRatio() const;
+		inline bool isHeadless() const { return m_window == nullptr; }
 
+		void pollEvents();
 		void present();
 		void setCursorMode(CursorMode cursorMode) const;
 
-		static Scope<Window> create(uint32_t width, uint32_t height, const char* title = "Shadow");
+		// with an input thread the thread that created the window (GLFW only allows the main thread) pumps the events
+		// in waitEvents() and the frame loop runs elsewhere. pollEvents() becomes a no-op and cursor changes are forwarded
+		void enableInputThread();
+		void waitEvents();
+		void wakeEventLoop() const;
+		inline bool hasInputThread() const { return m_inputThread; }
+
+		static Scope<Window> create(uint32_t width, uint32_t height, const char* title = "Shadow", bool headless = false);
 	private:
 		void setCallbacks();
 	private:
@@ -37,7 +61,12 @@ namespace Shadow
 			const char* title;
 		} m_windowProperties;
 
-		GLFWwindow* m_window;
+		GLFWwindow* m_window = nullptr;
+		bool m_inputThread = false;
+		mutable std::atomic<int> m_pendingCursorMode{ -1 };
+
+		mutable std::mutex m_stateMutex;
+		WindowState m_state;
 	};
 }
 